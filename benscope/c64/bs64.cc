@@ -1,25 +1,67 @@
+#include <cstddef>
 #include <iostream>
 #include <memory>
 #include <utility>
 
 #include "benscope/c64/codegen.h"
-#include "benscope/parsing/ast.h"
-#include "benscope/parsing/lexer.h"
-#include "benscope/parsing/parser.h"
+#include "benscope/parsing/ast_file.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/parallel_parser.h"
+#include "benscope/parsing/source_buffer.h"
+#include "benscope/transforms/constant_folder.h"
+#include "benscope/transforms/hash_conser.h"
+#include "benscope/transforms/inliner.h"
+#include "benscope/transforms/scope_resolver.h"
+#include "benscope/transforms/strength_reducer.h"
 
+// Rough 6502 cycle counts.  Every arithmetic operator is a BASIC ROM call,
+// and the multiply and divide routines loop over every mantissa bit.
+constexpr benscope::CostModel kCosts = {
+    /*add=*/250, /*multiply=*/2500, /*divide=*/3500,
+    /*number=*/40, /*variable=*/100};
+
+// Usage: bs64 [source-file]
+//
+// Compiles the given file, or standard input if none is given, to ca65
+// assembly on standard output.  The input may also be a binary AST file from
+// ast_pack.
 int main(int argc, char *argv[]) {
-  auto lexer = std::make_unique<benscope::Lexer>(&std::cin);
-  benscope::Parser parser(std::move(lexer));
+  std::unique_ptr<benscope::SourceBuffer> source =
+      argc > 1 ? benscope::SourceBuffer::MapFile(argv[1])
+               : benscope::SourceBuffer::ReadStream(&std::cin);
+  if (!source)
+    return 1;
 
   benscope::c64::CodeGen codegen;
-  while (!parser.eof()) {
-    std::unique_ptr<benscope::AST> ast = parser.ParseNext();
-    if (ast) {
-      ast->Accept(codegen);
-    } else {
-      std::cerr << "Unhandled text.";
-      parser.GetNextToken();
+  benscope::Inliner inliner;
+  benscope::ConstantFolder folder;
+  benscope::StrengthReducer reducer(kCosts);
+  benscope::HashConser conser;
+  auto compile = [&](benscope::FlatAst *form) {
+    inliner.Run(form);
+    folder.Run(form);
+    reducer.Run(form);
+    conser.Run(form);
+    inliner.Define(*form);
+    if (benscope::ResolveScopes(form))
+      codegen.Generate(*form);
+  };
+
+  if (benscope::AstFile::HasMagic(source->view())) {
+    std::unique_ptr<benscope::AstFile> file =
+        benscope::AstFile::FromBuffer(std::move(source));
+    if (!file)
+      return 1;
+    benscope::FlatAst form;
+    for (std::size_t i = 0; i < file->size(); ++i) {
+      file->Load(i, &form);
+      compile(&form);
     }
+  } else {
+    // Code generation depends on the order of definitions, so only parsing
+    // is spread across threads.
+    for (benscope::FlatAst &form : benscope::ParseForms(source->view()))
+      compile(&form);
   }
   std::cout << codegen.ToString();
-}
\ No newline at end of file
+}
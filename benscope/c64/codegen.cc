@@ -1,31 +1,23 @@
 #include "benscope/c64/codegen.h"
 
-namespace benscope::c64 {
-namespace {
-template <typename T> struct reversing_wrapper { T &iterable; };
+#include <iterator>
 
-template <typename T> auto begin(reversing_wrapper<T> w) {
-  return std::rbegin(w.iterable);
-}
-
-template <typename T> auto end(reversing_wrapper<T> w) {
-  return std::rend(w.iterable);
-}
+#include "benscope/transforms/tail_calls.h"
 
-template <typename T> reversing_wrapper<T> reverse(T &&iterable) {
-  return {iterable};
-}
-
-std::string mangle(std::string_view name) { return absl::StrCat("_", name); }
+namespace benscope::c64 {
+namespace {
+std::string mangle(Symbol name) { return absl::StrCat("_", name.name()); }
 } // namespace
 
-void CodeGen::Visit(const BinaryExprAST &expr) {
-  expr.rhs->Accept(*this);
+void CodeGen::EmitBinaryMiddle() {
   Line(1, "jsr push_fac");
-  expr.lhs->Accept(*this);
+  _scope->offset += 5;
+}
+
+void CodeGen::EmitBinaryEnd(char op) {
   Line(1, "ldy sp + 1");
   Line(1, "lda sp");
-  switch (expr.op) {
+  switch (op) {
   case '+': {
     Line(1, "jsr FADD");
     break;
@@ -36,39 +28,49 @@ void CodeGen::Visit(const BinaryExprAST &expr) {
   }
   default: { Line(1, "brk"); }
   }
+  EmitPop(5);
+  _scope->offset -= 5;
 }
 
-void CodeGen::Visit(const CallExprAST &expr) {
-  Line(1, absl::StrCat("; Call ", expr.callee));
-  const int offset = _scope->offset;
-  int argc = 0;
-  for (const auto &arg : expr.args) {
-    Line(2, absl::StrCat("; Push arg ", ++argc));
-    arg->Accept(*this);
-    Line(1, "jsr push_fac");
-    _scope->offset += 5;
-  }
+void CodeGen::EmitCallBegin(Symbol callee) {
+  Line(1, absl::StrCat("; Call ", callee.name()));
+}
+
+void CodeGen::EmitCallArgBegin(int arg) {
+  Line(2, absl::StrCat("; Push arg ", arg + 1));
+}
+
+void CodeGen::EmitCallArgEnd() {
+  Line(1, "jsr push_fac");
+  _scope->offset += 5;
+}
+
+void CodeGen::EmitCallEnd(Symbol callee, int argc) {
   Line(2, absl::StrCat("; Perform call"));
-  Line(1, absl::StrCat("jsr ", mangle(expr.callee)));
-  _scope->offset = offset;
+  Line(1, absl::StrCat("jsr ", mangle(callee)));
+  _scope->offset -= 5 * argc;
 }
 
-void CodeGen::Visit(const IfExprAST &expr) {
-  Line(0, ".scope ifexpr");
-  expr.test->Accept(*this);
+void CodeGen::EmitIfBegin() { Line(0, ".scope ifexpr"); }
+
+void CodeGen::EmitIfTest() {
   Line(1, "lda FAC_EXPONENT");
   Line(1, "bne false");
-  expr.if_true->Accept(*this);
+}
+
+void CodeGen::EmitIfElse() {
   Line(1, "jmp done");
   Line(0, "false:");
-  expr.if_false->Accept(*this);
+}
+
+void CodeGen::EmitIfEnd() {
   Line(0, "done:");
   Line(0, ".endscope");
 }
 
-void CodeGen::Visit(const NumberExprAST &expr) {
-  CBMUnpackedFloat val(expr.val);
-  Line(1, absl::StrCat("; FAC = ", expr.val));
+void CodeGen::EmitNumber(double value) {
+  CBMUnpackedFloat val(value);
+  Line(1, absl::StrCat("; FAC = ", value));
   Line(1, absl::StrCat("lda #$", absl::Hex(val.exponent_excess_128)));
   Line(1, "sta FAC_EXPONENT");
   Line(1, absl::StrCat("lda #$", absl::Hex(val.mantissa_0)));
@@ -86,39 +88,240 @@ void CodeGen::Visit(const NumberExprAST &expr) {
   Line(0, "");
 }
 
-void CodeGen::Visit(const VariableExprAST &expr) {
-  Line(1, absl::StrCat("lda #", _scope->v_table[expr.name_], " + ",
-                       _scope->offset));
+void CodeGen::EmitVariable(Symbol name) { EmitLoad(_scope->v_table[name]); }
+
+void CodeGen::EmitLoad(int slot) {
+  Line(1, absl::StrCat("lda #", slot, " + ", _scope->offset));
   Line(1, "jsr sp_plus_a_to_ya");
   Line(1, "jsr BASIC_LoadFAC");
 
-  _globals.insert("sp_plus_a_to_ya");
+  static const Symbol kSpPlusAToYa = Symbol::Intern("sp_plus_a_to_ya");
+  _globals.insert(kSpPlusAToYa);
 }
 
-void CodeGen::Visit(const FunctionAST &ast) {
-  Line(0, absl::StrCat(".proc ", mangle(ast.proto->name), ": near"));
-  int stack = 0;
-  Scope scope;
-  _scope = &scope;
-  for (const auto &arg : reverse(ast.proto->args)) {
-    scope.v_table[arg] = stack;
+void CodeGen::EmitStore(int slot) {
+  Line(1, absl::StrCat("lda #", slot, " + ", _scope->offset));
+  Line(1, "jsr sp_plus_a_to_ya");
+  Line(1, "tax");
+  Line(1, "jsr BASIC_StoreFAC");
+}
+
+void CodeGen::EmitPop(int bytes) {
+  Line(1, absl::StrCat("lda #", bytes));
+  Line(1, "jsr sp_plus_a_to_ya");
+  Line(1, "sty sp + 1");
+  Line(1, "sta sp");
+}
+
+template <typename Args>
+void CodeGen::EmitFunctionBegin(Scope *scope, Symbol name, const Args &args,
+                                int temps, bool loop) {
+  Line(0, absl::StrCat(".proc ", mangle(name), ": near"));
+  int stack = 5 * temps;
+  _scope = scope;
+  // The last argument was pushed last, so it is nearest the stack pointer.
+  for (auto arg = std::end(args); arg != std::begin(args);) {
+    scope->v_table[*--arg] = stack;
     stack += 5;
   }
-  for (const auto &entry : scope.v_table) {
-    Line(1, absl::StrCat("; ", entry.first, " := ", entry.second));
+  for (const auto &arg : args) {
+    Line(1, absl::StrCat("; ", arg.name(), " := ", scope->v_table[arg]));
   }
-  ast.body->Accept(*this);
+  if (temps > 0) {
+    Line(1, absl::StrCat("; Reserve ", 5 * temps, " bytes of temporaries"));
+    Line(1, "lda sp");
+    Line(1, "sec");
+    Line(1, absl::StrCat("sbc #", 5 * temps));
+    Line(1, "sta sp");
+    Line(1, "lda sp + 1");
+    Line(1, "sbc #0");
+    Line(1, "sta sp + 1");
+  }
+  if (loop)
+    Line(0, "tail_loop:");
+}
+
+template <typename Params> void CodeGen::EmitTailCall(const Params &params) {
+  const int argc = std::size(params);
+  Line(2, "; Reassign arguments");
+  for (int i = 0; i < argc; ++i) {
+    // The last argument was pushed last, so it is nearest the stack pointer.
+    Line(1, absl::StrCat("lda #", 5 * (argc - 1 - i)));
+    Line(1, "jsr sp_plus_a_to_ya");
+    Line(1, "jsr BASIC_LoadFAC");
+    EmitStore(_scope->v_table[std::begin(params)[i]]);
+  }
+  EmitPop(5 * argc);
+  _scope->offset -= 5 * argc;
+  Line(1, "jmp tail_loop");
+}
+
+void CodeGen::EmitFunctionEnd(int argc, int temps) {
   _scope = nullptr;
 
-  Line(1, absl::StrCat("lda #", stack));
-  Line(1, "jsr sp_plus_a_to_ya");
-  Line(1, "sty sp + 1");
-  Line(1, "sta sp");
+  EmitPop(5 * (argc + temps));
   Line(0, absl::StrCat(".endproc"));
 }
 
+void CodeGen::Visit(const BinaryExprAST &expr) {
+  Dispatch(*expr.rhs);
+  EmitBinaryMiddle();
+  Dispatch(*expr.lhs);
+  EmitBinaryEnd(expr.op);
+}
+
+void CodeGen::Visit(const CallExprAST &expr) {
+  EmitCallBegin(expr.callee);
+  for (size_t i = 0; i < expr.args.size(); ++i) {
+    EmitCallArgBegin(i);
+    Dispatch(*expr.args[i]);
+    EmitCallArgEnd();
+  }
+  EmitCallEnd(expr.callee, expr.args.size());
+}
+
+void CodeGen::Visit(const IfExprAST &expr) {
+  EmitIfBegin();
+  Dispatch(*expr.test);
+  EmitIfTest();
+  Dispatch(*expr.if_true);
+  EmitIfElse();
+  Dispatch(*expr.if_false);
+  EmitIfEnd();
+}
+
+void CodeGen::Visit(const NumberExprAST &expr) { EmitNumber(expr.val); }
+
+void CodeGen::Visit(const VariableExprAST &expr) { EmitVariable(expr.name_); }
+
+void CodeGen::Visit(const FunctionAST &ast) {
+  Scope scope;
+  EmitFunctionBegin(&scope, ast.proto->name, ast.proto->args);
+  Dispatch(*ast.body);
+  EmitFunctionEnd(ast.proto->args.size());
+}
+
 void CodeGen::Visit(const PrototypeAST &ast) { _globals.insert(ast.name); }
 
+void CodeGen::Generate(const FlatAst &form) {
+  // At most one function per form, so its scope can live here.
+  Scope scope;
+
+  const bool loop = FindSelfTailCalls(form, &_tail_calls);
+  form.CountUses(&_uses);
+  _temps.assign(form.size(), -1);
+  _available.assign(form.size(), false);
+  _stored.clear();
+  const FlatAst::Node &root = form[form.root()];
+  const int argc = root.kind == AstKind::kFunction
+                       ? form.params(form[root.operands[0]]).size()
+                       : 0;
+  int temps = 0;
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    AstKind kind = form[i].kind;
+    if (_uses[i] > 1 && (kind == AstKind::kBinary ||
+                         kind == AstKind::kCall || kind == AstKind::kIf))
+      _temps[i] = 5 * temps++;
+  }
+  // Temporaries stored inside an `if` branch are forgotten when it ends,
+  // back to the mark taken before the branch.
+  std::vector<std::size_t> marks;
+  auto forget = [&](std::size_t mark) {
+    for (std::size_t j = mark; j < _stored.size(); ++j)
+      _available[_stored[j]] = false;
+    _stored.resize(mark);
+  };
+
+  form.Walk(form.root(), [&](const FlatAst::Node &n, int step) {
+    const FlatAst::Index index = form.index_of(n);
+    const int temp = _temps[index];
+    if (temp >= 0 && step == 0 && _available[index]) {
+      EmitLoad(temp);
+      return FlatAst::kNone;
+    }
+    switch (n.kind) {
+    case AstKind::kNumber:
+      EmitNumber(n.value);
+      break;
+    case AstKind::kVariable:
+      // Variables resolved by ResolveScopes need no lookup.  Parameter i of
+      // argc sits above the temporaries, nearer the stack pointer the later
+      // it comes.
+      if (n.operands[0] != FlatAst::kNone)
+        EmitLoad(5 * (temps + argc - 1 - static_cast<int>(n.operands[0])));
+      else
+        EmitVariable(n.name);
+      break;
+    case AstKind::kBinary:
+      switch (step) {
+      case 0:
+        return n.operands[1];
+      case 1:
+        EmitBinaryMiddle();
+        return n.operands[0];
+      default:
+        EmitBinaryEnd(n.op);
+      }
+      break;
+    case AstKind::kCall: {
+      FlatAst::Range<FlatAst::Index> args = form.args(n);
+      const int argc = args.size();
+      if (step == 0)
+        EmitCallBegin(n.name);
+      else
+        EmitCallArgEnd();
+      if (step < argc) {
+        EmitCallArgBegin(step);
+        return args[step];
+      }
+      if (_tail_calls[index])
+        EmitTailCall(form.params(form[form[form.root()].operands[0]]));
+      else
+        EmitCallEnd(n.name, argc);
+      break;
+    }
+    case AstKind::kIf:
+      switch (step) {
+      case 0:
+        EmitIfBegin();
+        return n.operands[0];
+      case 1:
+        EmitIfTest();
+        marks.push_back(_stored.size());
+        return n.operands[1];
+      case 2:
+        forget(marks.back());
+        EmitIfElse();
+        return n.operands[2];
+      default:
+        forget(marks.back());
+        marks.pop_back();
+        EmitIfEnd();
+      }
+      break;
+    case AstKind::kPrototype:
+      _globals.insert(n.name);
+      break;
+    case AstKind::kFunction: {
+      const FlatAst::Node &proto = form[n.operands[0]];
+      if (step == 0) {
+        EmitFunctionBegin(&scope, proto.name, form.params(proto), temps,
+                          loop);
+        return n.operands[1];
+      }
+      EmitFunctionEnd(form.params(proto).size(), temps);
+      break;
+    }
+    }
+    if (temp >= 0) {
+      EmitStore(temp);
+      _available[index] = true;
+      _stored.push_back(index);
+    }
+    return FlatAst::kNone;
+  });
+}
+
 void CodeGen::Line(int depth, std::string_view text) {
   for (int i = 0; i < depth * 4; ++i)
     _buffer.push_back(' ');
@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
@@ -10,35 +11,89 @@
 #include "absl/strings/str_join.h"
 #include "benscope/c64/cbm_floats.h"
 #include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/symbol.h"
 
 namespace benscope::c64 {
 
 struct Scope {
-  using VTable = absl::flat_hash_map<std::string, int>;
+  using VTable = absl::flat_hash_map<Symbol, int>;
 
   int offset = 0;
   VTable v_table;
 };
 
-class CodeGen : public AstVisitor {
+class CodeGen : public StaticAstVisitor<CodeGen> {
 public:
-  void Visit(const BinaryExprAST &expr) override;
-  void Visit(const CallExprAST &expr) override;
-  void Visit(const IfExprAST &expr) override;
-  void Visit(const NumberExprAST &expr) override;
-  void Visit(const VariableExprAST &expr) override;
+  void Visit(const BinaryExprAST &expr);
+  void Visit(const CallExprAST &expr);
+  void Visit(const IfExprAST &expr);
+  void Visit(const NumberExprAST &expr);
+  void Visit(const VariableExprAST &expr);
 
-  void Visit(const FunctionAST &ast) override;
-  void Visit(const PrototypeAST &ast) override;
+  void Visit(const FunctionAST &ast);
+  void Visit(const PrototypeAST &ast);
+
+  // Emits the same code as visiting the equivalent tree would, without
+  // recursing.  A binary, call or if node with more than one use (see
+  // HashConser) is computed once into a temporary on the stack and reloaded
+  // wherever its first evaluation dominates.  Self tail calls become jumps
+  // back to the start of the body.
+  void Generate(const FlatAst &form);
 
   std::string_view ToStringView();
   const std::string &ToString();
 
 private:
-  using VarSet = absl::flat_hash_set<std::string>;
+  using VarSet = absl::flat_hash_set<Symbol>;
+
+  // Emission shared by the tree and flat walks, split at the points where
+  // the code for a subexpression goes.  Each subexpression leaves its value
+  // in FAC.
+  //
+  //   Binary:   [rhs] Middle [lhs] End
+  //   Call:     Begin ( ArgBegin [arg] ArgEnd )* End
+  //   If:       Begin [test] Test [if_true] Else [if_false] End
+  //   Function: Begin [body] End
+  void EmitBinaryMiddle();
+  void EmitBinaryEnd(char op);
+  void EmitCallBegin(Symbol callee);
+  void EmitCallArgBegin(int arg);
+  void EmitCallArgEnd();
+  void EmitCallEnd(Symbol callee, int argc);
+  void EmitIfBegin();
+  void EmitIfTest();
+  void EmitIfElse();
+  void EmitIfEnd();
+  void EmitNumber(double value);
+  void EmitVariable(Symbol name);
+  // Loads FAC from, or stores it to, the stack `slot` bytes above the
+  // current frame's base.
+  void EmitLoad(int slot);
+  void EmitStore(int slot);
+  // Drops `bytes` from the stack.
+  void EmitPop(int bytes);
+  // Binds the arguments in `scope`, which must outlive the function body,
+  // above `temps` reserved temporaries of 5 bytes each.  With `loop`, the
+  // body is labelled for EmitTailCall to jump back to.
+  template <typename Args>
+  void EmitFunctionBegin(Scope *scope, Symbol name, const Args &args,
+                         int temps = 0, bool loop = false);
+  void EmitFunctionEnd(int argc, int temps = 0);
+  // Ends a self tail call whose arguments have been pushed like a call's:
+  // copies them over `params` and jumps back to the start of the body.
+  template <typename Params> void EmitTailCall(const Params &params);
 
   void Line(int depth, std::string_view text);
 
+  // Generate()'s scratch: use counts and temporary slots by node, and the
+  // shared nodes whose temporaries currently hold their values.
+  std::vector<std::uint32_t> _uses;
+  std::vector<int> _temps;
+  std::vector<bool> _available;
+  std::vector<FlatAst::Index> _stored;
+  std::vector<bool> _tail_calls;
+
   VarSet _globals;
   VarSet _zp_globals;
   Scope *_scope;
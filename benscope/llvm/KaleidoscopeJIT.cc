@@ -4,9 +4,152 @@
 
 #include "benscope/llvm/KaleidoscopeJIT.h"
 
+#include "llvm/Support/Error.h"
+
+#if BENSCOPE_KALEIDOSCOPEJIT_ORCV2
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#else
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/iterator_range.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/Mangler.h"
+#include "llvm/Support/DynamicLibrary.h"
+#endif
+
 namespace llvm::orc {
 
-KaleidoscopeJIT::KaleidoscopeJIT()
+#if BENSCOPE_KALEIDOSCOPEJIT_ORCV2
+
+KaleidoscopeJIT::KaleidoscopeJIT(unsigned NumCompileThreads) {
+  JITTargetMachineBuilder JTMB =
+      cantFail(JITTargetMachineBuilder::detectHost());
+  TM = cantFail(JTMB.createTargetMachine());
+  LLJITBuilder Builder;
+  Builder.setJITTargetMachineBuilder(std::move(JTMB));
+  // (bkeil) LLJIT can run its own compile threads, but doesn't say when they
+  // are done with a module: the object layer still holds on to it for a
+  // moment after its symbols are ready.  So we run them, and removeModule
+  // waits for them.
+  if (NumCompileThreads > 0) {
+    CompileThreads =
+        std::make_unique<ThreadPool>(hardware_concurrency(NumCompileThreads));
+    Builder.setCompileFunctionCreator([](JITTargetMachineBuilder JTMB)
+                                          -> Expected<std::unique_ptr<
+                                              IRCompileLayer::IRCompiler>> {
+      return std::make_unique<ConcurrentIRCompiler>(std::move(JTMB));
+    });
+  }
+  J = cantFail(Builder.create());
+  if (CompileThreads)
+    J->getExecutionSession().setDispatchTask(
+        [this](std::unique_ptr<Task> T) {
+          // ThreadPool only takes copyable functions.
+          CompileThreads->async([UnownedT = T.release()]() {
+            std::unique_ptr<Task>(UnownedT)->run();
+          });
+        });
+
+  // If we can't find the symbol in the JIT, try looking in the host process.
+  J->getMainJITDylib().addGenerator(
+      cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          J->getDataLayout().getGlobalPrefix())));
+  Newest = &J->getExecutionSession().createBareJITDylib("<newest>");
+
+  // (bkeil) The original only matched exported symbols, which doesn't seem to
+  // work on Debian under WSL2.
+  SearchOrder = {{Newest, JITDylibLookupFlags::MatchAllSymbols},
+                 {&J->getMainJITDylib(), JITDylibLookupFlags::MatchAllSymbols}};
+}
+
+KaleidoscopeJIT::~KaleidoscopeJIT() {
+  if (CompileThreads)
+    CompileThreads->wait();
+}
+
+VModuleKey KaleidoscopeJIT::addModule(std::unique_ptr<Module> M,
+                                      std::unique_ptr<LLVMContext> Context) {
+  ThreadSafeModule TSM(std::move(M), std::move(Context));
+  ExecutionSession &ES = J->getExecutionSession();
+  VModuleKey K = NextKey++;
+  ModuleInfo &Info = Modules[K];
+  std::string Name;
+  TSM.withModuleDo([&](Module &M) {
+    Name = std::string(M.getName());
+    Info.Symbols = definedSymbols(M);
+  });
+  Info.Dylib = &ES.createBareJITDylib("module." + std::to_string(K));
+  Info.Dylib->setLinkOrder(SearchOrder);
+  cantFail(J->addIRModule(*Info.Dylib, std::move(TSM)));
+
+  // Bind the module's names to its definitions from now on.  Each alias has
+  // a tracker of its own, since a later module may redefine only some of
+  // them.
+  for (const auto &Symbol : Info.Symbols) {
+    Alias &A = Aliases[Symbol.first];
+    if (A.Tracker)
+      cantFail(A.Tracker->remove());
+    A.Key = K;
+    A.Tracker = Newest->createResourceTracker();
+    cantFail(Newest->define(
+        reexports(*Info.Dylib, {{Symbol.first, {Symbol.first, Symbol.second}}},
+                  JITDylibLookupFlags::MatchAllSymbols),
+        A.Tracker));
+  }
+
+  if (Verbose)
+    llvm::errs() << "Added module (" << Name << ") with key (" << K
+                 << ") to JIT.\n";
+  return K;
+}
+
+void KaleidoscopeJIT::removeModule(VModuleKey K) {
+  if (CompileThreads)
+    CompileThreads->wait();
+  auto It = Modules.find(K);
+  // Names it defined that no later module redefined are left undefined.
+  for (const auto &Symbol : It->second.Symbols) {
+    auto A = Aliases.find(Symbol.first);
+    if (A != Aliases.end() && A->second.Key == K) {
+      cantFail(A->second.Tracker->remove());
+      Aliases.erase(A);
+    }
+  }
+  cantFail(J->getExecutionSession().removeJITDylib(*It->second.Dylib));
+  Modules.erase(It);
+  if (Verbose)
+    llvm::errs() << "Removed module with key (" << K << ") from JIT.";
+}
+
+JITSymbol KaleidoscopeJIT::findSymbol(const std::string Name) {
+  // Compiles the modules the symbol needs that are not compiled yet, on the
+  // compile threads if there are any, and waits for them.
+  Expected<JITEvaluatedSymbol> Sym = J->getExecutionSession().lookup(
+      SearchOrder, J->mangleAndIntern(Name));
+  if (!Sym) {
+    logAllUnhandledErrors(Sym.takeError(), errs(), "JIT lookup failed: ");
+    return nullptr;
+  }
+  return JITSymbol(Sym->getAddress(), Sym->getFlags());
+}
+
+SymbolFlagsMap KaleidoscopeJIT::definedSymbols(const Module &M) {
+  SymbolFlagsMap Symbols;
+  for (const GlobalValue &GV : M.global_values())
+    if (!GV.isDeclaration() && GV.hasName() && !GV.hasLocalLinkage())
+      Symbols[J->mangleAndIntern(GV.getName())] =
+          JITSymbolFlags::fromGlobalValue(GV);
+  return Symbols;
+}
+
+#else
+
+KaleidoscopeJIT::KaleidoscopeJIT(unsigned NumCompileThreads)
     : Resolver(createLegacyLookupResolver(
           ES,
           [this](StringRef Name) {
@@ -24,4 +167,60 @@ KaleidoscopeJIT::KaleidoscopeJIT()
   llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
 }
 
-} // namespace llvm::orc
\ No newline at end of file
+KaleidoscopeJIT::~KaleidoscopeJIT() = default;
+
+VModuleKey KaleidoscopeJIT::addModule(std::unique_ptr<Module> M,
+                                      std::unique_ptr<LLVMContext> Context) {
+  std::string Name = std::string(M->getName());
+  auto K = ES.allocateVModule();
+  // Compiles the module, which is gone before its context is.
+  cantFail(CompileLayer.addModule(K, std::move(M)));
+  ModuleKeys.push_back(K);
+  if (Verbose)
+    llvm::errs() << "Added module (" << Name << ") with key (" << K
+                 << ") to JIT.\n";
+  return K;
+}
+
+void KaleidoscopeJIT::removeModule(VModuleKey K) {
+  ModuleKeys.erase(find(ModuleKeys, K));
+  cantFail(CompileLayer.removeModule(K));
+  if (Verbose)
+    llvm::errs() << "Removed module with key (" << K << ") from JIT.";
+}
+
+JITSymbol KaleidoscopeJIT::findSymbol(const std::string Name) {
+  return findMangledSymbol(mangle(Name));
+}
+
+std::string KaleidoscopeJIT::mangle(const std::string &Name) {
+  std::string MangledName;
+  {
+    raw_string_ostream MangledNameStream(MangledName);
+    Mangler::getNameWithPrefix(MangledNameStream, Name, DL);
+  }
+  return MangledName;
+}
+
+JITSymbol KaleidoscopeJIT::findMangledSymbol(const std::string &Name) {
+  // (bkeil) The original only looked for exported symbols, which doesn't seem
+  // to work on Debian under WSL2.
+  const bool ExportedSymbolsOnly = false;
+
+  // Search modules in reverse order: from last added to first added.
+  // This is the opposite of the usual search order for dlsym, but makes more
+  // sense in a REPL where we want to bind to the newest available definition.
+  for (auto H : make_range(ModuleKeys.rbegin(), ModuleKeys.rend()))
+    if (auto Sym = CompileLayer.findSymbolIn(H, Name, ExportedSymbolsOnly))
+      return Sym;
+
+  // If we can't find the symbol in the JIT, try looking in the host process.
+  if (auto SymAddr = RTDyldMemoryManager::getSymbolAddressInProcess(Name))
+    return JITSymbol(SymAddr, JITSymbolFlags::Exported);
+
+  return nullptr;
+}
+
+#endif
+
+} // namespace llvm::orc
@@ -1,4 +1,3 @@
-  
 //===- KaleidoscopeJIT.h - A simple JIT for Kaleidoscope --------*- C++ -*-===//
 //
 // Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
@@ -13,111 +12,116 @@
 
 // (bkeil) Extracted constructor to .cc file, just to have a meaningful Bazel build target.
 
+// (bkeil) Rebuilt on ORCv2 (LLJIT), which compiles modules on a pool of
+// threads.  Each module is compiled when one of its symbols is first looked
+// up, together with the modules it calls into that are not compiled yet, so
+// the first call into many new functions compiles them all concurrently.
+// That needs the ORCv2 API of LLVM 13 or later.  The LLVM pinned in
+// WORKSPACE is older (and its generated llvm-config.h leaves the version at
+// 0), so there we keep the original ORCv1 layers, which compile each module
+// as it is added, on the thread that adds it.
+
 #ifndef LLVM_EXECUTIONENGINE_ORC_KALEIDOSCOPEJIT_H
 #define LLVM_EXECUTIONENGINE_ORC_KALEIDOSCOPEJIT_H
 
-#include "llvm/ADT/STLExtras.h"
-#include "llvm/ADT/iterator_range.h"
-#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/Config/llvm-config.h"
+
+#if LLVM_VERSION_MAJOR >= 13
+#define BENSCOPE_KALEIDOSCOPEJIT_ORCV2 1
+#else
+#define BENSCOPE_KALEIDOSCOPEJIT_ORCV2 0
+#endif
+
 #include "llvm/ExecutionEngine/JITSymbol.h"
-#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
-#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
-#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
-#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
-#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
-#include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DataLayout.h"
-#include "llvm/IR/Mangler.h"
-#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
-#include <algorithm>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
+
+#if BENSCOPE_KALEIDOSCOPEJIT_ORCV2
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/Support/ThreadPool.h"
+#else
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include <vector>
+#endif
 
 namespace llvm {
 namespace orc {
 
+#if BENSCOPE_KALEIDOSCOPEJIT_ORCV2
+// (bkeil) ORCv2 has no module keys of its own any more.
+using VModuleKey = uint64_t;
+#endif
+
 class KaleidoscopeJIT {
 public:
-  using ObjLayerT = LegacyRTDyldObjectLinkingLayer;
-  using CompileLayerT = LegacyIRCompileLayer<ObjLayerT, SimpleCompiler>;
-
-  KaleidoscopeJIT();
+  // (bkeil) With no compile threads, modules are compiled on the thread that
+  // looks up their symbols, one at a time.  Without ORCv2 there are never
+  // any.
+  explicit KaleidoscopeJIT(unsigned NumCompileThreads = 0);
+  ~KaleidoscopeJIT();
 
   TargetMachine &getTargetMachine() { return *TM; }
   const TargetMachine &getTargetMachine() const { return *TM; }
 
-  VModuleKey addModule(std::unique_ptr<Module> M) {
-    std::string name = std::string(M->getName());
-    auto K = ES.allocateVModule();
-    cantFail(CompileLayer.addModule(K, std::move(M)));
-    ModuleKeys.push_back(K);
-    llvm::errs() << "Added module (" << name << ") with key (" << K << ") to JIT.\n";
-    return K;
-  }
-
-  void removeModule(VModuleKey K) {
-    ModuleKeys.erase(find(ModuleKeys, K));
-    cantFail(CompileLayer.removeModule(K));
-    llvm::errs() << "Removed module with key (" << K << ") from JIT.";
-  }
-
-  JITSymbol findSymbol(const std::string Name) {
-    return findMangledSymbol(mangle(Name));
-  }
+  // (bkeil) Each module brings its own context, so that it can be compiled
+  // while modules in other contexts are.  The JIT frees the context with the
+  // module.
+  VModuleKey addModule(std::unique_ptr<Module> M,
+                       std::unique_ptr<LLVMContext> Context);
+
+  void removeModule(VModuleKey K);
+
+  // (bkeil) Whether to log modules as they are added and removed.
+  void setVerbose(bool V) { Verbose = V; }
+
+  JITSymbol findSymbol(const std::string Name);
 
 private:
-  std::string mangle(const std::string &Name) {
-    std::string MangledName;
-    {
-      raw_string_ostream MangledNameStream(MangledName);
-      Mangler::getNameWithPrefix(MangledNameStream, Name, DL);
-    }
-    return MangledName;
-  }
-
-  JITSymbol findMangledSymbol(const std::string &Name) {
-#ifdef _WIN32
-    // The symbol lookup of ObjectLinkingLayer uses the SymbolRef::SF_Exported
-    // flag to decide whether a symbol will be visible or not, when we call
-    // IRCompileLayer::findSymbolIn with ExportedSymbolsOnly set to true.
-    //
-    // But for Windows COFF objects, this flag is currently never set.
-    // For a potential solution see: https://reviews.llvm.org/rL258665
-    // For now, we allow non-exported symbols on Windows as a workaround.
-    const bool ExportedSymbolsOnly = false;
-#else
-    // (bkeil) Original line, but doesn't seem to work on Debian under WSL2.
-    // const bool ExportedSymbolsOnly = true;  
-    const bool ExportedSymbolsOnly = false;
-#endif
+#if BENSCOPE_KALEIDOSCOPEJIT_ORCV2
+  struct ModuleInfo {
+    JITDylib *Dylib;
+    SymbolFlagsMap Symbols;
+  };
 
-    // Search modules in reverse order: from last added to first added.
-    // This is the opposite of the usual search order for dlsym, but makes more
-    // sense in a REPL where we want to bind to the newest available definition.
-    for (auto H : make_range(ModuleKeys.rbegin(), ModuleKeys.rend()))
-      if (auto Sym = CompileLayer.findSymbolIn(H, Name, ExportedSymbolsOnly))
-        return Sym;
-
-    // If we can't find the symbol in the JIT, try looking in the host process.
-    if (auto SymAddr = RTDyldMemoryManager::getSymbolAddressInProcess(Name))
-      return JITSymbol(SymAddr, JITSymbolFlags::Exported);
-
-#ifdef _WIN32
-    // For Windows retry without "_" at beginning, as RTDyldMemoryManager uses
-    // GetProcAddress and standard libraries like msvcrt.dll use names
-    // with and without "_" (for example "_itoa" but "sin").
-    if (Name.length() > 2 && Name[0] == '_')
-      if (auto SymAddr =
-              RTDyldMemoryManager::getSymbolAddressInProcess(Name.substr(1)))
-        return JITSymbol(SymAddr, JITSymbolFlags::Exported);
-#endif
+  struct Alias {
+    VModuleKey Key = 0;
+    ResourceTrackerSP Tracker;
+  };
+
+  // The symbols a module defines, by mangled name.
+  SymbolFlagsMap definedSymbols(const Module &M);
+
+  std::unique_ptr<TargetMachine> TM;
+  // Outlives J, which may have work for it until it is gone.
+  std::unique_ptr<ThreadPool> CompileThreads;
+  std::unique_ptr<LLJIT> J;
+  // Every module goes into a JITDylib of its own, which links against Newest
+  // and then the host process.  Newest re-exports the newest definition of
+  // each name, so that, in a REPL, both lookups and the modules linked after
+  // a redefinition bind to it, while the code already linked keeps the one
+  // it was linked against.
+  JITDylib *Newest;
+  JITDylibSearchOrder SearchOrder;
+  DenseMap<SymbolStringPtr, Alias> Aliases;
+  std::map<VModuleKey, ModuleInfo> Modules;
+  VModuleKey NextKey = 1;
+#else
+  using ObjLayerT = LegacyRTDyldObjectLinkingLayer;
+  using CompileLayerT = LegacyIRCompileLayer<ObjLayerT, SimpleCompiler>;
 
-    return nullptr;
-  }
+  std::string mangle(const std::string &Name);
+  JITSymbol findMangledSymbol(const std::string &Name);
 
   ExecutionSession ES;
   std::shared_ptr<SymbolResolver> Resolver;
@@ -126,9 +130,11 @@ private:
   ObjLayerT ObjectLayer;
   CompileLayerT CompileLayer;
   std::vector<VModuleKey> ModuleKeys;
+#endif
+  bool Verbose = true;
 };
 
 } // end namespace orc
 } // end namespace llvm
 
-#endif // LLVM_EXECUTIONENGINE_ORC_KALEIDOSCOPEJIT_H
\ No newline at end of file
+#endif // LLVM_EXECUTIONENGINE_ORC_KALEIDOSCOPEJIT_H
@@ -1,153 +1,445 @@
 #ifndef __BENSCOPE_PARSING_CODEGEN_H__
 #define __BENSCOPE_PARSING_CODEGEN_H__
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <vector>
 
 #include "benscope/llvm/environment.h"
 #include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/transforms/tail_calls.h"
+#include "benscope/transforms/type_inference.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Type.h"
 
 namespace benscope {
 
-class ValueVisitor : public AstVisitor {
+class ValueVisitor : public StaticAstVisitor<ValueVisitor, llvm::Value *> {
 public:
   static llvm::Value *ValueOf(const AST &ast, Environment *environment) {
-    ValueVisitor vv(environment);
-    ast.Accept(vv);
-    return vv.value_;
+    return ValueVisitor(environment).Dispatch(ast);
   }
 
-  explicit ValueVisitor(Environment *environment)
-      : environment_(environment), value_(nullptr) {}
+  // Compiles the root of `form`, exactly as ValueOf on the equivalent tree.
+  // With `types`, the values TypeInference proved integers are computed as
+  // i64s, and a function form compiles to the clone that `types` describes.
+  static llvm::Value *ValueOf(const FlatAst &form, Environment *environment,
+                              const FormTypes *types = nullptr) {
+    return ValueVisitor(environment, types).GetValue(form, form.root());
+  }
+
+  explicit ValueVisitor(Environment *environment,
+                        const FormTypes *types = nullptr)
+      : environment_(environment), types_(types) {}
+
+  llvm::Value *Visit(const BinaryExprAST &expr) {
+    llvm::Value *l = Dispatch(*expr.lhs);
+    llvm::Value *r = Dispatch(*expr.rhs);
+    return EmitBinary(expr.op, l, r);
+  }
+
+  llvm::Value *Visit(const CallExprAST &expr) {
+    llvm::Function *callee = EmitCallee(expr.callee, expr.args.size());
+    if (!callee)
+      return nullptr;
+
+    std::vector<llvm::Value *> args;
+    for (auto &argExpr : expr.args) {
+      llvm::Value *v = Dispatch(*argExpr);
+      if (!v)
+        return nullptr;
+      args.push_back(v);
+    }
+    return EmitCallInst(callee, args);
+  }
+
+  llvm::Value *Visit(const IfExprAST &expr) {
+    IfBlocks blocks;
+    if (!EmitIfBegin(Dispatch(*expr.test), &blocks) ||
+        !EmitIfElse(&blocks, Dispatch(*expr.if_true)))
+      return nullptr;
+    return EmitIfEnd(&blocks, Dispatch(*expr.if_false));
+  }
+
+  llvm::Value *Visit(const NumberExprAST &expr) { return EmitNumber(expr.val); }
+
+  llvm::Value *Visit(const VariableExprAST &expr) {
+    return EmitVariable(expr.name_);
+  }
+
+  llvm::Value *Visit(const FunctionAST &ast) {
+    FunctionFrame frame;
+    if (!EmitFunctionBegin(*ast.proto, &frame))
+      return nullptr;
+    return EmitFunctionEnd(&frame, Dispatch(*ast.body));
+  }
+
+  llvm::Value *Visit(const PrototypeAST &ast) {
+    return environment_->CompileProto(ast);
+  }
+
+private:
+  struct IfBlocks {
+    llvm::BasicBlock *if_true, *if_false, *if_end;
+    llvm::Value *if_true_v;
+  };
+
+  struct FunctionFrame {
+    llvm::Function *f = nullptr;
+    Environment env;
+    Environment *outer;
+    // The parameters' values by number, for resolved variables.
+    std::vector<llvm::Value *> slots;
+    // With self tail calls: the block they jump back to, and the parameters'
+    // phis there.
+    llvm::BasicBlock *loop = nullptr;
+    std::vector<llvm::PHINode *> params;
+  };
+
+  // Walks `form` without recursion, keeping the values of finished
+  // subexpressions on a stack.  The value of a node with more than one use
+  // (see HashConser) is reused wherever its first evaluation dominates.
+  // Every value is an i64 if its node is an integer, otherwise a double.
+  llvm::Value *GetValue(const FlatAst &form, FlatAst::Index root) {
+    const FlatAst::Node &r = form[root];
+    if (r.kind == AstKind::kPrototype)
+      return environment_->CompileProto(MakePrototype(form, r));
+
+    std::vector<llvm::Value *> values;
+    std::vector<llvm::Function *> callees;
+    std::vector<IfBlocks> ifs;
+    FunctionFrame frame;
+    auto pop = [&values] {
+      llvm::Value *v = values.back();
+      values.pop_back();
+      return v;
+    };
+    // Records a finished subexpression, or stops on error.
+    auto push = [&values](llvm::Value *v) {
+      values.push_back(v);
+      return v ? FlatAst::kNone : FlatAst::kStop;
+    };
+
+    // Values of shared nodes, and the order they were recorded in.  Those
+    // recorded inside an `if` branch are dropped when it ends, back to the
+    // mark taken before the branch.
+    std::vector<std::uint32_t> uses;
+    form.CountUses(&uses);
+    std::vector<llvm::Value *> shared(form.size());
+    std::vector<FlatAst::Index> recorded;
+    std::vector<std::size_t> marks;
+    auto forget = [&](std::size_t mark) {
+      for (std::size_t j = mark; j < recorded.size(); ++j)
+        shared[recorded[j]] = nullptr;
+      recorded.resize(mark);
+    };
+    auto share = [&](FlatAst::Index index, llvm::Value *v) {
+      if (v && uses[index] > 1) {
+        shared[index] = v;
+        recorded.push_back(index);
+      }
+      return push(v);
+    };
+
+    std::vector<bool> tail_calls;
+    const bool loop = FindSelfTailCalls(form, &tail_calls);
+
+    bool ok = form.Walk(root, [&](const FlatAst::Node &n,
+                                  int step) -> FlatAst::Index {
+      const FlatAst::Index index = form.index_of(n);
+      const bool integer = IsInteger(index);
+      if (step == 0 && shared[index])
+        return push(shared[index]);
+      switch (n.kind) {
+      case AstKind::kNumber:
+        return push(integer ? EmitInteger(n.value) : EmitNumber(n.value));
+      case AstKind::kVariable:
+        // Variables resolved by ResolveScopes need no lookup.
+        return push(Coerce(n.operands[0] != FlatAst::kNone
+                               ? frame.slots[n.operands[0]]
+                               : EmitVariable(n.name),
+                           integer));
+      case AstKind::kBinary: {
+        if (step < 2)
+          return n.operands[step];
+        llvm::Value *rhs = pop(), *lhs = pop();
+        if (integer && IsInteger(n.operands[0]) && IsInteger(n.operands[1]))
+          return share(index, EmitIntegerBinary(n.op, lhs, rhs));
+        return share(index, Coerce(EmitBinary(n.op, Coerce(lhs, false),
+                                              Coerce(rhs, false)),
+                                   integer));
+      }
+      case AstKind::kCall: {
+        FlatAst::Range<FlatAst::Index> args = form.args(n);
+        if (step == 0 && !tail_calls[index]) {
+          llvm::Function *callee =
+              types_ && !types_->callee_params[index].empty()
+                  ? EmitClone(n.name, args.size(),
+                              types_->callee_params[index])
+                  : EmitCallee(n.name, args.size());
+          if (!callee)
+            return FlatAst::kStop;
+          callees.push_back(callee);
+        }
+        if (step < static_cast<int>(args.size()))
+          return args[step];
+        std::vector<llvm::Value *> arg_values(values.end() - args.size(),
+                                              values.end());
+        values.resize(values.size() - args.size());
+        if (tail_calls[index])
+          return push(EmitTailCall(&frame, arg_values));
+        llvm::Function *callee = callees.back();
+        callees.pop_back();
+        return share(index, EmitCallInst(callee, arg_values));
+      }
+      case AstKind::kIf:
+        switch (step) {
+        case 0:
+          return n.operands[0];
+        case 1:
+          ifs.emplace_back();
+          marks.push_back(recorded.size());
+          return EmitIfBegin(pop(), &ifs.back()) ? n.operands[1]
+                                                  : FlatAst::kStop;
+        case 2:
+          forget(marks.back());
+          return EmitIfElse(&ifs.back(), Coerce(pop(), integer))
+                     ? n.operands[2]
+                     : FlatAst::kStop;
+        default: {
+          forget(marks.back());
+          marks.pop_back();
+          llvm::Value *v = EmitIfEnd(&ifs.back(), Coerce(pop(), integer));
+          ifs.pop_back();
+          return share(index, v);
+        }
+        }
+      case AstKind::kFunction:
+        if (step == 0) {
+          return EmitFunctionBegin(MakePrototype(form, form[n.operands[0]]),
+                                   &frame, loop)
+                     ? n.operands[1]
+                     : FlatAst::kStop;
+        }
+        return push(EmitFunctionEnd(&frame, Coerce(pop(), false)));
+      case AstKind::kPrototype:
+        break;
+      }
+      return FlatAst::kStop;
+    });
+
+    if (ok)
+      return values.back();
+    if (frame.f)
+      EmitFunctionEnd(&frame, nullptr);
+    return nullptr;
+  }
+
+  bool IsInteger(FlatAst::Index index) const {
+    return types_ && types_->integer[index];
+  }
 
-  void Visit(const BinaryExprAST &expr) override {
-    llvm::Value *l = GetValue(*expr.lhs), *r = GetValue(*expr.rhs);
+  // Converts `v` to an i64 if `integer`, otherwise to a double.  Only values
+  // proved to be integers are converted to i64s, so nothing is rounded.
+  llvm::Value *Coerce(llvm::Value *v, bool integer) {
+    if (!v)
+      return nullptr;
+    llvm::IRBuilder<> &builder = *environment_->builder;
+    if (integer && v->getType()->isDoubleTy())
+      return builder.CreateFPToSI(v, builder.getInt64Ty(), "inttmp");
+    if (!integer && v->getType()->isIntegerTy())
+      return builder.CreateSIToFP(v, builder.getDoubleTy(), "fptmp");
+    return v;
+  }
+
+  static PrototypeAST MakePrototype(const FlatAst &form,
+                                    const FlatAst::Node &proto) {
+    FlatAst::Range<Symbol> params = form.params(proto);
+    return PrototypeAST(proto.name,
+                        std::vector<Symbol>(params.begin(), params.end()));
+  }
+
+  // Code generation shared by the tree and flat walks, split at the points
+  // where subexpressions are compiled.  Each returns null (or false) on
+  // error, having reported it.
+  llvm::Value *EmitBinary(char op, llvm::Value *l, llvm::Value *r) {
     if (!l || !r)
-      return;
+      return nullptr;
 
     llvm::IRBuilder<> &builder = *environment_->builder;
-    switch (expr.op) {
+    switch (op) {
     case '+':
-      value_ = builder.CreateFAdd(l, r, "addtmp");
-      break;
+      return builder.CreateFAdd(l, r, "addtmp");
     case '-':
-      value_ = builder.CreateFSub(l, r, "subtmp");
-      break;
+      return builder.CreateFSub(l, r, "subtmp");
     case '*':
-      value_ = builder.CreateFMul(l, r, "multmp");
-      break;
+      return builder.CreateFMul(l, r, "multmp");
     case '/':
-      value_ = builder.CreateFDiv(l, r, "divtmp");
-      break;
+      return builder.CreateFDiv(l, r, "divtmp");
     case '<': {
       llvm::Value *test = builder.CreateFCmpULT(l, r, "cmptmp");
-      value_ = builder.CreateUIToFP(
+      return builder.CreateUIToFP(
           test, llvm::Type::getDoubleTy(*environment_->context), "booltmp");
-      break;
     }
     default:
-      break;
+      return nullptr;
     }
   }
 
-  void Visit(const CallExprAST &expr) override {
-    llvm::Function *callee = environment_->LookupFunction(expr.callee);
+  // The same for two i64s, where `<` gives an i64 as well.
+  llvm::Value *EmitIntegerBinary(char op, llvm::Value *l, llvm::Value *r) {
+    if (!l || !r)
+      return nullptr;
 
-    if (!callee) {
-      std::cerr << "Unknown function " << expr.callee << "\n";
-      return;
+    llvm::IRBuilder<> &builder = *environment_->builder;
+    switch (op) {
+    case '+':
+      return builder.CreateAdd(l, r, "addtmp");
+    case '-':
+      return builder.CreateSub(l, r, "subtmp");
+    case '*':
+      return builder.CreateMul(l, r, "multmp");
+    case '<':
+      return builder.CreateZExt(builder.CreateICmpSLT(l, r, "cmptmp"),
+                                builder.getInt64Ty(), "booltmp");
+    default:
+      return nullptr;
     }
+  }
+
+  // Resolves the function a call with `argc` arguments refers to.
+  llvm::Function *EmitCallee(Symbol callee_name, size_t argc) {
+    return EmitClone(callee_name, argc, {});
+  }
 
-    std::cerr << "Found function (" << expr.callee << "): ";
-    callee->print(llvm::errs());
+  // The same for its integer clone, unless `integer_params` is empty.
+  llvm::Function *EmitClone(Symbol callee_name, size_t argc,
+                            const std::vector<bool> &integer_params) {
+    llvm::Function *callee =
+        integer_params.empty()
+            ? environment_->LookupFunction(callee_name)
+            : environment_->LookupClone(callee_name, integer_params);
 
-    if (callee->arg_size() != expr.args.size()) {
-      std::cerr << "Wrong number of arguments to " << expr.callee << "\n";
-      return;
+    if (!callee) {
+      std::cerr << "Unknown function " << callee_name << "\n";
+      return nullptr;
     }
 
-    std::vector<llvm::Value *> args;
-    for (auto &argExpr : expr.args) {
-      llvm::Value *v = GetValue(*argExpr);
-      if (!v)
-        return;
-      args.push_back(v);
+    if (environment_->verbose) {
+      std::cerr << "Found function (" << callee_name << "): ";
+      callee->print(llvm::errs());
     }
 
-    value_ = environment_->builder->CreateCall(callee, args, "calltmp");
+    if (callee->arg_size() != argc) {
+      std::cerr << "Wrong number of arguments to " << callee_name << "\n";
+      return nullptr;
+    }
+    return callee;
+  }
+
+  // Passes each argument as the type of its parameter.
+  llvm::Value *EmitCallInst(llvm::Function *callee,
+                            std::vector<llvm::Value *> args) {
+    for (std::size_t i = 0; i < args.size(); ++i)
+      args[i] = Coerce(args[i], callee->getArg(i)->getType()->isIntegerTy());
+    return environment_->builder->CreateCall(callee, args, "calltmp");
   }
 
-  void Visit(const IfExprAST &expr) override {
-    llvm::Value *cond = GetValue(*expr.test);
+  // Branches on `cond` and leaves the builder in the if-true block.
+  bool EmitIfBegin(llvm::Value *cond, IfBlocks *blocks) {
     if (!cond) {
       std::cerr << "Error in compiling test of if-expression.\n";
-      return;
+      return false;
     }
 
     llvm::LLVMContext &context = *environment_->context;
     llvm::IRBuilder<> &builder = *environment_->builder;
 
     // Convert to bool.
-    cond = builder.CreateFCmpONE(
-        cond, llvm::ConstantFP::get(context, llvm::APFloat(0.0)), "iftest");
+    if (cond->getType()->isIntegerTy())
+      cond = builder.CreateICmpNE(cond, builder.getInt64(0), "iftest");
+    else
+      cond = builder.CreateFCmpONE(
+          cond, llvm::ConstantFP::get(context, llvm::APFloat(0.0)), "iftest");
     llvm::Function *parent = builder.GetInsertBlock()->getParent();
 
-    llvm::BasicBlock *if_true =
-        llvm::BasicBlock::Create(context, "if_true", parent);
-    llvm::BasicBlock *if_false = llvm::BasicBlock::Create(context, "if_false");
-    llvm::BasicBlock *if_end = llvm::BasicBlock::Create(context, "if_end");
+    blocks->if_true = llvm::BasicBlock::Create(context, "if_true", parent);
+    blocks->if_false = llvm::BasicBlock::Create(context, "if_false");
+    blocks->if_end = llvm::BasicBlock::Create(context, "if_end");
 
-    builder.CreateCondBr(cond, if_true, if_false);
+    builder.CreateCondBr(cond, blocks->if_true, blocks->if_false);
+
+    builder.SetInsertPoint(blocks->if_true);
+    return true;
+  }
 
-    builder.SetInsertPoint(if_true);
-    llvm::Value* if_true_v = GetValue(*expr.if_true);
+  // Closes the if-true block and leaves the builder in the if-false block.
+  bool EmitIfElse(IfBlocks *blocks, llvm::Value *if_true_v) {
     if (!if_true_v) {
       std::cerr << "Error compiling if-true branch of if-expression.";
-      return;
+      return false;
     }
-    builder.CreateBr(if_end);
-    if_true = builder.GetInsertBlock();
+    llvm::IRBuilder<> &builder = *environment_->builder;
+    builder.CreateBr(blocks->if_end);
+    blocks->if_true = builder.GetInsertBlock();
+    blocks->if_true_v = if_true_v;
+
+    llvm::Function *parent = blocks->if_true->getParent();
+    parent->getBasicBlockList().push_back(blocks->if_false);
+    builder.SetInsertPoint(blocks->if_false);
+    return true;
+  }
 
-    parent->getBasicBlockList().push_back(if_false);
-    builder.SetInsertPoint(if_false);
-    llvm::Value* if_false_v = GetValue(*expr.if_false);
+  llvm::Value *EmitIfEnd(IfBlocks *blocks, llvm::Value *if_false_v) {
     if (!if_false_v) {
       std::cerr << "Error compiling if-true branch of if-expression.";
-      return;
+      return nullptr;
     }
-    builder.CreateBr(if_end);
-    if_false = builder.GetInsertBlock();
+    llvm::IRBuilder<> &builder = *environment_->builder;
+    builder.CreateBr(blocks->if_end);
+    blocks->if_false = builder.GetInsertBlock();
+
+    llvm::Function *parent = blocks->if_false->getParent();
+    parent->getBasicBlockList().push_back(blocks->if_end);
+    builder.SetInsertPoint(blocks->if_end);
+    llvm::PHINode *pn =
+        builder.CreatePHI(blocks->if_true_v->getType(), 2, "iftmp");
+    pn->addIncoming(blocks->if_true_v, blocks->if_true);
+    pn->addIncoming(if_false_v, blocks->if_false);
+    return pn;
+  }
 
-    parent->getBasicBlockList().push_back(if_end);
-    builder.SetInsertPoint(if_end);
-    llvm::PHINode *pn = builder.CreatePHI(llvm::Type::getDoubleTy(context), 2, "iftmp");
-    pn->addIncoming(if_true_v, if_true);
-    pn->addIncoming(if_false_v, if_false);
-    value_ = pn;
+  llvm::Value *EmitNumber(double value) {
+    return llvm::ConstantFP::get(*environment_->context, llvm::APFloat(value));
   }
 
-  void Visit(const NumberExprAST &expr) override {
-    value_ =
-        llvm::ConstantFP::get(*environment_->context, llvm::APFloat(expr.val));
-  };
+  llvm::Value *EmitInteger(double value) {
+    return environment_->builder->getInt64(static_cast<std::int64_t>(value));
+  }
 
-  void Visit(const VariableExprAST &expr) override {
-    llvm::Value *v = environment_->Lookup(expr.name_);
-    if (!v) {
-      std::cerr << "Unknown variable " << expr.name_ << "\n";
-    } else {
-      value_ = v;
-    }
-  };
+  llvm::Value *EmitVariable(Symbol name) {
+    llvm::Value *v = environment_->Lookup(name);
+    if (!v)
+      std::cerr << "Unknown variable " << name << "\n";
+    return v;
+  }
 
-  void Visit(const FunctionAST &ast) override {
-    auto &proto = environment_->RegisterProto(*ast.proto);
-    llvm::Function *f = environment_->LookupFunction(proto.name);
-    if (!f) {
-      value_ = nullptr;
-      return;
-    }
+  // Starts the function and switches environment_ to a child scope with the
+  // arguments bound, until EmitFunctionEnd.  `frame` must not move in between.
+  // With `loop`, the body starts in a block of its own that EmitTailCall can
+  // branch back to, and the parameters are bound to phis there.  With
+  // integer parameters in types_, this is the function's integer clone.
+  bool EmitFunctionBegin(const PrototypeAST &ast_proto, FunctionFrame *frame,
+                         bool loop = false) {
+    auto &proto = environment_->RegisterProto(ast_proto);
+    llvm::Function *f =
+        types_ && !types_->integer_params.empty()
+            ? environment_->LookupClone(proto.name, types_->integer_params)
+            : environment_->LookupFunction(proto.name);
+    if (!f)
+      return false;
 
     // Create a new basic block to start insertion into.
     llvm::BasicBlock *bb =
@@ -155,43 +447,76 @@ public:
     environment_->builder->SetInsertPoint(bb);
 
     // Record the function arguments in the NamedValues map.
-    Environment f_env = environment_->Spawn();
+    frame->env = environment_->Spawn();
+
+    if (loop) {
+      frame->loop = llvm::BasicBlock::Create(*environment_->context, "loop", f);
+      environment_->builder->CreateBr(frame->loop);
+      environment_->builder->SetInsertPoint(frame->loop);
+    }
+    unsigned idx = 0;
+    for (auto &arg : f->args()) {
+      llvm::Value *value = &arg;
+      if (loop) {
+        llvm::PHINode *phi = environment_->builder->CreatePHI(
+            arg.getType(), 2, proto.args[idx].name());
+        phi->addIncoming(&arg, bb);
+        frame->params.push_back(phi);
+        value = phi;
+      }
+      frame->env.named_values[proto.args[idx++]] = value;
+      frame->slots.push_back(value);
+    }
+
+    frame->f = f;
+    frame->outer = environment_;
+    environment_ = &frame->env;
+    return true;
+  }
 
-    for (auto &arg : f->args())
-      f_env.named_values[arg.getName()] = &arg;
+  // Passes `args` to the parameters' phis and branches back to the start of
+  // the body.  Code generation carries on in a fresh, unreachable block, so
+  // the returned value is undefined and only ever flows into dead phis.
+  llvm::Value *EmitTailCall(FunctionFrame *frame,
+                            const std::vector<llvm::Value *> &args) {
+    llvm::IRBuilder<> &builder = *environment_->builder;
+    for (std::size_t i = 0; i < args.size(); ++i) {
+      llvm::PHINode *param = frame->params[i];
+      param->addIncoming(Coerce(args[i], param->getType()->isIntegerTy()),
+                         builder.GetInsertBlock());
+    }
+    builder.CreateBr(frame->loop);
+
+    builder.SetInsertPoint(llvm::BasicBlock::Create(
+        *environment_->context, "after_tail_call", frame->f));
+    return llvm::UndefValue::get(llvm::Type::getDoubleTy(*environment_->context));
+  }
+
+  llvm::Value *EmitFunctionEnd(FunctionFrame *frame, llvm::Value *ret_val) {
+    environment_ = frame->outer;
+    llvm::Function *f = frame->f;
+    frame->f = nullptr;
 
-    if (llvm::Value *ret_val = GetValue(*ast.body, &f_env)) {
+    if (ret_val) {
       // Finish off the function.
       environment_->builder->CreateRet(ret_val);
-      llvm::errs() << "Defining function (" << f->getName() << ") in module ("
-                   << environment_->module->getName() << ")\n";
-      value_ = f;
-      return;
+      if (environment_->verbose)
+        llvm::errs() << "Defining function (" << f->getName()
+                     << ") in module (" << environment_->module->getName()
+                     << ")\n";
+      return f;
     }
 
     // Error reading body, remove function.
     llvm::errs() << "Error defining function.  Erasing from parent.\n";
     f->eraseFromParent();
-    value_ = nullptr;
-  };
-
-  void Visit(const PrototypeAST &ast) override {
-    value_ = environment_->CompileProto(ast);
-  };
-
-private:
-  llvm::Value *GetValue(AST &ast, Environment *env = nullptr) {
-    if (env == nullptr)
-      env = environment_;
-    ValueVisitor child(env);
-    ast.Accept(child);
-    return child.value_;
+    return nullptr;
   }
 
   Environment *environment_;
-  llvm::Value *value_;
+  const FormTypes *types_;
 };
 
 } // namespace benscope
 
-#endif // __BENSCOPE_PARSING_CODEGEN_H__
\ No newline at end of file
+#endif // __BENSCOPE_PARSING_CODEGEN_H__
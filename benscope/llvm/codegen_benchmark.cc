@@ -0,0 +1,123 @@
+// IR generation cost per AST node, for the pointer tree and the flat AST.
+// Run with --benchmark_counters_tabular=true.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "benscope/llvm/codegen.h"
+#include "benscope/llvm/environment.h"
+#include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+namespace benscope {
+namespace {
+
+// Nested arithmetic, conditionals and calls, `depth` levels deep.
+std::string MakeExpr(int depth, int seed) {
+  if (depth == 0)
+    return seed % 3 == 0 ? std::to_string(seed) : seed % 3 == 1 ? "a" : "b";
+  std::string l = MakeExpr(depth - 1, seed * 7 + 1);
+  std::string r = MakeExpr(depth - 1, seed * 5 + 2);
+  switch (seed % 4) {
+  case 0:
+    return "(+ " + l + " " + r + ")";
+  case 1:
+    return "(* " + l + " " + r + ")";
+  case 2:
+    return "(if " + l + " " + r + " " + MakeExpr(depth - 1, seed + 3) + ")";
+  default:
+    return "(f" + std::to_string(seed % 8) + " " + l + " " + r + ")";
+  }
+}
+
+std::string MakeSource(int forms) {
+  std::string source;
+  for (int f = 0; f < 8; ++f)
+    source += "(extern f" + std::to_string(f) + " (x y))\n";
+  for (int f = 0; f < forms; ++f)
+    source += "(def g" + std::to_string(f) + " (a b) " + MakeExpr(6, f) + ")\n";
+  return source;
+}
+
+const std::string &Source() {
+  static const std::string *source = new std::string(MakeSource(200));
+  return *source;
+}
+
+struct Compiler {
+  Compiler() : builder(context) {
+    environment.context = &context;
+    environment.builder = &builder;
+    environment.function_protos = &protos;
+    environment.verbose = false;
+  }
+
+  llvm::LLVMContext context;
+  llvm::IRBuilder<> builder;
+  absl::flat_hash_map<Symbol, PrototypeAST> protos;
+  Environment environment{};
+};
+
+void CountNodes(benchmark::State &state, int64_t nodes) {
+  state.counters["nodes/s"] = benchmark::Counter(
+      static_cast<double>(nodes), benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["ns/node"] = benchmark::Counter(
+      static_cast<double>(nodes),
+      benchmark::Counter::kIsIterationInvariantRate |
+          benchmark::Counter::kInvert);
+}
+
+void BM_CodeGenTree(benchmark::State &state) {
+  std::vector<std::unique_ptr<AST>> forms;
+  Parser parser(std::make_unique<Lexer>(Source()));
+  while (!parser.eof())
+    forms.push_back(parser.ParseNext());
+
+  Compiler compiler;
+  for (auto _ : state) {
+    llvm::Module module("bench", compiler.context);
+    compiler.environment.module = &module;
+    for (const auto &ast : forms)
+      benchmark::DoNotOptimize(
+          ValueVisitor::ValueOf(*ast, &compiler.environment));
+  }
+
+  int64_t nodes = 0;
+  Parser counter(std::make_unique<Lexer>(Source()));
+  for (FlatAst form; !counter.eof() && counter.ParseNext(&form);)
+    nodes += form.size();
+  CountNodes(state, nodes);
+}
+BENCHMARK(BM_CodeGenTree);
+
+void BM_CodeGenFlat(benchmark::State &state) {
+  std::vector<FlatAst> forms;
+  Parser parser(std::make_unique<Lexer>(Source()));
+  int64_t nodes = 0;
+  while (!parser.eof()) {
+    forms.emplace_back();
+    parser.ParseNext(&forms.back());
+    nodes += forms.back().size();
+  }
+
+  Compiler compiler;
+  for (auto _ : state) {
+    llvm::Module module("bench", compiler.context);
+    compiler.environment.module = &module;
+    for (const auto &form : forms)
+      benchmark::DoNotOptimize(
+          ValueVisitor::ValueOf(form, &compiler.environment));
+  }
+  CountNodes(state, nodes);
+}
+BENCHMARK(BM_CodeGenFlat);
+
+} // namespace
+} // namespace benscope
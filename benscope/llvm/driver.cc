@@ -1,16 +1,46 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <memory>
-#include <sstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
-#include "absl/strings/str_join.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/strip.h"
 #include "benscope/llvm/KaleidoscopeJIT.h"
 #include "benscope/llvm/codegen.h"
 #include "benscope/llvm/environment.h"
+#include "benscope/llvm/memoizer.h"
+#include "benscope/llvm/value_guards.h"
 #include "benscope/parsing/ast.h"
-#include "benscope/parsing/lexer.h"
-#include "benscope/parsing/parser.h"
+#include "benscope/parsing/ast_file.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/form_builder.h"
+#include "benscope/parsing/push_parser.h"
+#include "benscope/parsing/source_buffer.h"
+#include "benscope/transforms/call_graph.h"
+#include "benscope/transforms/constant_folder.h"
+#include "benscope/transforms/hash_conser.h"
+#include "benscope/transforms/inliner.h"
+#include "benscope/transforms/scope_resolver.h"
+#include "benscope/transforms/strength_reducer.h"
+#include "benscope/transforms/type_inference.h"
+#include "benscope/transforms/value_specializer.h"
+#include "benscope/vm/compiler.h"
+#include "benscope/vm/interpreter.h"
+#include "benscope/vm/program.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
@@ -26,63 +56,279 @@
 namespace benscope {
 namespace {
 
-void InitializeModuleAndPassManager(
-    const Environment &environment, const llvm::orc::KaleidoscopeJIT &jit,
-    llvm::StringRef module_name, std::unique_ptr<llvm::Module> *module,
-    std::unique_ptr<llvm::legacy::FunctionPassManager> *fpm) {
-  *module = std::make_unique<llvm::Module>(module_name, *environment.context);
-  (**module).setDataLayout(jit.getTargetMachine().createDataLayout());
+// Approximate latencies in cycles of the scalar SSE instructions on current
+// x86 cores.  Constants come from the constant pool and variables are already
+// in registers.
+constexpr CostModel kCosts = {
+    /*add=*/4, /*multiply=*/4, /*divide=*/14, /*number=*/1, /*variable=*/0};
+
+// A module being built.  Each has an LLVMContext of its own, since the JIT
+// compiles the modules that share a context one at a time.
+struct NewModule {
+  std::unique_ptr<llvm::LLVMContext> context;
+  std::unique_ptr<llvm::IRBuilder<>> builder;
+  std::unique_ptr<llvm::Module> module;
+  std::unique_ptr<llvm::legacy::FunctionPassManager> fpm;
+};
+
+// Starts a module and points the environment's context and builder to it.
+void InitializeModule(Environment *environment,
+                      const llvm::orc::KaleidoscopeJIT &jit,
+                      llvm::StringRef module_name, NewModule *m) {
+  m->context = std::make_unique<llvm::LLVMContext>();
+  m->builder = std::make_unique<llvm::IRBuilder<>>(*m->context);
+  m->module = std::make_unique<llvm::Module>(module_name, *m->context);
+  m->module->setDataLayout(jit.getTargetMachine().createDataLayout());
+  environment->context = m->context.get();
+  environment->builder = m->builder.get();
+}
 
-  *fpm = std::make_unique<llvm::legacy::FunctionPassManager>(module->get());
-  (**fpm).add(llvm::createInstructionCombiningPass());
-  (**fpm).add(llvm::createReassociatePass());
-  (**fpm).add(llvm::createGVNPass());
-  (**fpm).add(llvm::createCFGSimplificationPass());
-  (**fpm).doInitialization();
+void InitializeModuleAndPassManager(Environment *environment,
+                                    const llvm::orc::KaleidoscopeJIT &jit,
+                                    llvm::StringRef module_name,
+                                    NewModule *m) {
+  InitializeModule(environment, jit, module_name, m);
+  m->fpm =
+      std::make_unique<llvm::legacy::FunctionPassManager>(m->module.get());
+  m->fpm->add(llvm::createInstructionCombiningPass());
+  m->fpm->add(llvm::createReassociatePass());
+  m->fpm->add(llvm::createGVNPass());
+  m->fpm->add(llvm::createCFGSimplificationPass());
+  m->fpm->doInitialization();
 }
 
-void CompileFunction(Environment *environment, llvm::orc::KaleidoscopeJIT *jit,
-                     const FunctionAST &func) {
-  std::unique_ptr<llvm::Module> module;
-  std::unique_ptr<llvm::legacy::FunctionPassManager> fpm;
-  InitializeModuleAndPassManager(*environment, *jit, func.proto->name, &module,
-                                 &fpm);
+// Hands the module over to the JIT, which may compile it on another thread
+// from now on.
+llvm::orc::VModuleKey AddModule(Environment *environment,
+                                llvm::orc::KaleidoscopeJIT *jit,
+                                NewModule *m) {
+  environment->context = nullptr;
+  environment->builder = nullptr;
+  m->fpm.reset();
+  return jit->addModule(std::move(m->module), std::move(m->context));
+}
+
+// The prototype of a form's function or extern.
+const FlatAst::Node &FormProto(const FlatAst &form) {
+  const FlatAst::Node &root = form[form.root()];
+  return root.kind == AstKind::kFunction ? form[root.operands[0]] : root;
+}
+
+// Results are collected in one large buffer and written out in big blocks, not
+// flushed once per expression.
+class ResultWriter {
+public:
+  explicit ResultWriter(int fd) : fd_(fd) {}
+  ~ResultWriter() { Flush(); }
+
+  void Add(double value) {
+    absl::StrAppend(&buffer_, "Evaluated to ", value, "\n");
+    if (buffer_.size() >= kFlushBytes)
+      Flush();
+  }
+
+  void Prompt() {
+    buffer_ += "\nBenScope> ";
+    Flush();
+  }
+
+  void Flush() {
+    const char *data = buffer_.data();
+    std::size_t size = buffer_.size();
+    while (size > 0) {
+      ssize_t n = write(fd_, data, size);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      data += n;
+      size -= n;
+    }
+    buffer_.clear();
+  }
 
-  llvm::errs() << "Created module (" << module->getName() << ")\n";
+private:
+  static constexpr std::size_t kFlushBytes = 1 << 20;
+
+  int fd_;
+  std::string buffer_;
+};
+
+struct Session {
+  Environment *environment;
+  llvm::orc::KaleidoscopeJIT *jit;
+  ResultWriter *results;
+  // Whether to dump IR and log each step to stderr.  Errors are reported
+  // either way.
+  bool verbose;
+
+  std::int64_t forms = 0;
+  std::int64_t evaluated = 0;
+
+  // With --memoize, pure recursive functions are compiled behind a cache.
+  Memoizer *memoizer = nullptr;
+  // With --interpret, every form is compiled to bytecode and run by the
+  // interpreter instead, and nothing goes through LLVM.  With --tiered, the
+  // same, except that functions that get hot are compiled to native code
+  // (see Promote).
+  vm::Program *program = nullptr;
+  vm::Interpreter *interpreter = nullptr;
+  bool tiered = false;
+  // With --tiered, the functions compiled to native code since they were
+  // last defined.
+  absl::flat_hash_set<Symbol> native;
+  CallGraph call_graph;
+  // Integer clones of the functions defined so far.
+  TypeInference types;
+  // Clones for the constant arguments calls keep passing.
+  ValueSpecializer specializer;
+
+  // The source of each function defined so far, and the form that first
+  // defined it, for recompiling it when a function it calls is redefined.
+  struct Definition {
+    FlatAst source;
+    std::int64_t order;
+  };
+  absl::flat_hash_map<Symbol, Definition> definitions;
+
+  // Each form is rewritten into `folded` before it is compiled.
+  Inliner inliner{Inliner::kDefaultBudget};
+  ConstantFolder folder;
+  StrengthReducer reducer{kCosts};
+  HashConser conser;
+  FlatAst folded;
+};
+
+// Starts `f`, a version of function `name`, with a dispatch to each of the
+// function's value clones.  From an integer clone, a value clone's own
+// integer clone is called if the arguments left over allow it.
+void AddValueGuards(Session *session, Symbol name, llvm::Function *f) {
+  const std::vector<ValueClone> *clones = session->specializer.Clones(name);
+  if (!clones)
+    return;
+  Environment *environment = session->environment;
+  std::vector<ValueGuard> guards;
+  for (const ValueClone &clone : *clones) {
+    std::vector<bool> integer_args;
+    for (std::size_t i = 0; i < clone.values.size(); ++i) {
+      if (!clone.values[i] && i < f->arg_size())
+        integer_args.push_back(f->getArg(i)->getType()->isIntegerTy());
+    }
+    const std::vector<bool> *integer_params =
+        session->types.Clone(clone.name);
+    bool integer =
+        integer_params && integer_params->size() == integer_args.size();
+    for (std::size_t i = 0; integer && i < integer_args.size(); ++i)
+      integer = !(*integer_params)[i] || integer_args[i];
+    guards.push_back({clone.values,
+                      integer ? environment->LookupClone(clone.name,
+                                                         *integer_params)
+                              : environment->LookupFunction(clone.name)});
+  }
+  EmitValueGuards(f, guards, environment->builder);
+}
 
-  environment->module = module.get();
+void CompileFunction(Session *session, const FlatAst &func) {
+  Environment *environment = session->environment;
+  NewModule m;
+  InitializeModuleAndPassManager(environment, *session->jit,
+                                 ToStringRef(FormProto(func).name), &m);
+
+  if (session->verbose)
+    llvm::errs() << "Created module (" << m.module->getName() << ")\n";
+
+  // A memoized function keeps a single entry point, so that every call goes
+  // through its cache.
+  const Symbol name = FormProto(func).name;
+  const bool memoize = session->memoizer && session->call_graph.IsPure(name) &&
+                       session->call_graph.IsRecursive(name);
+  std::vector<bool> integer_params;
+  bool specialize = false;
+  if (memoize)
+    session->types.Forget(name);
+  else
+    specialize = session->types.Specialize(func, &integer_params);
+
+  environment->module = m.module.get();
+  FormTypes types = session->types.Infer(func);
   auto f = llvm::dyn_cast_or_null<llvm::Function>(
-      ValueVisitor::ValueOf(func, environment));
+      ValueVisitor::ValueOf(func, environment, &types));
+  llvm::Function *clone = nullptr;
+  if (f && specialize) {
+    FormTypes clone_types = session->types.Infer(func, integer_params);
+    clone = llvm::dyn_cast_or_null<llvm::Function>(
+        ValueVisitor::ValueOf(func, environment, &clone_types));
+  }
+  if (f)
+    AddValueGuards(session, name, f);
+  if (clone)
+    AddValueGuards(session, name, clone);
   environment->module = nullptr;
+  if (!clone)
+    session->types.Forget(name);
   if (!f) {
     std::cerr << "Error in compiling function.\n";
     return;
   }
 
-  std::cerr << "Function definition:\n";
-  f->print(llvm::errs());
-
-  std::cerr << "Function verification: " << llvm::verifyFunction(*f) << "\n";
-
-  fpm->run(*f);
+  if (session->verbose) {
+    std::cerr << "Function definition:\n";
+    f->print(llvm::errs());
+    std::cerr << "Function verification: " << llvm::verifyFunction(*f)
+              << "\n";
+    if (clone) {
+      std::cerr << "Integer clone:\n";
+      clone->print(llvm::errs());
+      std::cerr << "Clone verification: " << llvm::verifyFunction(*clone)
+                << "\n";
+    }
+  } else {
+    llvm::verifyFunction(*f, &llvm::errs());
+    if (clone)
+      llvm::verifyFunction(*clone, &llvm::errs());
+  }
 
-  std::cerr << "Function optimized to:\n";
-  f->print(llvm::errs());
+  llvm::Function *memo = nullptr;
+  if (memoize) {
+    if (session->verbose)
+      std::cerr << "Memoizing function (" << name << ").\n";
+    memo = session->memoizer->Wrap(f, environment->builder);
+  }
 
+  m.fpm->run(*f);
+  if (memo)
+    m.fpm->run(*memo);
+  if (clone)
+    m.fpm->run(*clone);
+
+  if (session->verbose) {
+    std::cerr << "Function optimized to:\n";
+    f->print(llvm::errs());
+    if (memo)
+      memo->print(llvm::errs());
+    if (clone)
+      clone->print(llvm::errs());
+  }
 
-  jit->addModule(std::move(module));
+  AddModule(environment, session->jit, &m);
 }
 
-void CompileExtern(Environment *environment, llvm::orc::KaleidoscopeJIT *jit,
-                   const PrototypeAST &proto) {
+void CompileExtern(Session *session, const FlatAst &form) {
+  Environment *environment = session->environment;
+  const FlatAst::Node &node = FormProto(form);
+  FlatAst::Range<Symbol> params = form.params(node);
+  PrototypeAST proto(node.name,
+                     std::vector<Symbol>(params.begin(), params.end()));
+
   std::string m_name = "__extern_";
-  m_name.append(proto.name);
-  std::unique_ptr<llvm::Module> module =
-      std::make_unique<llvm::Module>(m_name, *environment->context);
+  m_name.append(proto.name.name());
+  NewModule m;
+  InitializeModule(environment, *session->jit, m_name, &m);
 
   environment->RegisterProto(proto);
+  session->types.Forget(proto.name);
 
-  environment->module = module.get();
+  environment->module = m.module.get();
   auto f = llvm::dyn_cast_or_null<llvm::Function>(
       ValueVisitor::ValueOf(proto, environment));
   environment->module = nullptr;
@@ -91,35 +337,40 @@ void CompileExtern(Environment *environment, llvm::orc::KaleidoscopeJIT *jit,
     return;
   }
 
-  std::cerr << "Extern declaration:\n";
-  f->print(llvm::errs());
+  if (session->verbose) {
+    std::cerr << "Extern declaration:\n";
+    f->print(llvm::errs());
+  }
 
-  jit->addModule(std::move(module));
-  std::cerr << "Declaration added to JIT.\n";
+  AddModule(environment, session->jit, &m);
+  if (session->verbose)
+    std::cerr << "Declaration added to JIT.\n";
 }
 
-void ExecuteFunction(Environment *environment, llvm::orc::KaleidoscopeJIT *jit,
-                     const FunctionAST &func) {
-  std::unique_ptr<llvm::Module> module;
-  std::unique_ptr<llvm::legacy::FunctionPassManager> fpm;
-
-  InitializeModuleAndPassManager(*environment, *jit, "_anon_module", &module, &fpm);
+void ExecuteFunction(Session *session, const FlatAst &func) {
+  Environment *environment = session->environment;
+  llvm::orc::KaleidoscopeJIT *jit = session->jit;
+  NewModule m;
+  InitializeModuleAndPassManager(environment, *jit, "_anon_module", &m);
 
-  environment->module = module.get();
+  environment->module = m.module.get();
+  FormTypes types = session->types.Infer(func);
   auto f = llvm::dyn_cast_or_null<llvm::Function>(
-      ValueVisitor::ValueOf(func, environment));
+      ValueVisitor::ValueOf(func, environment, &types));
   environment->module = nullptr;
   if (!f) {
     std::cerr << "Error in compiling expression.\n";
     return;
   }
 
-  std::cerr << "Optimized anonymous function to:\n";
   llvm::verifyFunction(*f, &llvm::errs());
-  fpm->run(*f);
-  f->print(llvm::errs());
+  m.fpm->run(*f);
+  if (session->verbose) {
+    std::cerr << "Optimized anonymous function to:\n";
+    f->print(llvm::errs());
+  }
 
-  auto anon_module_key = jit->addModule(std::move(module));
+  auto anon_module_key = AddModule(environment, jit, &m);
   auto ExprSymbol = jit->findSymbol(std::string(kAnonExpr));
   if (ExprSymbol) {
     llvm::Expected<llvm::JITTargetAddress> address = ExprSymbol.getAddress();
@@ -129,11 +380,11 @@ void ExecuteFunction(Environment *environment, llvm::orc::KaleidoscopeJIT *jit,
       std::cerr << "Error: ";
       llvm::errs() << error << "\n";
     } else {
-      // Get the symbol's address and cast it to the right type (takes no
-      // arguments, returns a double) so we can call it as a native function.
-      double (*FP)() =
-          (double (*)())(intptr_t)llvm::cantFail(ExprSymbol.getAddress());
-      std::cout << "Evaluated to " << FP() << "\n";
+      // Cast the address to the right type (takes no arguments, returns a
+      // double) so we can call it as a native function.
+      double (*FP)() = (double (*)())(intptr_t)*address;
+      session->results->Add(FP());
+      ++session->evaluated;
     }
   } else {
     std::cerr << "Anonymous function symbol can't be found. Sad Trombone.";
@@ -141,71 +392,414 @@ void ExecuteFunction(Environment *environment, llvm::orc::KaleidoscopeJIT *jit,
 
   // Delete the anonymous expression module from the JIT.
   jit->removeModule(anon_module_key);
-  std::cerr << "Anonymous function removed from JIT.\n";
+  if (session->verbose)
+    std::cerr << "Anonymous function removed from JIT.\n";
 }
 
-void MainLoop(Environment *environment, llvm::orc::KaleidoscopeJIT *jit,
-              Parser *parser) {
-  while (!parser->eof()) {
-    std::unique_ptr<AST> ast = parser->ParseNext();
+// Compiles the form to bytecode and runs it if it is an expression.
+void Interpret(Session *session, const FlatAst &form) {
+  vm::Program &program = *session->program;
+  const Symbol name = FormProto(form).name;
+  session->native.erase(name);
+  if (!vm::Compile(form, &program)) {
+    std::cerr << "Error in compiling to bytecode.\n";
+    return;
+  }
+  const vm::Program::Index index = *program.Find(name);
+  if (session->verbose && form[form.root()].kind == AstKind::kFunction)
+    std::cerr << "Bytecode for (" << name << "):\n"
+              << vm::Disassemble(program, program[index]);
+  double value;
+  if (name == AnonExprSymbol() &&
+      session->interpreter->Call(index, nullptr, &value)) {
+    session->results->Add(value);
+    ++session->evaluated;
+  }
+}
 
-    if (!ast) {
-      std::cerr << "Trying to recover from error.\n";
-      parser->GetNextToken();
+// Runs a form through the passes into `session->folded`.  Returns false if
+// it had errors.
+bool Fold(Session *session, const FlatAst &parsed) {
+  FlatAst &form = session->folded;
+  form = parsed;
+  session->inliner.Run(&form);
+  session->folder.Run(&form);
+  session->reducer.Run(&form);
+  session->conser.Run(&form);
+  session->inliner.Define(form);
+  if (!ResolveScopes(&form))
+    return false;
+  // The calls as written, before inlining, are what the compiled code
+  // depends on.
+  if (FormProto(form).name != AnonExprSymbol())
+    session->call_graph.Define(parsed);
+  return true;
+}
+
+// Runs a form through the passes and compiles it, or executes it if it is
+// an expression.  Returns false if it had errors before code generation.
+bool Compile(Session *session, const FlatAst &parsed) {
+  if (!Fold(session, parsed))
+    return false;
+  const FlatAst &form = session->folded;
+  if (session->program) {
+    // Externs are declared to the JIT as well, for the native code of
+    // functions that call them.
+    if (session->tiered && form[form.root()].kind == AstKind::kPrototype)
+      CompileExtern(session, form);
+    Interpret(session, form);
+  } else if (form[form.root()].kind == AstKind::kPrototype) {
+    CompileExtern(session, form);
+  } else if (FormProto(form).name == AnonExprSymbol()) {
+    ExecuteFunction(session, form);
+  } else {
+    CompileFunction(session, form);
+  }
+  return true;
+}
+
+// Compiles function `index` of the interpreter's program to native code, as
+// without --interpret, and points the interpreter's calls to it there.  The
+// functions it can call that are still interpreted are compiled with it,
+// callees first, so that the native code has native code to call.
+void Promote(Session *session, vm::Program::Index index) {
+  vm::Program &program = *session->program;
+  std::vector<Symbol> promote;
+  std::vector<Symbol> pending = {program[index].name};
+  absl::flat_hash_set<Symbol> seen;
+  while (!pending.empty()) {
+    const Symbol name = pending.back();
+    pending.pop_back();
+    if (!seen.insert(name).second || session->native.contains(name) ||
+        !session->definitions.contains(name))
+      continue;
+    promote.push_back(name);
+    if (const std::vector<Symbol> *callees =
+            session->call_graph.Callees(name))
+      pending.insert(pending.end(), callees->begin(), callees->end());
+  }
+  auto order = [session](Symbol f) {
+    return session->definitions.at(f).order;
+  };
+  std::sort(promote.begin(), promote.end(),
+            [&order](Symbol a, Symbol b) { return order(a) < order(b); });
+
+  for (Symbol name : promote) {
+    if (session->verbose)
+      std::cerr << "Promoting function (" << name << ") to native code.\n";
+    if (!Fold(session, session->definitions.at(name).source))
+      continue;
+    CompileFunction(session, session->folded);
+    session->native.insert(name);
+  }
+  // The interpreter calls native code with only so many arguments; calls
+  // with more stay in bytecode.
+  for (Symbol name : promote) {
+    std::optional<vm::Program::Index> f = program.Find(name);
+    if (!f || program[*f].arity > vm::Program::kMaxNativeArity)
+      continue;
+    auto symbol = session->jit->findSymbol(std::string(name.name()));
+    if (!symbol) {
+      std::cerr << "Function symbol can't be found for " << name << ".\n";
+      continue;
+    }
+    llvm::Expected<llvm::JITTargetAddress> address = symbol.getAddress();
+    if (!address) {
+      std::cerr << "Unable to get address for function " << name << ".\n";
+      llvm::errs() << "Error: " << address.takeError() << "\n";
       continue;
     }
+    program[*f].native = reinterpret_cast<void *>(*address);
+  }
+}
 
-    AST *statement = ast.get();
-    if (auto *f_ast = dynamic_cast<FunctionAST *>(statement)) {
-      if (f_ast->proto->name == kAnonExpr) {
-        ExecuteFunction(environment, jit, *f_ast);
-      } else {
-        CompileFunction(environment, jit, *f_ast);
-      }
-    } else if (auto *p_ast = dynamic_cast<PrototypeAST *>(statement)) {
-      CompileExtern(environment, jit, *p_ast);
-    } else {
-      llvm::Value *value = ValueVisitor::ValueOf(*ast, environment);
-      std::cerr << "Unexpected AST.";
-      if (value) {
-        value->print(llvm::errs());
-      } else {
-        std::cerr << "No value.";
-      }
+// Records the constant arguments of the calls in `form`.  For each function
+// they make hot, compiles a clone for new constants, if any, and recompiles
+// the function to dispatch to it.
+void SpecializeValues(Session *session, const FlatAst &form) {
+  // The interpreter has no guards to dispatch to clones.
+  if (session->program)
+    return;
+  for (Symbol callee : session->specializer.Record(form)) {
+    auto it = session->definitions.find(callee);
+    FlatAst clone;
+    if (it == session->definitions.end() ||
+        !session->specializer.Specialize(it->second.source, &clone))
+      continue;
+    const Symbol name = FormProto(clone).name;
+    if (session->verbose)
+      std::cerr << "Specializing function (" << callee << ") as (" << name
+                << ").\n";
+    if (Compile(session, clone))
+      session->definitions[name] = {clone, session->forms};
+    Compile(session, session->definitions.at(callee).source);
+  }
+}
+
+// Compiles the form and, if it redefines a function, recompiles the
+// functions that depend on it, since they may have inlined it, specialized
+// their calls to it or decided it was pure.  The JIT binds new lookups to
+// the newest definitions, so the recompiled code supersedes the old.
+void HandleForm(Session *session, const FlatAst &parsed) {
+  ++session->forms;
+  const Symbol name = FormProto(parsed).name;
+  if (name == AnonExprSymbol()) {
+    // Clones made for this expression's calls already serve it.
+    SpecializeValues(session, parsed);
+    Compile(session, parsed);
+    return;
+  }
+
+  const bool redefined = session->definitions.contains(name);
+  if (redefined) {
+    // Value clones of the old definition are left to the JIT.
+    if (const std::vector<ValueClone> *clones =
+            session->specializer.Clones(name)) {
+      for (const ValueClone &clone : *clones)
+        session->definitions.erase(clone.name);
+    }
+    session->specializer.Forget(name);
+  }
+  if (!Compile(session, parsed))
+    return;
+  if (parsed[parsed.root()].kind == AstKind::kFunction) {
+    Session::Definition &definition = session->definitions[name];
+    if (!redefined)
+      definition.order = session->forms;
+    definition.source = parsed;
+  } else {
+    session->definitions.erase(name);
+  }
+
+  if (redefined) {
+    // Recompile in definition order, so that each dependent sees the new
+    // versions of the functions it can inline.
+    std::vector<Symbol> dependents = session->call_graph.Dependents(name);
+    dependents.erase(std::remove_if(dependents.begin(), dependents.end(),
+                                    [session](Symbol f) {
+                                      return !session->definitions.contains(f);
+                                    }),
+                     dependents.end());
+    auto order = [session](Symbol f) {
+      return session->definitions.at(f).order;
+    };
+    std::sort(dependents.begin(), dependents.end(),
+              [&order](Symbol a, Symbol b) { return order(a) < order(b); });
+    for (Symbol dependent : dependents) {
+      if (session->verbose)
+        std::cerr << "Recompiling function (" << dependent
+                  << "), which depends on (" << name << ").\n";
+      Compile(session, session->definitions.at(dependent).source);
     }
   }
+  SpecializeValues(session, parsed);
+}
+
+// Handles every form the input pushed so far completes.
+void Drain(Session *session, PushParser *parser) {
+  for (FormBuilder::Status status;
+       (status = parser->Next()) != FormBuilder::kNeedMore;) {
+    if (status == FormBuilder::kDone)
+      HandleForm(session, parser->form());
+    else
+      std::cerr << "Trying to recover from error.\n";
+  }
+}
+
+// Reads standard input as it becomes available, usually a line at a time
+// from a terminal, and handles each form as soon as it is complete.  Forms
+// may span any number of reads.
+void ReadLoop(Session *session, bool prompt) {
+  PushParser parser;
+  std::vector<char> buffer(64 << 10);
+  for (;;) {
+    if (prompt && !parser.in_progress())
+      session->results->Prompt();
+    ssize_t n = read(STDIN_FILENO, buffer.data(), buffer.size());
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    parser.Push(std::string_view(buffer.data(), n));
+    Drain(session, &parser);
+  }
+  parser.Finish();
+  Drain(session, &parser);
+}
+
+// Handles the forms of an AST file, without parsing anything.
+void RunAstFile(Session *session, const AstFile &file) {
+  FlatAst form;
+  for (std::size_t i = 0; i < file.size(); ++i) {
+    file.Load(i, &form);
+    HandleForm(session, form);
+  }
+}
+
+// Handles all of `source` as a single chunk.
+void RunSource(Session *session, std::string_view source) {
+  PushParser parser;
+  parser.Push(source);
+  Drain(session, &parser);
+  parser.Finish();
+  Drain(session, &parser);
+}
+
+int Usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [--batch] [--quiet | --verbose]"
+               " [--memoize [--memo-capacity=N] | --interpret |"
+               " --tiered [--hot-calls=N]] [--compile-threads=N]"
+               " [source-file]\n";
+  return 2;
 }
 
 } // namespace
 } // namespace benscope
 
-int main() {
-  llvm::InitializeNativeTarget();
-  llvm::InitializeNativeTargetAsmPrinter();
-  llvm::InitializeNativeTargetAsmParser();
-
-  auto jit = std::make_unique<llvm::orc::KaleidoscopeJIT>();
+// Usage: driver [--batch] [--quiet | --verbose]
+//               [--memoize [--memo-capacity=N] | --interpret |
+//                --tiered [--hot-calls=N]] [--compile-threads=N]
+//               [source-file]
+//
+// Without arguments, runs an interactive session on standard input, logging
+// each compilation step to stderr.  --batch, or a source file, instead runs
+// the whole input as one stream: no prompts, no logging unless --verbose,
+// and a summary of the run's time on stderr at the end.  The source file may
+// also be a binary AST file from ast_pack.
+//
+// --memoize caches the results of every pure, recursive function in a table
+// of N entries (4096 by default) and prints each table's hits and misses at
+// the end.
+//
+// --interpret compiles every form to bytecode for an interpreter instead of
+// to machine code.  Nothing is optimized by LLVM or linked into the JIT, so
+// each form takes microseconds to start, which pays off for short runs and
+// code that runs little.
+//
+// --tiered starts every function in the interpreter as well, and compiles
+// it to optimized native code once it has been called or looped N times
+// (1000 by default).  From then on, calls from the interpreter go to the
+// native code.
+//
+// --compile-threads sets how many threads compile functions to machine code
+// (by default, one per core if there are several).  A function is compiled
+// when an expression first calls it, together with the functions it calls
+// that are not compiled yet, so an expression that calls into many new
+// functions has them compiled in parallel.  With 0, they are compiled one at
+// a time on the main thread.  Built against an LLVM older than 13, functions
+// are always compiled on the main thread, as they are defined.
+int main(int argc, char *argv[]) {
+  bool batch = false;
+  std::optional<bool> verbose;
+  bool memoize = false;
+  bool interpret = false;
+  bool tiered = false;
+  std::size_t memo_capacity = 4096;
+  std::uint32_t hot_calls = 1000;
+  // A single core has nothing to compile in parallel with.
+  unsigned compile_threads = std::thread::hardware_concurrency();
+  if (compile_threads < 2)
+    compile_threads = 0;
+  const char *path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "--batch") {
+      batch = true;
+    } else if (arg == "--quiet") {
+      verbose = false;
+    } else if (arg == "--verbose") {
+      verbose = true;
+    } else if (arg == "--memoize") {
+      memoize = true;
+    } else if (arg == "--interpret") {
+      interpret = true;
+    } else if (arg == "--tiered") {
+      tiered = true;
+    } else if (absl::ConsumePrefix(&arg, "--hot-calls=")) {
+      if (!absl::SimpleAtoi(arg, &hot_calls) || hot_calls == 0)
+        return benscope::Usage(argv[0]);
+    } else if (absl::ConsumePrefix(&arg, "--compile-threads=")) {
+      if (!absl::SimpleAtoi(arg, &compile_threads))
+        return benscope::Usage(argv[0]);
+    } else if (absl::ConsumePrefix(&arg, "--memo-capacity=")) {
+      if (!absl::SimpleAtoi(arg, &memo_capacity) || memo_capacity == 0)
+        return benscope::Usage(argv[0]);
+    } else if (arg[0] != '-' && path == nullptr) {
+      path = argv[i];
+      batch = true;
+    } else {
+      return benscope::Usage(argv[0]);
+    }
+  }
+  if (memoize + interpret + tiered > 1)
+    return benscope::Usage(argv[0]);
+
+  std::unique_ptr<benscope::SourceBuffer> source;
+  if (path != nullptr && !(source = benscope::SourceBuffer::MapFile(path)))
+    return 1;
+  std::unique_ptr<benscope::AstFile> ast_file;
+  if (source && benscope::AstFile::HasMagic(source->view()) &&
+      !(ast_file = benscope::AstFile::FromBuffer(std::move(source))))
+    return 1;
+
+  std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+  if (!interpret) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+    jit = std::make_unique<llvm::orc::KaleidoscopeJIT>(compile_threads);
+  }
 
-  llvm::LLVMContext context;
-  llvm::IRBuilder<> builder(context);
-  absl::flat_hash_map<std::string, benscope::PrototypeAST> function_protos;
+  absl::flat_hash_map<benscope::Symbol, benscope::PrototypeAST> function_protos;
 
+  // The context and builder are those of the module being built.
   benscope::Environment environment;
-  environment.context = &context;
-  environment.builder = &builder;
+  environment.context = nullptr;
+  environment.builder = nullptr;
   environment.function_protos = &function_protos;
 
-  while (!std::cin.eof()) {
-    std::stringstream input;
-    std::string line;
-    std::cout << "\nBenScope> ";
-    std::getline(std::cin, line);
-
-    input << line;
-    auto lexer = std::make_unique<benscope::Lexer>(&input);
-    benscope::Parser parser(std::move(lexer));
-    benscope::MainLoop(&environment, jit.get(), &parser);
+  benscope::ResultWriter results(STDOUT_FILENO);
+  benscope::Session session{&environment, jit.get(), &results,
+                            verbose.value_or(!batch)};
+  environment.verbose = session.verbose;
+  if (jit)
+    jit->setVerbose(session.verbose);
+  std::optional<benscope::Memoizer> memoizer;
+  if (memoize)
+    session.memoizer = &memoizer.emplace(memo_capacity);
+  benscope::vm::Program program;
+  benscope::vm::Interpreter interpreter(&program);
+  if (interpret || tiered) {
+    session.program = &program;
+    session.interpreter = &interpreter;
+  }
+  if (tiered) {
+    session.tiered = true;
+    interpreter.SetHotHook(hot_calls,
+                           [&session](benscope::vm::Program::Index f) {
+                             benscope::Promote(&session, f);
+                           });
   }
 
+  auto start = std::chrono::steady_clock::now();
+  if (ast_file)
+    benscope::RunAstFile(&session, *ast_file);
+  else if (source)
+    benscope::RunSource(&session, source->view());
+  else
+    benscope::ReadLoop(&session, /*prompt=*/!batch);
+  results.Flush();
+
+  if (batch) {
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    std::cerr << "Handled " << session.forms << " forms and evaluated "
+              << session.evaluated << " expressions in " << seconds.count()
+              << " s (" << session.evaluated / seconds.count()
+              << " expressions/s).\n";
+  }
+  if (memoizer)
+    memoizer->PrintStats(&std::cerr);
   return 0;
-}
\ No newline at end of file
+}
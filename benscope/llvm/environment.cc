@@ -1,5 +1,7 @@
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "benscope/llvm/environment.h"
@@ -11,9 +13,9 @@
 
 namespace benscope {
 
-llvm::Value *Environment::Lookup(std::string_view name) {
-  if (named_values.contains(name)) {
-    return named_values[name];
+llvm::Value *Environment::Lookup(Symbol name) {
+  if (auto it = named_values.find(name); it != named_values.end()) {
+    return it->second;
   } else if (parent) {
     return parent->Lookup(name);
   } else {
@@ -26,10 +28,10 @@ const PrototypeAST &Environment::RegisterProto(const PrototypeAST &prototype) {
   return prototype;
 }
 
-llvm::Function *Environment::LookupFunction(const std::string &name) {
+llvm::Function *Environment::LookupFunction(Symbol name) {
   // First, see if the function has already been added to the current module.
   assert(module && "Module null");
-  if (auto *f = module->getFunction(name))
+  if (auto *f = module->getFunction(ToStringRef(name)))
     return f;
 
   // If not, check whether we can codegen the declaration from some existing
@@ -42,32 +44,58 @@ llvm::Function *Environment::LookupFunction(const std::string &name) {
   return nullptr;
 }
 
-llvm::Function *Environment::CompileProto(const PrototypeAST &proto) {
-  // Make the function type:  double(double,double) etc.
-  std::vector<llvm::Type *> doubles(proto.args.size(),
-                                    llvm::Type::getDoubleTy(*context));
+llvm::Function *Environment::LookupClone(
+    Symbol name, const std::vector<bool> &integer_params) {
+  assert(module && "Module null");
+  if (auto *f = module->getFunction(CloneName(name)))
+    return f;
+
+  auto proto_it = function_protos->find(name);
+  if (proto_it != function_protos->end())
+    return CompileProto(proto_it->second, integer_params);
+
+  return nullptr;
+}
+
+llvm::Function *Environment::CompileProto(
+    const PrototypeAST &proto, const std::vector<bool> &integer_params) {
+  // Make the function type:  double(double,double) etc., or with i64s for
+  // the integer parameters of a clone.
+  std::vector<llvm::Type *> params(proto.args.size(),
+                                   llvm::Type::getDoubleTy(*context));
+  for (std::size_t i = 0; i < integer_params.size(); ++i) {
+    if (integer_params[i])
+      params[i] = llvm::Type::getInt64Ty(*context);
+  }
   llvm::FunctionType *f_type = llvm::FunctionType::get(
-      llvm::Type::getDoubleTy(*context), doubles, false);
+      llvm::Type::getDoubleTy(*context), params, false);
 
-  llvm::errs() << "Declaring function (" << proto.name << ") in module ("
-               << module->getName() << ").\n";
+  const std::string name = integer_params.empty()
+                               ? std::string(proto.name.name())
+                               : CloneName(proto.name);
+  if (verbose)
+    llvm::errs() << "Declaring function (" << name << ") in module ("
+                 << module->getName() << ").\n";
   llvm::Function *f = llvm::Function::Create(
-      f_type, llvm::Function::ExternalLinkage, proto.name, module);
+      f_type, llvm::Function::ExternalLinkage, name, module);
 
   // Set names for all arguments.
   unsigned idx = 0;
   for (auto &arg : f->args())
-    arg.setName(proto.args[idx++]);
+    arg.setName(ToStringRef(proto.args[idx++]));
 
   return f;
 }
 
-const PrototypeAST *Environment::LookupProto(std::string_view name) {
-  if (function_protos->contains(name)) {
-    return &function_protos->at(name);
-  } else {
-    return nullptr;
-  }
+std::string Environment::CloneName(Symbol name) {
+  std::string clone(name.name());
+  clone.append(".int");
+  return clone;
+}
+
+const PrototypeAST *Environment::LookupProto(Symbol name) {
+  auto it = function_protos->find(name);
+  return it == function_protos->end() ? nullptr : &it->second;
 }
 
 Environment Environment::Spawn() {
@@ -76,6 +104,7 @@ Environment Environment::Spawn() {
   e.context = context;
   e.module = module;
   e.function_protos = function_protos;
+  e.verbose = verbose;
   e.parent = this;
   return e;
 }
@@ -2,9 +2,12 @@
 #define __BENSCOPE_PARSING_ENVIRONMENT_H__
 
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "benscope/parsing/ast.h"
+#include "benscope/parsing/symbol.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
@@ -12,35 +15,53 @@
 
 namespace benscope {
 
+inline llvm::StringRef ToStringRef(Symbol symbol) {
+  std::string_view name = symbol.name();
+  return llvm::StringRef(name.data(), name.size());
+}
+
 struct Environment {
   Environment *parent;
 
   llvm::IRBuilder<> *builder;
   llvm::LLVMContext *context;
   llvm::Module *module;
-  absl::flat_hash_map<std::string, PrototypeAST> *function_protos;
+  absl::flat_hash_map<Symbol, PrototypeAST> *function_protos;
+
+  absl::flat_hash_map<Symbol, llvm::Value *> named_values;
 
-  absl::flat_hash_map<std::string, llvm::Value *> named_values;
+  // Whether to log declarations, definitions and resolved calls to stderr.
+  // Errors are reported either way.
+  bool verbose = true;
 
   // Look up variable bindings.
-  llvm::Value *Lookup(std::string_view name);
+  llvm::Value *Lookup(Symbol name);
 
   // Register a function prototype with the environment.  New registrations
   // overwrite previous ones.
   const PrototypeAST &RegisterProto(const PrototypeAST &prototype);
 
   // Returns the most recently registered prototype for the given function name.
-  const PrototypeAST *LookupProto(std::string_view name);
+  const PrototypeAST *LookupProto(Symbol name);
 
   // Returns the function definition in the current module, if it exists,
   // otherwise, if a prototype exists for the function, registers an extern in
   // the current module for that function.  Returns null if there is neither a
   // current function nor a prototype.
-  llvm::Function *LookupFunction(const std::string& name);
+  llvm::Function *LookupFunction(Symbol name);
+
+  // Like LookupFunction, for the integer clone of the named function whose
+  // parameters marked in `integer_params` are i64s (see TypeInference).
+  llvm::Function *LookupClone(Symbol name,
+                              const std::vector<bool> &integer_params);
 
   // Records the prototype in the current module, as an externally linked
-  // function.
-  llvm::Function *CompileProto(const PrototypeAST &proto);
+  // function.  With `integer_params`, records its integer clone instead.
+  llvm::Function *CompileProto(const PrototypeAST &proto,
+                               const std::vector<bool> &integer_params = {});
+
+  // The name of the function's integer clone.
+  static std::string CloneName(Symbol name);
 
   // Spans an child environment with a new variable binding scope.  Bindings in
   // this environment are visible in the child, but same-name bindings in the
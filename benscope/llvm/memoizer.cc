@@ -0,0 +1,121 @@
+#include "benscope/llvm/memoizer.h"
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Type.h"
+
+namespace benscope {
+namespace {
+
+// 2^64 divided by the golden ratio: multiplying by it spreads the argument
+// bits into the top bits, which pick the slot.
+constexpr std::uint64_t kHashMultiplier = 0x9E3779B97F4A7C15ull;
+
+// A constant pointer to host memory, for the JIT code to use.
+llvm::Constant *HostPointer(llvm::LLVMContext &context, const void *address) {
+  return llvm::ConstantExpr::getIntToPtr(
+      llvm::ConstantInt::get(llvm::Type::getInt64Ty(context),
+                             reinterpret_cast<std::uintptr_t>(address)),
+      llvm::Type::getInt64PtrTy(context));
+}
+
+// Adds 1 to the host counter at `counter`.
+void EmitCount(llvm::IRBuilder<> *builder, const std::uint64_t *counter) {
+  llvm::LLVMContext &context = builder->getContext();
+  llvm::Type *i64 = llvm::Type::getInt64Ty(context);
+  llvm::Constant *address = HostPointer(context, counter);
+  builder->CreateStore(
+      builder->CreateAdd(builder->CreateLoad(i64, address),
+                         llvm::ConstantInt::get(i64, 1)),
+      address);
+}
+
+} // namespace
+
+Memoizer::Memoizer(std::size_t capacity) {
+  while ((std::size_t{1} << log2_capacity_) < capacity)
+    ++log2_capacity_;
+}
+
+llvm::Function *Memoizer::Wrap(llvm::Function *f, llvm::IRBuilder<> *builder) {
+  llvm::LLVMContext &context = f->getContext();
+  llvm::Type *i64 = llvm::Type::getInt64Ty(context);
+  llvm::Type *f64 = llvm::Type::getDoubleTy(context);
+  auto word = [&](std::uint64_t n) { return llvm::ConstantInt::get(i64, n); };
+
+  const std::string name = f->getName().str();
+  f->setName(name + ".impl");
+  f->setLinkage(llvm::Function::InternalLinkage);
+  llvm::Function *memo =
+      llvm::Function::Create(f->getFunctionType(),
+                             llvm::Function::ExternalLinkage, name,
+                             f->getParent());
+  f->replaceAllUsesWith(memo);
+
+  // Each entry is the argument bits, the result's bits, and a full flag.
+  const unsigned arity = f->arg_size();
+  const unsigned stride = arity + 2;
+  auto table = std::make_unique<Table>();
+  table->name = name;
+  table->words.assign(std::size_t{stride} << log2_capacity_, 0);
+
+  llvm::BasicBlock *entry = llvm::BasicBlock::Create(context, "entry", memo);
+  llvm::BasicBlock *hit = llvm::BasicBlock::Create(context, "hit", memo);
+  llvm::BasicBlock *miss = llvm::BasicBlock::Create(context, "miss", memo);
+
+  builder->SetInsertPoint(entry);
+  std::vector<llvm::Value *> args, bits;
+  llvm::Value *hash = word(0);
+  for (llvm::Argument &arg : memo->args()) {
+    arg.setName(f->getArg(args.size())->getName());
+    args.push_back(&arg);
+    bits.push_back(builder->CreateBitCast(&arg, i64, "bits"));
+    hash = builder->CreateMul(builder->CreateXor(hash, bits.back()),
+                              word(kHashMultiplier), "hash");
+  }
+  llvm::Value *slot = log2_capacity_ == 0
+                          ? static_cast<llvm::Value *>(word(0))
+                          : builder->CreateLShr(hash, 64 - log2_capacity_);
+  llvm::Value *memo_entry = builder->CreateGEP(
+      i64, HostPointer(context, table->words.data()),
+      builder->CreateMul(slot, word(stride)), "entry");
+  auto field = [&](unsigned i) {
+    return builder->CreateConstGEP1_32(i64, memo_entry, i);
+  };
+
+  llvm::Value *found = builder->CreateICmpNE(
+      builder->CreateLoad(i64, field(arity + 1)), word(0), "full");
+  for (unsigned i = 0; i < arity; ++i) {
+    found = builder->CreateAnd(
+        found, builder->CreateICmpEQ(builder->CreateLoad(i64, field(i)),
+                                     bits[i]));
+  }
+  builder->CreateCondBr(found, hit, miss);
+
+  builder->SetInsertPoint(hit);
+  EmitCount(builder, &table->hits);
+  builder->CreateRet(builder->CreateBitCast(
+      builder->CreateLoad(i64, field(arity)), f64, "cached"));
+
+  builder->SetInsertPoint(miss);
+  EmitCount(builder, &table->misses);
+  llvm::Value *result = builder->CreateCall(f, args, "result");
+  for (unsigned i = 0; i < arity; ++i)
+    builder->CreateStore(bits[i], field(i));
+  builder->CreateStore(builder->CreateBitCast(result, i64), field(arity));
+  builder->CreateStore(word(1), field(arity + 1));
+  builder->CreateRet(result);
+
+  tables_.push_back(std::move(table));
+  return memo;
+}
+
+void Memoizer::PrintStats(std::ostream *out) const {
+  for (const auto &table : tables_) {
+    *out << "Memoized " << table->name << ": " << table->hits << " hits, "
+         << table->misses << " misses in "
+         << (std::size_t{1} << log2_capacity_) << " entries.\n";
+  }
+}
+
+} // namespace benscope
@@ -0,0 +1,58 @@
+// Caches the results of pure functions in the JIT.
+
+#ifndef __BENSCOPE_LLVM_MEMOIZER_H__
+#define __BENSCOPE_LLVM_MEMOIZER_H__
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+
+namespace benscope {
+
+// Puts a cache in front of compiled functions whose result depends only on
+// their arguments (see CallGraph::IsPure), so that, for example, a doubly
+// recursive fib makes a linear number of calls instead of an exponential one.
+//
+// Each wrapped function gets a direct-mapped table of `capacity` entries,
+// allocated here and addressed from the generated code.  An entry is the
+// argument bits, the result and a full flag, contiguous, so a lookup touches
+// one or two cache lines.  The slot is chosen by a multiplicative hash of the
+// argument bits; a colliding result simply replaces the old one.  Arguments
+// are compared by bits, so 0 and -0 are cached apart.  The tables and their
+// hit and miss counts live as long as the memoizer, which must outlive the
+// JIT code.  Neither is thread-safe.
+class Memoizer {
+public:
+  // `capacity` is rounded up to a power of two.
+  explicit Memoizer(std::size_t capacity);
+
+  // Renames `f` to "<name>.impl" and defines, in the same module, a function
+  // called <name> that looks its arguments up in a new table and calls the
+  // renamed function only on a miss.  Every call to `f` already in the
+  // module, including its own recursive calls, is redirected through the
+  // cache.  Returns the new function.
+  llvm::Function *Wrap(llvm::Function *f, llvm::IRBuilder<> *builder);
+
+  // Prints a line per wrapped function with its hits and misses.
+  void PrintStats(std::ostream *out) const;
+
+private:
+  struct Table {
+    std::string name;
+    std::vector<std::uint64_t> words;
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+  };
+
+  int log2_capacity_ = 0;
+  std::vector<std::unique_ptr<Table>> tables_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_LLVM_MEMOIZER_H__
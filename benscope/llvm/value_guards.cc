@@ -0,0 +1,82 @@
+#include "benscope/llvm/value_guards.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Type.h"
+
+namespace benscope {
+
+void EmitValueGuards(llvm::Function *f, const std::vector<ValueGuard> &guards,
+                     llvm::IRBuilder<> *builder) {
+  llvm::LLVMContext &context = f->getContext();
+  llvm::Type *i64 = llvm::Type::getInt64Ty(context);
+  llvm::Type *f64 = llvm::Type::getDoubleTy(context);
+
+  // Built from the last guard back, each falling through to the test after
+  // it, and the last to the function's own entry.
+  llvm::BasicBlock *next = &f->getEntryBlock();
+  for (auto guard = guards.rbegin(); guard != guards.rend(); ++guard) {
+    if (!guard->clone || guard->values.size() != f->arg_size())
+      continue;
+
+    std::vector<llvm::Value *> tests, args;
+    bool possible = true;
+    for (unsigned i = 0; i < f->arg_size() && possible; ++i) {
+      llvm::Argument *arg = f->getArg(i);
+      const std::optional<double> &value = guard->values[i];
+      if (!value) {
+        args.push_back(arg);
+      } else if (arg->getType()->isIntegerTy()) {
+        possible = *value == std::trunc(*value) && std::fabs(*value) < 0x1p63 &&
+                   !(*value == 0 && std::signbit(*value));
+        tests.push_back(llvm::ConstantInt::get(
+            i64, possible ? static_cast<std::int64_t>(*value) : 0, true));
+      } else {
+        std::uint64_t bits;
+        std::memcpy(&bits, &*value, sizeof(bits));
+        tests.push_back(llvm::ConstantInt::get(i64, bits));
+      }
+    }
+    if (!possible || tests.empty() ||
+        args.size() != guard->clone->arg_size())
+      continue;
+
+    llvm::BasicBlock *test =
+        llvm::BasicBlock::Create(context, "guard", f, next);
+    llvm::BasicBlock *call =
+        llvm::BasicBlock::Create(context, "specialized", f, next);
+
+    builder->SetInsertPoint(test);
+    llvm::Value *match = nullptr;
+    unsigned t = 0;
+    for (unsigned i = 0; i < f->arg_size(); ++i) {
+      if (!guard->values[i])
+        continue;
+      llvm::Value *arg = f->getArg(i);
+      if (arg->getType()->isDoubleTy())
+        arg = builder->CreateBitCast(arg, i64, "bits");
+      llvm::Value *same = builder->CreateICmpEQ(arg, tests[t++], "same");
+      match = match ? builder->CreateAnd(match, same, "match") : same;
+    }
+    builder->CreateCondBr(match, call, next);
+
+    builder->SetInsertPoint(call);
+    for (unsigned i = 0; i < args.size(); ++i) {
+      if (args[i]->getType()->isIntegerTy() &&
+          guard->clone->getArg(i)->getType()->isDoubleTy())
+        args[i] = builder->CreateSIToFP(args[i], f64, "fptmp");
+    }
+    llvm::CallInst *result = builder->CreateCall(guard->clone, args, "clone");
+    result->setTailCall();
+    builder->CreateRet(result);
+
+    next = test;
+  }
+}
+
+} // namespace benscope
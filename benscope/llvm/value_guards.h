@@ -0,0 +1,33 @@
+// Dispatches calls with particular arguments to specialized clones.
+
+#ifndef __BENSCOPE_LLVM_VALUE_GUARDS_H__
+#define __BENSCOPE_LLVM_VALUE_GUARDS_H__
+
+#include <optional>
+#include <vector>
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+
+namespace benscope {
+
+// A clone of a function with some of its parameters replaced by constants
+// (see ValueSpecializer).
+struct ValueGuard {
+  // By parameter: the value the argument must have, if any.
+  std::vector<std::optional<double>> values;
+  // Called with the other arguments, in order, when all of them match.
+  llvm::Function *clone;
+};
+
+// Starts `f` with a test of its arguments for each guard in turn, before
+// its own entry block.  The first guard whose values all match tail calls
+// its clone, converting i64 arguments to doubles where the clone takes
+// doubles.  Doubles are compared bit for bit, so that 0 and -0 differ, and
+// i64 arguments (see TypeInference) only ever match integers.
+void EmitValueGuards(llvm::Function *f, const std::vector<ValueGuard> &guards,
+                     llvm::IRBuilder<> *builder);
+
+} // namespace benscope
+
+#endif // __BENSCOPE_LLVM_VALUE_GUARDS_H__
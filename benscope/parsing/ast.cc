@@ -2,15 +2,9 @@
 
 namespace benscope {
 
-void NumberExprAST::Accept(AstVisitor &visitor) const { visitor.Visit(*this); }
-void VariableExprAST::Accept(AstVisitor &visitor) const {
-  visitor.Visit(*this);
+Symbol AnonExprSymbol() {
+  static const Symbol anon_expr = Symbol::Intern(kAnonExpr);
+  return anon_expr;
 }
-void BinaryExprAST::Accept(AstVisitor &visitor) const { visitor.Visit(*this); }
-void CallExprAST::Accept(AstVisitor &visitor) const { visitor.Visit(*this); }
-void IfExprAST::Accept(AstVisitor &visitor) const { visitor.Visit(*this); }
 
-void FunctionAST::Accept(AstVisitor &visitor) const { visitor.Visit(*this); }
-void PrototypeAST::Accept(AstVisitor &visitor) const { visitor.Visit(*this); }
-
-} // namespace benscope
\ No newline at end of file
+} // namespace benscope
@@ -1,63 +1,91 @@
 #ifndef __BENSCOPE_PARSING_AST_H__
 #define __BENSCOPE_PARSING_AST_H__
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-namespace benscope {
+#include "benscope/parsing/symbol.h"
 
-class AstVisitor;
+namespace benscope {
 
 static constexpr std::string_view kAnonExpr = "__anon_expr";
 
+// kAnonExpr, interned.
+Symbol AnonExprSymbol();
+
+enum class AstKind : std::uint8_t {
+  kNumber,
+  kVariable,
+  kBinary,
+  kCall,
+  kIf,
+  kPrototype,
+  kFunction,
+};
+
+inline bool IsExpr(AstKind kind) {
+  return kind != AstKind::kPrototype && kind != AstKind::kFunction;
+}
+
+// Every node records its concrete type in `kind`, so code that needs to know
+// it can switch on the tag (or use StaticAstVisitor below) instead of going
+// through virtual calls or RTTI.
 struct AST {
+  explicit AST(AstKind kind) : kind(kind) {}
   virtual ~AST() {}
-  virtual void Accept(AstVisitor &visitor) const = 0;
+
+  AstKind kind;
 };
 
-struct ExprAST : public AST {};
+struct ExprAST : public AST {
+  using AST::AST;
+};
 
 struct NumberExprAST : public ExprAST {
-  explicit NumberExprAST(double value) : val(value) {}
-  void Accept(AstVisitor &visitor) const override;
+  static constexpr AstKind kKind = AstKind::kNumber;
+  explicit NumberExprAST(double value) : ExprAST(kKind), val(value) {}
 
   double val;
 };
 
 struct VariableExprAST : public ExprAST {
-  VariableExprAST(std::string_view name) : name_(name) {}
-  void Accept(AstVisitor &visitor) const override;
+  static constexpr AstKind kKind = AstKind::kVariable;
+  VariableExprAST(Symbol name) : ExprAST(kKind), name_(name) {}
 
-  std::string name_;
+  Symbol name_;
 };
 
 struct BinaryExprAST : public ExprAST {
+  static constexpr AstKind kKind = AstKind::kBinary;
   BinaryExprAST(char operation, std::unique_ptr<ExprAST> leftHS,
                 std::unique_ptr<ExprAST> rightHS)
-      : op(operation), lhs(std::move(leftHS)), rhs(std::move(rightHS)) {}
-  void Accept(AstVisitor &visitor) const override;
+      : ExprAST(kKind), op(operation), lhs(std::move(leftHS)),
+        rhs(std::move(rightHS)) {}
 
   char op;
   std::unique_ptr<ExprAST> lhs, rhs;
 };
 
 struct CallExprAST : public ExprAST {
-  CallExprAST(const std::string &Callee,
-              std::vector<std::unique_ptr<ExprAST>> Args)
-      : callee(Callee), args(std::move(Args)) {}
-  void Accept(AstVisitor &visitor) const override;
+  static constexpr AstKind kKind = AstKind::kCall;
+  CallExprAST(Symbol Callee, std::vector<std::unique_ptr<ExprAST>> Args)
+      : ExprAST(kKind), callee(Callee), args(std::move(Args)) {}
 
-  std::string callee;
+  Symbol callee;
   std::vector<std::unique_ptr<ExprAST>> args;
 };
 
 struct IfExprAST : public ExprAST {
+  static constexpr AstKind kKind = AstKind::kIf;
   IfExprAST(std::unique_ptr<ExprAST> Test, std::unique_ptr<ExprAST> If_true,
             std::unique_ptr<ExprAST> If_false)
-      : test(std::move(Test)), if_true(std::move(If_true)),
+      : ExprAST(kKind), test(std::move(Test)), if_true(std::move(If_true)),
         if_false(std::move(If_false)) {}
-  void Accept(AstVisitor &visitor) const override;
 
   std::unique_ptr<ExprAST> test, if_true, if_false;
 };
@@ -66,37 +94,82 @@ struct IfExprAST : public ExprAST {
 /// which captures its name, and its argument names (thus implicitly the number
 /// of arguments the function takes).
 struct PrototypeAST : public AST {
-  PrototypeAST() = default;
-  PrototypeAST(const std::string &name, std::vector<std::string> Args)
-      : name(name), args(std::move(Args)) {}
-  void Accept(AstVisitor &visitor) const override;
+  static constexpr AstKind kKind = AstKind::kPrototype;
+  PrototypeAST() : AST(kKind) {}
+  PrototypeAST(Symbol name, std::vector<Symbol> Args)
+      : AST(kKind), name(name), args(std::move(Args)) {}
 
-  std::string name;
-  std::vector<std::string> args;
+  Symbol name;
+  std::vector<Symbol> args;
 };
 
 /// FunctionAST - This class represents a function definition itself.
 struct FunctionAST : public AST {
 public:
+  static constexpr AstKind kKind = AstKind::kFunction;
   FunctionAST(std::unique_ptr<PrototypeAST> Proto,
               std::unique_ptr<ExprAST> Body)
-      : proto(std::move(Proto)), body(std::move(Body)) {}
-  void Accept(AstVisitor &visitor) const override;
+      : AST(kKind), proto(std::move(Proto)), body(std::move(Body)) {}
 
   std::unique_ptr<PrototypeAST> proto;
   std::unique_ptr<ExprAST> body;
 };
 
-class AstVisitor {
+// Checked downcasts on the kind tag.  AstCast returns null if `ast` is not a
+// T; ExprAST matches every expression kind.
+template <typename T> bool Is(const AST &ast) {
+  if constexpr (std::is_same_v<T, ExprAST>)
+    return IsExpr(ast.kind);
+  else
+    return ast.kind == T::kKind;
+}
+
+template <typename T> const T *AstCast(const AST *ast) {
+  return ast && Is<T>(*ast) ? static_cast<const T *>(ast) : nullptr;
+}
+
+template <typename T> T *AstCast(AST *ast) {
+  return ast && Is<T>(*ast) ? static_cast<T *>(ast) : nullptr;
+}
+
+// Takes ownership of `ast` as a T if it is one.  Otherwise returns null and
+// leaves `ast` alone.
+template <typename T> std::unique_ptr<T> AstCast(std::unique_ptr<AST> &ast) {
+  return Is<T>(*ast) ? std::unique_ptr<T>(static_cast<T *>(ast.release()))
+                     : nullptr;
+}
+
+// Compile-time dispatched visitation.  Derived supplies a
+//
+//   Result Visit(const XxxAST &)
+//
+// for each of the seven node types, and calls Dispatch() to visit a node of
+// unknown type, typically a child.  Dispatch switches on the kind tag and
+// calls the right overload directly, so there is no virtual call and no
+// visitor object per node, and each Visit returns its result instead of
+// stashing it in a member.
+template <typename Derived, typename Result = void> class StaticAstVisitor {
 public:
-  virtual void Visit(const BinaryExprAST &expr) = 0;
-  virtual void Visit(const CallExprAST &expr) = 0;
-  virtual void Visit(const IfExprAST &expr) = 0;
-  virtual void Visit(const NumberExprAST &expr) = 0;
-  virtual void Visit(const VariableExprAST &expr) = 0;
-
-  virtual void Visit(const FunctionAST &ast) = 0;
-  virtual void Visit(const PrototypeAST &ast) = 0;
+  Result Dispatch(const AST &ast) {
+    Derived &self = static_cast<Derived &>(*this);
+    switch (ast.kind) {
+    case AstKind::kNumber:
+      return self.Visit(static_cast<const NumberExprAST &>(ast));
+    case AstKind::kVariable:
+      return self.Visit(static_cast<const VariableExprAST &>(ast));
+    case AstKind::kBinary:
+      return self.Visit(static_cast<const BinaryExprAST &>(ast));
+    case AstKind::kCall:
+      return self.Visit(static_cast<const CallExprAST &>(ast));
+    case AstKind::kIf:
+      return self.Visit(static_cast<const IfExprAST &>(ast));
+    case AstKind::kPrototype:
+      return self.Visit(static_cast<const PrototypeAST &>(ast));
+    case AstKind::kFunction:
+      return self.Visit(static_cast<const FunctionAST &>(ast));
+    }
+    return Result();
+  }
 };
 
 } // namespace benscope
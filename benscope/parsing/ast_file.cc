@@ -0,0 +1,321 @@
+#include "benscope/parsing/ast_file.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace benscope {
+namespace {
+
+using ast_file::FormEntry;
+using ast_file::Header;
+
+std::size_t Align8(std::size_t n) { return (n + 7) & ~std::size_t{7}; }
+
+template <typename T>
+void Append(std::string *out, const T *data, std::size_t n) {
+  out->append(reinterpret_cast<const char *>(data), n * sizeof(T));
+}
+
+void Pad8(std::string *out) { out->resize(Align8(out->size()), '\0'); }
+
+bool Invalid(const char *message) {
+  std::cerr << "Bad AST file: " << message << "\n";
+  return false;
+}
+
+} // namespace
+
+std::uint32_t AstWriter::NameIndex(Symbol name) {
+  auto [it, inserted] = name_indices_.try_emplace(name, names_.size());
+  if (inserted)
+    names_.push_back(name);
+  return it->second;
+}
+
+void AstWriter::Add(const FlatAst &form) {
+  // Value-initialized, so that unused words are zero and equal forms give
+  // equal bytes.
+  std::vector<ast_file::Node> nodes(form.size());
+  std::vector<FlatAst::Index> args;
+  std::vector<std::uint32_t> params;
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    const FlatAst::Node &from = form[i];
+    ast_file::Node &to = nodes[i];
+    to.kind = from.kind;
+    to.op = from.op;
+    switch (from.kind) {
+    case AstKind::kNumber:
+      std::memcpy(&to.words[1], &from.value, sizeof(from.value));
+      break;
+    case AstKind::kVariable:
+      to.words[0] = NameIndex(from.name);
+      break;
+    case AstKind::kCall: {
+      FlatAst::Range<FlatAst::Index> call_args = form.args(from);
+      to.words[0] = NameIndex(from.name);
+      to.words[1] = args.size();
+      to.words[2] = call_args.size();
+      args.insert(args.end(), call_args.begin(), call_args.end());
+      break;
+    }
+    case AstKind::kPrototype:
+      to.words[0] = NameIndex(from.name);
+      to.words[1] = params.size();
+      to.words[2] = form.params(from).size();
+      for (Symbol param : form.params(from))
+        params.push_back(NameIndex(param));
+      break;
+    default:
+      std::memcpy(to.words, from.operands, sizeof(to.words));
+    }
+  }
+
+  entries_.push_back({form.root(), static_cast<std::uint32_t>(nodes.size()),
+                      static_cast<std::uint32_t>(args.size()),
+                      static_cast<std::uint32_t>(params.size()),
+                      forms_.size()});
+  Append(&forms_, nodes.data(), nodes.size());
+  Append(&forms_, args.data(), args.size());
+  Append(&forms_, params.data(), params.size());
+  Pad8(&forms_);
+}
+
+std::string AstWriter::Finish() const {
+  const std::size_t forms_offset =
+      sizeof(Header) + entries_.size() * sizeof(FormEntry);
+
+  Header header = {};
+  std::memcpy(header.magic, ast_file::kMagic, sizeof(header.magic));
+  header.version = ast_file::kVersion;
+  header.form_count = entries_.size();
+  header.name_count = names_.size();
+  header.names_offset = forms_offset + forms_.size();
+
+  std::string out;
+  Append(&out, &header, 1);
+  for (FormEntry entry : entries_) {
+    entry.offset += forms_offset;
+    Append(&out, &entry, 1);
+  }
+  out += forms_;
+
+  std::vector<std::uint32_t> offsets = {0};
+  std::string text;
+  for (Symbol name : names_) {
+    text += name.name();
+    offsets.push_back(text.size());
+  }
+  Append(&out, offsets.data(), offsets.size());
+  out += text;
+  return out;
+}
+
+bool AstWriter::WriteFile(const std::string &path) const {
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  std::string bytes = Finish();
+  if (!output.write(bytes.data(), bytes.size())) {
+    std::cerr << "Unable to write " << path << "\n";
+    return false;
+  }
+  return true;
+}
+
+FlatAst::Range<FlatAst::Index>
+AstFile::Form::args(const ast_file::Node &call) const {
+  const FlatAst::Index *begin = args_ + call.words[1];
+  return {begin, begin + call.words[2]};
+}
+
+FlatAst::Range<std::uint32_t>
+AstFile::Form::params(const ast_file::Node &proto) const {
+  const std::uint32_t *begin = params_ + proto.words[1];
+  return {begin, begin + proto.words[2]};
+}
+
+// static
+std::unique_ptr<AstFile> AstFile::Open(const std::string &path) {
+  std::unique_ptr<SourceBuffer> buffer = SourceBuffer::MapFile(path);
+  if (!buffer)
+    return nullptr;
+  return FromBuffer(std::move(buffer));
+}
+
+// static
+std::unique_ptr<AstFile>
+AstFile::FromBuffer(std::unique_ptr<SourceBuffer> buffer) {
+  std::unique_ptr<AstFile> file(new AstFile());
+  file->buffer_ = std::move(buffer);
+  if (!file->Validate())
+    return nullptr;
+  return file;
+}
+
+// static
+bool AstFile::HasMagic(std::string_view bytes) {
+  return bytes.size() >= sizeof(ast_file::kMagic) &&
+         std::memcmp(bytes.data(), ast_file::kMagic,
+                     sizeof(ast_file::kMagic)) == 0;
+}
+
+// Checks every offset, count and index once, up front, so that reading forms
+// afterwards needs no checks at all.  Children must precede their parents,
+// as in a FlatAst, which also rules out cycles.  This is a single pass over
+// the nodes, still far cheaper than lexing and parsing them.
+bool AstFile::Validate() {
+  std::string_view bytes = buffer_->view();
+  const char *base = bytes.data();
+  const std::size_t size = bytes.size();
+  if (reinterpret_cast<std::uintptr_t>(base) % 8 != 0)
+    return Invalid("buffer is not 8-byte aligned");
+  if (size < sizeof(Header) || !HasMagic(bytes))
+    return Invalid("wrong magic number");
+  header_ = reinterpret_cast<const Header *>(base);
+  if (header_->version != ast_file::kVersion)
+    return Invalid("unsupported version");
+
+  const std::size_t forms_offset =
+      sizeof(Header) + std::size_t{header_->form_count} * sizeof(FormEntry);
+  if (forms_offset > size)
+    return Invalid("truncated form table");
+  entries_ = reinterpret_cast<const FormEntry *>(base + sizeof(Header));
+
+  // Names.
+  // Offsets come from the file, so they are compared with the space left
+  // rather than added to, which could wrap around.
+  const std::uint64_t names_offset = header_->names_offset;
+  if (names_offset % 4 != 0 || names_offset < forms_offset ||
+      names_offset > size ||
+      std::uint64_t{header_->name_count} + 1 > (size - names_offset) / 4)
+    return Invalid("truncated name table");
+  const std::uint64_t text_offset =
+      names_offset + (std::uint64_t{header_->name_count} + 1) * 4;
+  const auto *name_offsets =
+      reinterpret_cast<const std::uint32_t *>(base + names_offset);
+  std::string_view text(base + text_offset, size - text_offset);
+  symbols_.reserve(header_->name_count);
+  for (std::uint32_t i = 0; i < header_->name_count; ++i) {
+    if (name_offsets[i] > name_offsets[i + 1] ||
+        name_offsets[i + 1] > text.size())
+      return Invalid("name out of bounds");
+    symbols_.push_back(Symbol::Intern(text.substr(
+        name_offsets[i], name_offsets[i + 1] - name_offsets[i])));
+  }
+
+  // Forms.
+  for (std::uint32_t f = 0; f < header_->form_count; ++f) {
+    const FormEntry &entry = entries_[f];
+    if (entry.offset % 8 != 0 || entry.offset < forms_offset ||
+        entry.offset > names_offset)
+      return Invalid("form out of bounds");
+    const std::uint64_t space = names_offset - entry.offset;
+    if (entry.node_count > space / sizeof(ast_file::Node) ||
+        std::uint64_t{entry.arg_count} + entry.param_count >
+            (space - entry.node_count * sizeof(ast_file::Node)) / 4)
+      return Invalid("form out of bounds");
+    if (entry.root >= entry.node_count)
+      return Invalid("bad root");
+
+    Form form = this->form(f);
+    for (FlatAst::Index i = 0; i < entry.node_count; ++i) {
+      const ast_file::Node &node = form[i];
+      auto child = [&](FlatAst::Index index) {
+        return index < i && IsExpr(form[index].kind);
+      };
+      auto span = [](const ast_file::Node &node, std::uint32_t count) {
+        return node.words[1] <= count && node.words[2] <= count - node.words[1];
+      };
+      const std::uint32_t *words = node.words;
+      bool ok;
+      switch (node.kind) {
+      case AstKind::kNumber:
+        ok = true;
+        break;
+      case AstKind::kVariable:
+        ok = words[0] < header_->name_count;
+        break;
+      case AstKind::kBinary:
+        ok = child(words[0]) && child(words[1]);
+        break;
+      case AstKind::kCall:
+        ok = words[0] < header_->name_count && span(node, entry.arg_count);
+        if (ok)
+          for (FlatAst::Index arg : form.args(node))
+            ok &= child(arg);
+        break;
+      case AstKind::kIf:
+        ok = child(words[0]) && child(words[1]) && child(words[2]);
+        break;
+      case AstKind::kPrototype:
+        ok = words[0] < header_->name_count && span(node, entry.param_count);
+        if (ok)
+          for (std::uint32_t param : form.params(node))
+            ok &= param < header_->name_count;
+        break;
+      case AstKind::kFunction:
+        ok = words[0] < i && form[words[0]].kind == AstKind::kPrototype &&
+             child(words[1]);
+        break;
+      default:
+        ok = false;
+      }
+      if (!ok)
+        return Invalid("malformed node");
+    }
+  }
+  return true;
+}
+
+AstFile::Form AstFile::form(std::size_t i) const {
+  Form form;
+  form.entry_ = &entries_[i];
+  const char *base = buffer_->view().data() + form.entry_->offset;
+  form.nodes_ = reinterpret_cast<const ast_file::Node *>(base);
+  form.args_ = reinterpret_cast<const FlatAst::Index *>(
+      form.nodes_ + form.entry_->node_count);
+  form.params_ = form.args_ + form.entry_->arg_count;
+  form.symbols_ = &symbols_;
+  return form;
+}
+
+void AstFile::Load(std::size_t i, FlatAst *out) const {
+  const Form form = this->form(i);
+  out->Clear();
+  std::vector<Symbol> params;
+  // Nodes are replayed in order, so each gets back its original index.
+  for (FlatAst::Index n = 0; n < form.size(); ++n) {
+    const ast_file::Node &node = form[n];
+    switch (node.kind) {
+    case AstKind::kNumber:
+      out->AddNumber(node.value());
+      break;
+    case AstKind::kVariable:
+      out->AddVariable(form.symbol(node.words[0]));
+      break;
+    case AstKind::kBinary:
+      out->AddBinary(node.op, node.words[0], node.words[1]);
+      break;
+    case AstKind::kCall: {
+      FlatAst::Range<FlatAst::Index> args = form.args(node);
+      out->AddCall(form.symbol(node.words[0]), args.begin(), args.size());
+      break;
+    }
+    case AstKind::kIf:
+      out->AddIf(node.words[0], node.words[1], node.words[2]);
+      break;
+    case AstKind::kPrototype:
+      params.clear();
+      for (std::uint32_t param : form.params(node))
+        params.push_back(form.symbol(param));
+      out->AddPrototype(form.symbol(node.words[0]), params.data(),
+                        params.size());
+      break;
+    case AstKind::kFunction:
+      out->AddFunction(node.words[0], node.words[1]);
+      break;
+    }
+  }
+  out->set_root(form.root());
+}
+
+} // namespace benscope
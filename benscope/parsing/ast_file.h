@@ -0,0 +1,161 @@
+// A binary file format for parsed forms, readable in place.
+
+#ifndef __BENSCOPE_PARSING_AST_FILE_H__
+#define __BENSCOPE_PARSING_AST_FILE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/source_buffer.h"
+#include "benscope/parsing/symbol.h"
+
+namespace benscope {
+
+// The file holds a sequence of FlatAst forms in nearly their in-memory layout,
+// so that loading one is a bounds check and a copy rather than a lex and
+// parse.  All offsets are from the start of the file and 8-byte aligned, and
+// numbers are in the writer's byte order.
+//
+//   Header       magic, version, counts and section offsets
+//   FormEntry[]  one per form: its root, node/arg/param counts and offset
+//   forms        per form: Node[nodes], uint32 args[], uint32 params[]
+//   names        uint32 offsets[names + 1], then the name bytes
+//
+// Symbols are process-local, so nodes and parameters refer to names by their
+// index in the name table instead, and a reader interns each name once when
+// it opens the file.
+namespace ast_file {
+
+inline constexpr char kMagic[8] = {'B', 'S', 'A', 'S', 'T', '\0', '\0', '\0'};
+// Bump on any change to the layout.  A file from a machine of the other byte
+// order fails this check too.
+inline constexpr std::uint32_t kVersion = 1;
+
+struct Header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t form_count;
+  std::uint32_t name_count;
+  std::uint32_t reserved;
+  std::uint64_t names_offset;
+};
+
+struct FormEntry {
+  std::uint32_t root;
+  std::uint32_t node_count;
+  std::uint32_t arg_count;
+  std::uint32_t param_count;
+  std::uint64_t offset;
+};
+
+// FlatAst::Node packed into 16 bytes: names are indices into the name table,
+// and a kind uses the three words as
+//
+//   kBinary: lhs, rhs.  kIf: test, if_true, if_false.  kFunction: proto, body.
+//   kVariable: name.  kCall, kPrototype: name, then the offset and length of
+//   the argument or parameter list.  kNumber: unused, then the value.
+struct Node {
+  AstKind kind;
+  // kBinary: the operator.
+  char op;
+  std::uint16_t reserved;
+  std::uint32_t words[3];
+
+  double value() const {
+    double value;
+    std::memcpy(&value, &words[1], sizeof(value));
+    return value;
+  }
+};
+
+static_assert(sizeof(Header) % 8 == 0 && sizeof(FormEntry) % 8 == 0 &&
+                  sizeof(Node) == 16,
+              "sections must stay 8-byte aligned");
+
+} // namespace ast_file
+
+// Collects forms and lays them out in the format above.
+class AstWriter {
+public:
+  void Add(const FlatAst &form);
+
+  // The file contents for every form added so far.
+  std::string Finish() const;
+
+  // Writes Finish() to `path`.  Returns false after reporting an error.
+  bool WriteFile(const std::string &path) const;
+
+private:
+  std::uint32_t NameIndex(Symbol name);
+
+  std::vector<ast_file::FormEntry> entries_;
+  // The forms' sections, with entries_' offsets relative to its start.
+  std::string forms_;
+  std::vector<Symbol> names_;
+  absl::flat_hash_map<Symbol, std::uint32_t> name_indices_;
+};
+
+// A file's forms, viewed where they lie in the mapped file.
+class AstFile {
+public:
+  // One form, read without copying.  Mirrors FlatAst's accessors, except
+  // that names are looked up through symbol().
+  class Form {
+  public:
+    FlatAst::Index root() const { return entry_->root; }
+    std::size_t size() const { return entry_->node_count; }
+    const ast_file::Node &operator[](FlatAst::Index index) const {
+      return nodes_[index];
+    }
+    FlatAst::Range<FlatAst::Index> args(const ast_file::Node &call) const;
+    // Name indices of a kPrototype node's parameters.
+    FlatAst::Range<std::uint32_t> params(const ast_file::Node &proto) const;
+    Symbol symbol(std::uint32_t name) const { return (*symbols_)[name]; }
+
+  private:
+    friend class AstFile;
+
+    const ast_file::FormEntry *entry_;
+    const ast_file::Node *nodes_;
+    const FlatAst::Index *args_;
+    const std::uint32_t *params_;
+    const std::vector<Symbol> *symbols_;
+  };
+
+  // Maps the file at `path`.  Returns null after reporting an error if it
+  // can't be read or is not a well-formed AST file.
+  static std::unique_ptr<AstFile> Open(const std::string &path);
+
+  // Reads the file from an existing buffer, which must be 8-byte aligned.
+  static std::unique_ptr<AstFile> FromBuffer(
+      std::unique_ptr<SourceBuffer> buffer);
+
+  // Whether `bytes` begin like an AST file.
+  static bool HasMagic(std::string_view bytes);
+
+  std::size_t size() const { return header_->form_count; }
+  Form form(std::size_t i) const;
+
+  // Rebuilds form `i` in `form`, as the parser would have built it.
+  void Load(std::size_t i, FlatAst *form) const;
+
+private:
+  AstFile() = default;
+  bool Validate();
+
+  std::unique_ptr<SourceBuffer> buffer_;
+  const ast_file::Header *header_ = nullptr;
+  const ast_file::FormEntry *entries_ = nullptr;
+  std::vector<Symbol> symbols_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_PARSING_AST_FILE_H__
@@ -0,0 +1,126 @@
+#include "benscope/parsing/ast_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "benscope/parsing/parallel_parser.h"
+#include "benscope/parsing/printer.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+constexpr std::string_view kSource =
+    "(extern sin (angle))\n"
+    "(def fib (a b n) (if (< n 2) b (fib b (+ a b) (- n 1))))\n"
+    "(fib 1 0 30) (sin 1.5)";
+
+std::string Pack(std::string_view source) {
+  AstWriter writer;
+  for (const FlatAst &form : ParseForms(source, 1))
+    writer.Add(form);
+  return writer.Finish();
+}
+
+std::unique_ptr<AstFile> Read(const std::string &bytes) {
+  std::istringstream input(bytes);
+  return AstFile::FromBuffer(SourceBuffer::ReadStream(&input));
+}
+
+std::string PrintAll(const AstFile &file) {
+  PrintingVisitor v;
+  FlatAst form;
+  for (std::size_t i = 0; i < file.size(); ++i) {
+    file.Load(i, &form);
+    v.Print(form);
+  }
+  return v.ToString();
+}
+
+TEST(AstFileTest, RoundTrips) {
+  PrintingVisitor expected;
+  for (const FlatAst &form : ParseForms(kSource, 1))
+    expected.Print(form);
+
+  std::string bytes = Pack(kSource);
+  EXPECT_TRUE(AstFile::HasMagic(bytes));
+  std::unique_ptr<AstFile> file = Read(bytes);
+  ASSERT_THAT(file, NotNull());
+  EXPECT_THAT(file->size(), Eq(4));
+  EXPECT_THAT(PrintAll(*file), Eq(expected.ToString()));
+}
+
+TEST(AstFileTest, ViewsFormsInPlace) {
+  std::unique_ptr<AstFile> file = Read(Pack("(extern sin (angle))"));
+  ASSERT_THAT(file, NotNull());
+  AstFile::Form form = file->form(0);
+  const ast_file::Node &proto = form[form.root()];
+  EXPECT_THAT(proto.kind, Eq(AstKind::kPrototype));
+  EXPECT_THAT(form.symbol(proto.words[0]), Eq(Symbol::Intern("sin")));
+  ASSERT_THAT(form.params(proto).size(), Eq(1));
+  EXPECT_THAT(form.symbol(form.params(proto)[0]), Eq(Symbol::Intern("angle")));
+}
+
+TEST(AstFileTest, RejectsDamage) {
+  const std::string good = Pack(kSource);
+  EXPECT_THAT(Read(good.substr(0, good.size() - 1)), IsNull());
+  EXPECT_THAT(Read("BSAST"), IsNull());
+
+  std::string bad_version = good;
+  bad_version[sizeof(ast_file::kMagic)] ^= 1;
+  EXPECT_THAT(Read(bad_version), IsNull());
+
+  // Make a binary node its own operand.  With one form, its nodes directly
+  // follow the header and the form table.
+  const std::string one = Pack("(+ 1 2)");
+  std::unique_ptr<AstFile> file = Read(one);
+  ASSERT_THAT(file, NotNull());
+  AstFile::Form form = file->form(0);
+  FlatAst::Index binary = 0;
+  while (form[binary].kind != AstKind::kBinary)
+    ++binary;
+  std::string cyclic = one;
+  std::memcpy(&cyclic[sizeof(ast_file::Header) + sizeof(ast_file::FormEntry) +
+                      binary * sizeof(ast_file::Node) +
+                      offsetof(ast_file::Node, words)],
+              &binary, sizeof(binary));
+  EXPECT_THAT(Read(cyclic), IsNull());
+}
+
+// Offsets so large that adding the table sizes to them wraps around.
+TEST(AstFileTest, RejectsOffsetsThatWrapAround) {
+  const std::string good = Pack(kSource);
+  std::string names = good;
+  const std::uint64_t names_offset = 0xFFFFFFFFFFFFFFF8;
+  std::memcpy(&names[offsetof(ast_file::Header, names_offset)], &names_offset,
+              sizeof(names_offset));
+  EXPECT_THAT(Read(names), IsNull());
+
+  std::string form = good;
+  const std::uint64_t form_offset = 0xFFFFFFFFFFFFFFF0;
+  std::memcpy(&form[sizeof(ast_file::Header) +
+                    offsetof(ast_file::FormEntry, offset)],
+              &form_offset, sizeof(form_offset));
+  EXPECT_THAT(Read(form), IsNull());
+
+  // A count that fits only if its size wraps around.
+  std::string count = good;
+  const std::uint32_t node_count = 0xFFFFFFFF;
+  std::memcpy(&count[sizeof(ast_file::Header) +
+                     offsetof(ast_file::FormEntry, node_count)],
+              &node_count, sizeof(node_count));
+  EXPECT_THAT(Read(count), IsNull());
+}
+
+} // namespace
+} // namespace benscope
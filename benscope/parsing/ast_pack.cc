@@ -0,0 +1,27 @@
+#include <iostream>
+#include <memory>
+
+#include "benscope/parsing/ast_file.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/parallel_parser.h"
+#include "benscope/parsing/source_buffer.h"
+
+// Usage: ast_pack source-file ast-file
+//
+// Parses the source file and writes its forms as a binary AST file, which the
+// drivers load in place of the source without lexing or parsing it.
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " source-file ast-file\n";
+    return 2;
+  }
+  std::unique_ptr<benscope::SourceBuffer> source =
+      benscope::SourceBuffer::MapFile(argv[1]);
+  if (!source)
+    return 1;
+
+  benscope::AstWriter writer;
+  for (const benscope::FlatAst &form : benscope::ParseForms(source->view()))
+    writer.Add(form);
+  return writer.WriteFile(argv[2]) ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+#include "benscope/parsing/char_class.h"
+
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BENSCOPE_AVX2_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace benscope::char_class {
+namespace {
+
+const char *SkipWhitespaceScalar(const char *p, const char *end) {
+  while (p != end && IsWhitespace(*p))
+    ++p;
+  return p;
+}
+
+const char *FindDelimiterScalar(const char *p, const char *end) {
+  while (p != end && !IsDelimiter(*p))
+    ++p;
+  return p;
+}
+
+// Most whitespace runs and words are only a few bytes long, where setting up
+// a vector compare costs more than it saves.  The SIMD scanners therefore try
+// this many bytes one at a time before switching to blocks.
+constexpr int kScalarPrologue = 8;
+
+// Advances `p` over up to kScalarPrologue bytes.  Returns true if it stopped
+// (at end or where `stop` holds) within them.
+template <typename Stop>
+bool ScalarPrologue(const char *&p, const char *end, Stop stop) {
+  for (int i = 0; i < kScalarPrologue; ++i, ++p) {
+    if (p == end || stop(*p))
+      return true;
+  }
+  return false;
+}
+
+bool NotWhitespace(char c) { return !IsWhitespace(c); }
+
+#if defined(__SSE2__)
+// SSE2 has no byte shuffle, so test each delimiter directly.  Bytes >= 0x80
+// compare as negative and so never land in the '\t'..'\r' range.
+__m128i WhitespaceMask(__m128i v) {
+  __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+  __m128i control = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+  return _mm_or_si128(space, control);
+}
+
+__m128i DelimiterMask(__m128i v) {
+  __m128i mask = WhitespaceMask(v);
+  for (char c : {'(', ')', '\'', '"', '`', ';', '|', '[', ']', '{', '}', '\4'})
+    mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+  return mask;
+}
+
+const char *SkipWhitespaceSse2(const char *p, const char *end) {
+  if (ScalarPrologue(p, end, NotWhitespace))
+    return p;
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    unsigned stop = ~_mm_movemask_epi8(WhitespaceMask(v)) & 0xFFFF;
+    if (stop != 0)
+      return p + __builtin_ctz(stop);
+  }
+  return SkipWhitespaceScalar(p, end);
+}
+
+const char *FindDelimiterSse2(const char *p, const char *end) {
+  if (ScalarPrologue(p, end, IsDelimiter))
+    return p;
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    unsigned stop = _mm_movemask_epi8(DelimiterMask(v));
+    if (stop != 0)
+      return p + __builtin_ctz(stop);
+  }
+  return FindDelimiterScalar(p, end);
+}
+#endif // __SSE2__
+
+#if defined(BENSCOPE_AVX2_DISPATCH)
+// Classifies 32 bytes at a time with two nibble lookups: every high nibble
+// that holds members of the class gets its own bit, and the low-nibble table
+// says which of those groups each low nibble belongs to.  A byte is in the
+// class iff lo[byte & 0xF] & hi[byte >> 4] is nonzero.
+struct NibbleTables {
+  std::uint8_t lo[16];
+  std::uint8_t hi[16];
+  int groups;
+};
+
+constexpr NibbleTables MakeNibbleTables(std::uint8_t cls) {
+  NibbleTables t{};
+  for (int h = 0; h < 16; ++h) {
+    std::uint8_t bit = static_cast<std::uint8_t>(1 << t.groups);
+    bool used = false;
+    for (int l = 0; l < 16; ++l) {
+      if (kTable[h << 4 | l] & cls) {
+        t.lo[l] |= bit;
+        used = true;
+      }
+    }
+    if (used) {
+      t.hi[h] = bit;
+      ++t.groups;
+    }
+  }
+  return t;
+}
+
+constexpr NibbleTables kWhitespaceNibbles = MakeNibbleTables(kWhitespace);
+constexpr NibbleTables kDelimiterNibbles = MakeNibbleTables(kDelimiter);
+static_assert(kWhitespaceNibbles.groups <= 8 && kDelimiterNibbles.groups <= 8,
+              "Character class spans too many high nibbles for one byte.");
+
+// Returns the first byte that is (kStopInClass) or isn't (!kStopInClass) in
+// the class described by `t`.
+template <bool kStopInClass>
+__attribute__((target("avx2"))) const char *
+ScanAvx2(const char *p, const char *end, const NibbleTables &t) {
+  const __m256i lo_table = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(t.lo)));
+  const __m256i hi_table = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(t.hi)));
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  for (; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i lo = _mm256_shuffle_epi8(lo_table, _mm256_and_si256(v, nibble));
+    __m256i hi = _mm256_shuffle_epi8(
+        hi_table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    __m256i outside =
+        _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+    unsigned outside_bits = static_cast<unsigned>(_mm256_movemask_epi8(outside));
+    unsigned stop = kStopInClass ? ~outside_bits : outside_bits;
+    if (stop != 0)
+      return p + __builtin_ctz(stop);
+  }
+  return nullptr;
+}
+
+const char *SkipWhitespaceAvx2(const char *p, const char *end) {
+  if (ScalarPrologue(p, end, NotWhitespace))
+    return p;
+  if (const char *stop = ScanAvx2<false>(p, end, kWhitespaceNibbles))
+    return stop;
+  // Fewer than 32 bytes remain.
+  return SkipWhitespaceScalar(end - (end - p) % 32, end);
+}
+
+const char *FindDelimiterAvx2(const char *p, const char *end) {
+  if (ScalarPrologue(p, end, IsDelimiter))
+    return p;
+  if (const char *stop = ScanAvx2<true>(p, end, kDelimiterNibbles))
+    return stop;
+  return FindDelimiterScalar(end - (end - p) % 32, end);
+}
+#endif // BENSCOPE_AVX2_DISPATCH
+
+const Scanner &ActiveScanner() {
+  static const Scanner &active = Avx2Scanner()   ? *Avx2Scanner()
+                                 : Sse2Scanner() ? *Sse2Scanner()
+                                                 : ScalarScanner();
+  return active;
+}
+
+} // namespace
+
+const char *SkipWhitespace(const char *begin, const char *end) {
+  return ActiveScanner().skip_whitespace(begin, end);
+}
+
+const char *FindDelimiter(const char *begin, const char *end) {
+  return ActiveScanner().find_delimiter(begin, end);
+}
+
+const Scanner &ScalarScanner() {
+  static constexpr Scanner kScalar{"scalar", SkipWhitespaceScalar,
+                                   FindDelimiterScalar};
+  return kScalar;
+}
+
+const Scanner *Sse2Scanner() {
+#if defined(__SSE2__)
+  static constexpr Scanner kSse2{"sse2", SkipWhitespaceSse2, FindDelimiterSse2};
+  return &kSse2;
+#else
+  return nullptr;
+#endif
+}
+
+const Scanner *Avx2Scanner() {
+#if defined(BENSCOPE_AVX2_DISPATCH)
+  static constexpr Scanner kAvx2{"avx2", SkipWhitespaceAvx2, FindDelimiterAvx2};
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported ? &kAvx2 : nullptr;
+#else
+  return nullptr;
+#endif
+}
+
+} // namespace benscope::char_class
@@ -0,0 +1,65 @@
+// Table-driven character classification and bulk scanning for the lexer.
+
+#ifndef __BENSCOPE_PARSING_CHAR_CLASS_H__
+#define __BENSCOPE_PARSING_CHAR_CLASS_H__
+
+#include <array>
+#include <cstdint>
+
+namespace benscope::char_class {
+
+enum : std::uint8_t {
+  kWhitespace = 1 << 0,
+  kDelimiter = 1 << 1,
+  // Characters a numeric literal may start with.  Anything else is known to be
+  // an identifier or operator without running the number recognizer.
+  kNumberStart = 1 << 2,
+};
+
+namespace internal {
+constexpr std::array<std::uint8_t, 256> MakeTable() {
+  std::array<std::uint8_t, 256> table{};
+  for (int c = '\t'; c <= '\r'; ++c)
+    table[c] |= kWhitespace | kDelimiter;
+  table[' '] |= kWhitespace | kDelimiter;
+
+  // Token::kEof doubles as a delimiter so a stray ^D ends a word.
+  for (char c : {'(', ')', '\'', '"', '`', ';', '|', '[', ']', '{', '}', '\4'})
+    table[static_cast<std::uint8_t>(c)] |= kDelimiter;
+
+  for (int c = '0'; c <= '9'; ++c)
+    table[c] |= kNumberStart;
+  table['#'] |= kNumberStart;
+  table['.'] |= kNumberStart;
+  return table;
+}
+} // namespace internal
+
+inline constexpr std::array<std::uint8_t, 256> kTable = internal::MakeTable();
+
+inline bool Is(char c, std::uint8_t cls) {
+  return (kTable[static_cast<std::uint8_t>(c)] & cls) != 0;
+}
+inline bool IsWhitespace(char c) { return Is(c, kWhitespace); }
+inline bool IsDelimiter(char c) { return Is(c, kDelimiter); }
+
+// Bulk scanners.  Each returns a pointer to the first character in
+// [begin, end) that stops the scan, or end if there is none.  They use SSE2
+// or AVX2 when the CPU has them and fall back to the table otherwise.
+const char *SkipWhitespace(const char *begin, const char *end);
+const char *FindDelimiter(const char *begin, const char *end);
+
+// The individual implementations, exposed for tests and benchmarks.  The SIMD
+// variants are null when not compiled in or not supported by this CPU.
+struct Scanner {
+  const char *name;
+  const char *(*skip_whitespace)(const char *begin, const char *end);
+  const char *(*find_delimiter)(const char *begin, const char *end);
+};
+const Scanner &ScalarScanner();
+const Scanner *Sse2Scanner();
+const Scanner *Avx2Scanner();
+
+} // namespace benscope::char_class
+
+#endif // __BENSCOPE_PARSING_CHAR_CLASS_H__
@@ -0,0 +1,82 @@
+#include "benscope/parsing/char_class.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope::char_class {
+namespace {
+
+using ::testing::Eq;
+
+std::vector<const Scanner *> Scanners() {
+  std::vector<const Scanner *> scanners{&ScalarScanner()};
+  if (Sse2Scanner())
+    scanners.push_back(Sse2Scanner());
+  if (Avx2Scanner())
+    scanners.push_back(Avx2Scanner());
+  return scanners;
+}
+
+TEST(CharClassTest, Table) {
+  for (char c : std::string(" \t\n\v\f\r")) {
+    EXPECT_TRUE(IsWhitespace(c));
+    EXPECT_TRUE(IsDelimiter(c));
+  }
+  for (char c : std::string("()'\"`;|[]{}\4")) {
+    EXPECT_FALSE(IsWhitespace(c));
+    EXPECT_TRUE(IsDelimiter(c));
+  }
+  for (char c : std::string("az+-*/<>#.09\x80\xff")) {
+    EXPECT_FALSE(IsDelimiter(c)) << static_cast<int>(c);
+  }
+}
+
+// Every scanner must stop at exactly the same place as the table, at every
+// alignment and for stops inside and past the SIMD block sizes.
+TEST(CharClassTest, ScannersAgreeWithTable) {
+  std::mt19937 rng(1234);
+  const std::string alphabet = "abcxyz019+-*# \t\n\r()[]{}'\"`;|\4\x80\xf0";
+  std::string text;
+  for (int i = 0; i < 4096; ++i) {
+    // Long runs of one class so the block loops get exercised.
+    bool spaces = rng() % 2;
+    int run = rng() % 70;
+    for (int j = 0; j < run; ++j)
+      text.push_back(spaces ? " \t\n"[rng() % 3]
+                            : alphabet[rng() % alphabet.size()]);
+  }
+
+  const char *end = text.data() + text.size();
+  for (const Scanner *scanner : Scanners()) {
+    for (const char *p = text.data(); p < end; p += 7) {
+      const char *ws = p;
+      while (ws != end && IsWhitespace(*ws))
+        ++ws;
+      const char *delim = p;
+      while (delim != end && !IsDelimiter(*delim))
+        ++delim;
+
+      EXPECT_THAT(scanner->skip_whitespace(p, end), Eq(ws)) << scanner->name;
+      EXPECT_THAT(scanner->find_delimiter(p, end), Eq(delim)) << scanner->name;
+    }
+  }
+}
+
+TEST(CharClassTest, EmptyAndShortRanges) {
+  const std::string text = "   x";
+  for (const Scanner *scanner : Scanners()) {
+    const char *begin = text.data();
+    EXPECT_THAT(scanner->skip_whitespace(begin, begin), Eq(begin));
+    EXPECT_THAT(scanner->find_delimiter(begin, begin), Eq(begin));
+    EXPECT_THAT(scanner->skip_whitespace(begin, begin + 3), Eq(begin + 3));
+    EXPECT_THAT(scanner->skip_whitespace(begin, begin + 4), Eq(begin + 3));
+    EXPECT_THAT(scanner->find_delimiter(begin + 3, begin + 4), Eq(begin + 4));
+  }
+}
+
+} // namespace
+} // namespace benscope::char_class
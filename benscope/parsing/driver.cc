@@ -11,58 +11,63 @@
 namespace benscope {
 namespace {
 
-class PrintingVisitor : public AstVisitor {
+class PrintingVisitor : public StaticAstVisitor<PrintingVisitor> {
 public:
-  void Visit(const BinaryExprAST &expr) override {
+  void Visit(const BinaryExprAST &expr) {
     std::cerr << "[";
-    expr.lhs->Accept(*this);
+    Dispatch(*expr.lhs);
     std::cerr << " ";
     std::cerr.put(expr.op);
     std::cerr << " ";
-    expr.rhs->Accept(*this);
+    Dispatch(*expr.rhs);
     std::cerr << "]";
   }
 
-  void Visit(const CallExprAST &expr) override {
+  void Visit(const CallExprAST &expr) {
     std::cerr << "[CALL " << expr.callee;
     for (const auto &arg : expr.args) {
       std::cerr << " ";
-      arg->Accept(*this);
+      Dispatch(*arg);
     }
     std::cerr << "]";
   }
 
-  void Visit(const IfExprAST &expr) override {
+  void Visit(const IfExprAST &expr) {
     std::cerr << "[IF [";
-    expr.test->Accept(*this);
+    Dispatch(*expr.test);
     std::cerr << "] THEN [";
-    expr.if_true->Accept(*this);
+    Dispatch(*expr.if_true);
     std::cerr << "] ELSE [";
-    expr.if_false->Accept(*this);
+    Dispatch(*expr.if_false);
     std::cerr << "]]";
   }
 
-  void Visit(const NumberExprAST &expr) override {
+  void Visit(const NumberExprAST &expr) {
     std::cerr << "[" << expr.val << "]";
   };
 
-  void Visit(const VariableExprAST &expr) override {
+  void Visit(const VariableExprAST &expr) {
     std::cerr << "{" << expr.name_ << "}";
   };
 
-  void Visit(const FunctionAST &ast) override {
+  void Visit(const FunctionAST &ast) {
     inFunc = true;
     std::cerr << "[DEFINE ";
-    ast.proto->Accept(*this);
+    Dispatch(*ast.proto);
     std::cerr << " :== ";
-    ast.body->Accept(*this);
+    Dispatch(*ast.body);
     std::cerr << "]\n";
     inFunc = false;
   };
 
-  void Visit(const PrototypeAST &ast) override{
+  void Visit(const PrototypeAST &ast) {
     if (!inFunc) std::cerr << "[EXTERN ";
-    std::cerr << ast.name << "(" << absl::StrJoin(ast.args, " ") << ")";
+    std::cerr << ast.name << "("
+              << absl::StrJoin(ast.args, " ",
+                               [](std::string *out, Symbol arg) {
+                                 out->append(arg.name());
+                               })
+              << ")";
     if (!inFunc) std::cerr << "]\n";
   };
 
@@ -76,7 +81,7 @@ void MainLoop(Parser *parser) {
     std::unique_ptr<AST> ast = parser->ParseNext();
     if (ast) {
       std::cerr << "\n";
-      ast->Accept(printer);
+      printer.Dispatch(*ast);
     } else {
       std::cerr << "Unhandled text.";
       parser->GetNextToken();
@@ -0,0 +1,199 @@
+#include "benscope/parsing/flat_ast.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace benscope {
+
+void FlatAst::Clear() {
+  nodes_.clear();
+  args_.clear();
+  params_.clear();
+  root_ = kNone;
+}
+
+FlatAst::Range<FlatAst::Index> FlatAst::args(const Node &call) const {
+  const Index *begin = args_.data() + call.operands[0];
+  return Range<Index>(begin, begin + call.operands[1]);
+}
+
+FlatAst::Range<Symbol> FlatAst::params(const Node &proto) const {
+  const Symbol *begin = params_.data() + proto.operands[0];
+  return Range<Symbol>(begin, begin + proto.operands[1]);
+}
+
+void FlatAst::CountUses(std::vector<std::uint32_t> *uses) const {
+  uses->assign(nodes_.size(), 0);
+  for (const Node &node : nodes_) {
+    switch (node.kind) {
+    case AstKind::kNumber:
+    case AstKind::kVariable:
+    case AstKind::kPrototype:
+      break;
+    case AstKind::kCall:
+      for (Index arg : args(node))
+        ++(*uses)[arg];
+      break;
+    case AstKind::kBinary:
+    case AstKind::kFunction:
+      ++(*uses)[node.operands[0]];
+      ++(*uses)[node.operands[1]];
+      break;
+    case AstKind::kIf:
+      for (Index operand : node.operands)
+        ++(*uses)[operand];
+      break;
+    }
+  }
+}
+
+FlatAst::Index FlatAst::Add(const Node &node) {
+  nodes_.push_back(node);
+  return static_cast<Index>(nodes_.size() - 1);
+}
+
+FlatAst::Index FlatAst::AddNumber(double value) {
+  Node node{AstKind::kNumber};
+  node.value = value;
+  return Add(node);
+}
+
+FlatAst::Index FlatAst::AddVariable(Symbol name) {
+  Node node{AstKind::kVariable};
+  node.name = name;
+  node.operands[0] = kNone;
+  return Add(node);
+}
+
+FlatAst::Index FlatAst::AddBinary(char op, Index lhs, Index rhs) {
+  Node node{AstKind::kBinary, op};
+  node.operands[0] = lhs;
+  node.operands[1] = rhs;
+  return Add(node);
+}
+
+FlatAst::Index FlatAst::AddCall(Symbol callee, const Index *args,
+                                std::size_t count) {
+  Node node{AstKind::kCall};
+  node.name = callee;
+  node.operands[0] = static_cast<Index>(args_.size());
+  node.operands[1] = static_cast<Index>(count);
+  args_.insert(args_.end(), args, args + count);
+  return Add(node);
+}
+
+FlatAst::Index FlatAst::AddIf(Index test, Index if_true, Index if_false) {
+  Node node{AstKind::kIf};
+  node.operands[0] = test;
+  node.operands[1] = if_true;
+  node.operands[2] = if_false;
+  return Add(node);
+}
+
+FlatAst::Index FlatAst::AddPrototype(Symbol name, const Symbol *params,
+                                     std::size_t count) {
+  Node node{AstKind::kPrototype};
+  node.name = name;
+  node.operands[0] = static_cast<Index>(params_.size());
+  node.operands[1] = static_cast<Index>(count);
+  params_.insert(params_.end(), params, params + count);
+  return Add(node);
+}
+
+FlatAst::Index FlatAst::AddFunction(Index proto, Index body) {
+  Node node{AstKind::kFunction};
+  node.operands[0] = proto;
+  node.operands[1] = body;
+  return Add(node);
+}
+
+std::unique_ptr<AST> FlatAst::Inflate(Index index) const {
+  // A pointer tree has no shared nodes, so each node is built once for every
+  // time it occurs in the tree: once for each occurrence of each parent that
+  // uses it.  Parents have larger indices than their children, so counting
+  // in reverse index order and building in index order visit every parent
+  // before and every child after it, with no recursion.
+  std::vector<std::uint32_t> copies(index + 1, 0);
+  copies[index] = 1;
+  for (Index i = index + 1; i-- > 0;) {
+    const Node &n = nodes_[i];
+    switch (n.kind) {
+    case AstKind::kNumber:
+    case AstKind::kVariable:
+    case AstKind::kPrototype:
+      break;
+    case AstKind::kCall:
+      for (Index arg : args(n))
+        copies[arg] += copies[i];
+      break;
+    case AstKind::kBinary:
+    case AstKind::kFunction:
+      copies[n.operands[0]] += copies[i];
+      copies[n.operands[1]] += copies[i];
+      break;
+    case AstKind::kIf:
+      for (Index operand : n.operands)
+        copies[operand] += copies[i];
+      break;
+    }
+  }
+
+  // The copies of each node not yet taken by a parent.
+  std::vector<std::vector<std::unique_ptr<AST>>> built(index + 1);
+  auto take = [&built](Index i) {
+    std::unique_ptr<AST> node = std::move(built[i].back());
+    built[i].pop_back();
+    return node;
+  };
+  auto expr = [&take](Index i) {
+    return std::unique_ptr<ExprAST>(static_cast<ExprAST *>(take(i).release()));
+  };
+
+  for (Index i = 0; i <= index; ++i) {
+    const Node &n = nodes_[i];
+    built[i].reserve(copies[i]);
+    for (std::uint32_t copy = 0; copy < copies[i]; ++copy) {
+      std::unique_ptr<AST> node;
+      switch (n.kind) {
+      case AstKind::kNumber:
+        node = std::make_unique<NumberExprAST>(n.value);
+        break;
+      case AstKind::kVariable:
+        node = std::make_unique<VariableExprAST>(n.name);
+        break;
+      case AstKind::kBinary:
+        node = std::make_unique<BinaryExprAST>(n.op, expr(n.operands[0]),
+                                               expr(n.operands[1]));
+        break;
+      case AstKind::kCall: {
+        std::vector<std::unique_ptr<ExprAST>> args;
+        for (Index arg : this->args(n))
+          args.push_back(expr(arg));
+        node = std::make_unique<CallExprAST>(n.name, std::move(args));
+        break;
+      }
+      case AstKind::kIf:
+        node = std::make_unique<IfExprAST>(
+            expr(n.operands[0]), expr(n.operands[1]), expr(n.operands[2]));
+        break;
+      case AstKind::kPrototype: {
+        Range<Symbol> p = params(n);
+        node = std::make_unique<PrototypeAST>(
+            n.name, std::vector<Symbol>(p.begin(), p.end()));
+        break;
+      }
+      case AstKind::kFunction:
+        node = std::make_unique<FunctionAST>(
+            std::unique_ptr<PrototypeAST>(
+                static_cast<PrototypeAST *>(take(n.operands[0]).release())),
+            expr(n.operands[1]));
+        break;
+      }
+      built[i].push_back(std::move(node));
+    }
+  }
+  return take(index);
+}
+
+} // namespace benscope
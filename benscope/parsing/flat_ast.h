@@ -0,0 +1,145 @@
+// A contiguous, index-linked representation of one top-level form.
+
+#ifndef __BENSCOPE_PARSING_FLAT_AST_H__
+#define __BENSCOPE_PARSING_FLAT_AST_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "benscope/parsing/ast.h"
+#include "benscope/parsing/symbol.h"
+
+namespace benscope {
+
+// FlatAst holds the same tree as the ExprAST/FunctionAST classes, but every
+// node of a form lives in a single vector and refers to its children by
+// 32-bit index instead of owning them through unique_ptrs.  Building one
+// allocates only when the vectors grow, walking one stays within a few cache
+// lines, and Clear() drops a whole form at once while keeping the capacity
+// for the next.
+//
+// A node may be the operand of more than one parent, which makes the form a
+// DAG whose shared subexpressions a backend can compute once; see
+// HashConser.  Walk() and Inflate() visit a shared node once per use.
+class FlatAst {
+public:
+  using Index = std::uint32_t;
+  static constexpr Index kNone = ~Index{0};
+  static constexpr Index kStop = kNone - 1;
+
+  template <typename T> class Range {
+  public:
+    using value_type = T;
+    using const_iterator = const T *;
+
+    Range(const T *begin, const T *end) : begin_(begin), end_(end) {}
+    const T *begin() const { return begin_; }
+    const T *end() const { return end_; }
+    std::size_t size() const { return end_ - begin_; }
+    const T &operator[](std::size_t i) const { return begin_[i]; }
+
+  private:
+    const T *begin_, *end_;
+  };
+
+  struct Node {
+    AstKind kind;
+    // kBinary: the operator.
+    char op;
+    // kVariable: the variable.  kCall: the callee.  kPrototype: the function.
+    Symbol name;
+    union {
+      // kBinary: lhs, rhs.  kIf: test, if_true, if_false.  kFunction: proto,
+      // body.  kCall, kPrototype: offset and length of the argument list.
+      // kVariable: the number of the parameter it names, once resolved (see
+      // ResolveScopes), or kNone.
+      Index operands[3];
+      // kNumber.
+      double value;
+    };
+  };
+
+  void Clear();
+
+  bool empty() const { return nodes_.empty(); }
+  std::size_t size() const { return nodes_.size(); }
+
+  // The form's top-level node: a kFunction or, for extern, a kPrototype.
+  Index root() const { return root_; }
+  void set_root(Index root) { root_ = root; }
+
+  const Node &node(Index index) const { return nodes_[index]; }
+  const Node &operator[](Index index) const { return nodes_[index]; }
+  // The index of a node of this form, e.g. one passed to a Walk() visitor.
+  Index index_of(const Node &node) const {
+    return static_cast<Index>(&node - nodes_.data());
+  }
+
+  // Sets (*uses)[i] to the number of operand references to node i: 1 for
+  // every expression node of a tree, more for shared nodes of a DAG.
+  void CountUses(std::vector<std::uint32_t> *uses) const;
+
+  // Argument expressions of a kCall node.
+  Range<Index> args(const Node &call) const;
+  // Parameter names of a kPrototype node.
+  Range<Symbol> params(const Node &proto) const;
+
+  Index AddNumber(double value);
+  Index AddVariable(Symbol name);
+  Index AddBinary(char op, Index lhs, Index rhs);
+  Index AddCall(Symbol callee, const Index *args, std::size_t count);
+  Index AddIf(Index test, Index if_true, Index if_false);
+  Index AddPrototype(Symbol name, const Symbol *params, std::size_t count);
+  Index AddFunction(Index proto, Index body);
+
+  // Binds the kVariable node `variable` to parameter number `slot`.
+  void set_slot(Index variable, Index slot) {
+    nodes_[variable].operands[0] = slot;
+  }
+
+  // Walks the subtree at `root` depth-first on an explicit stack, so the
+  // nesting depth is not limited by the native stack.  `visit(node, step)` is
+  // called with step 0, 1, 2, ... for each node; it returns the index of a
+  // child to walk before the next step, kNone once the node is finished, or
+  // kStop to abandon the walk.  Returns false if the walk was abandoned.
+  template <typename Visit> bool Walk(Index root, Visit visit) const;
+
+  // Builds the equivalent pointer tree rooted at `index`, with a copy of a
+  // shared node for each of its uses.  Children always have smaller indices
+  // than their parents, which both this and the iterative walks in the
+  // backends rely on.
+  std::unique_ptr<AST> Inflate(Index index) const;
+  std::unique_ptr<AST> Inflate() const { return Inflate(root_); }
+
+private:
+  Index Add(const Node &node);
+
+  std::vector<Node> nodes_;
+  std::vector<Index> args_;
+  std::vector<Symbol> params_;
+  Index root_ = kNone;
+};
+
+template <typename Visit> bool FlatAst::Walk(Index root, Visit visit) const {
+  struct Pending {
+    Index index;
+    int step;
+  };
+  std::vector<Pending> stack = {{root, 0}};
+  while (!stack.empty()) {
+    Pending &top = stack.back();
+    Index child = visit(nodes_[top.index], top.step++);
+    if (child == kStop)
+      return false;
+    if (child == kNone)
+      stack.pop_back();
+    else
+      stack.push_back({child, 0});
+  }
+  return true;
+}
+
+} // namespace benscope
+
+#endif // __BENSCOPE_PARSING_FLAT_AST_H__
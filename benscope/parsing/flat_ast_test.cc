@@ -0,0 +1,93 @@
+#include "benscope/parsing/flat_ast.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "benscope/parsing/ast.h"
+#include "benscope/parsing/printer.h"
+#include "benscope/parsing/symbol.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+TEST(FlatAstTest, BuildAndRead) {
+  FlatAst form;
+  const Symbol x = Symbol::Intern("x");
+  FlatAst::Index args[] = {form.AddVariable(x), form.AddNumber(2)};
+  FlatAst::Index call = form.AddCall(Symbol::Intern("f"), args, 2);
+  FlatAst::Index proto = form.AddPrototype(Symbol::Intern("g"), &x, 1);
+  form.set_root(form.AddFunction(proto, call));
+
+  const FlatAst::Node &root = form[form.root()];
+  EXPECT_THAT(root.kind, Eq(AstKind::kFunction));
+  EXPECT_THAT(form[root.operands[0]].name.name(), Eq("g"));
+  EXPECT_THAT(form.params(form[root.operands[0]]), ElementsAre(x));
+
+  const FlatAst::Node &body = form[root.operands[1]];
+  ASSERT_THAT(body.kind, Eq(AstKind::kCall));
+  ASSERT_THAT(form.args(body).size(), Eq(2));
+  EXPECT_THAT(form[form.args(body)[1]].value, Eq(2));
+}
+
+TEST(FlatAstTest, Inflate) {
+  FlatAst form;
+  FlatAst::Index lhs = form.AddVariable(Symbol::Intern("a"));
+  FlatAst::Index test = form.AddBinary('<', lhs, form.AddNumber(1));
+  form.set_root(form.AddIf(test, form.AddNumber(2), form.AddNumber(3)));
+
+  std::unique_ptr<AST> tree = form.Inflate();
+  ASSERT_THAT(tree->kind, Eq(AstKind::kIf));
+
+  PrintingVisitor v;
+  v.Dispatch(*tree);
+  EXPECT_THAT(v.ToString(), Eq("[IF [{a} < [1]] THEN [2] ELSE [3]]"));
+}
+
+TEST(FlatAstTest, InflatesSharedNodesOncePerUse) {
+  FlatAst form;
+  const Symbol x = Symbol::Intern("x");
+  FlatAst::Index sum = form.AddBinary('+', form.AddVariable(x),
+                                      form.AddNumber(1));
+  FlatAst::Index square = form.AddBinary('*', sum, sum);
+  form.set_root(form.AddBinary('-', square, square));
+
+  std::unique_ptr<AST> tree = form.Inflate();
+  PrintingVisitor v;
+  v.Dispatch(*tree);
+  EXPECT_THAT(v.ToString(), Eq("[[[{x} + [1]] * [{x} + [1]]] - "
+                               "[[{x} + [1]] * [{x} + [1]]]]"));
+}
+
+TEST(FlatAstTest, CountUses) {
+  FlatAst form;
+  const Symbol x = Symbol::Intern("x");
+  FlatAst::Index sum = form.AddBinary('+', form.AddVariable(x),
+                                      form.AddNumber(1));
+  FlatAst::Index args[] = {sum, sum};
+  FlatAst::Index call = form.AddCall(Symbol::Intern("f"), args, 2);
+  FlatAst::Index proto = form.AddPrototype(Symbol::Intern("g"), &x, 1);
+  form.set_root(form.AddFunction(proto, call));
+
+  std::vector<std::uint32_t> uses;
+  form.CountUses(&uses);
+  EXPECT_THAT(uses, ElementsAre(1, 1, 2, 1, 1, 0));
+  EXPECT_THAT(form.index_of(form[call]), Eq(call));
+}
+
+TEST(FlatAstTest, ClearKeepsNothing) {
+  FlatAst form;
+  form.set_root(form.AddNumber(1));
+  form.Clear();
+  EXPECT_TRUE(form.empty());
+  EXPECT_THAT(form.root(), Eq(FlatAst::kNone));
+}
+
+} // namespace
+} // namespace benscope
@@ -0,0 +1,193 @@
+#include "benscope/parsing/form_builder.h"
+
+#include <iostream>
+
+#include "benscope/parsing/ast.h"
+
+namespace benscope {
+
+void FormBuilder::Start(FlatAst *form) {
+  form->Clear();
+  form_ = form;
+  stack_.clear();
+  args_.clear();
+  params_.clear();
+  stack_.push_back({State::kForm});
+}
+
+// Kept out of line so the stream code does not crowd the token loop.
+__attribute__((noinline, cold)) FormBuilder::Status
+FormBuilder::Error(const char *message) {
+  std::cerr << message << "\n";
+  stack_.clear();
+  return kError;
+}
+
+FormBuilder::Status FormBuilder::Complete(FlatAst::Index index) {
+  stack_.pop_back();
+  return Deliver(index);
+}
+
+FormBuilder::Status FormBuilder::Deliver(FlatAst::Index index) {
+  Frame &parent = stack_.back();
+  switch (parent.state) {
+  case State::kFormBody:
+    if (IsExpr((*form_)[index].kind)) {
+      // Make an anonymous proto.
+      FlatAst::Index p = form_->AddPrototype(AnonExprSymbol(), nullptr, 0);
+      index = form_->AddFunction(p, index);
+    }
+    form_->set_root(index);
+    stack_.clear();
+    return kDone;
+  case State::kCall:
+    args_.push_back(index);
+    return kNeedMore;
+  default:
+    parent.operands[parent.count++] = index;
+    return kNeedMore;
+  }
+}
+
+FormBuilder::Status FormBuilder::StartExpr(const Token &token) {
+  switch (token.type) {
+  case Token::kNumber:
+    return Deliver(form_->AddNumber(token.value.double_value));
+  case Token::kIdentifier:
+    return Deliver(form_->AddVariable(token.symbol));
+  case '(':
+    stack_.push_back({State::kParenHead, /*expr_only=*/true});
+    return kNeedMore;
+  case Token::kEof:
+    return Error("Unexpected EOF.");
+  default:
+    return Error("Unexpected token at expression beginning.");
+  }
+}
+
+FormBuilder::Status FormBuilder::Feed(const Token &token) {
+  Frame &top = stack_.back();
+  switch (top.state) {
+  case State::kForm:
+    if (token.type != '(')
+      return Error("Expected '(' at the beginning of a top level expression.");
+    top.state = State::kFormBody;
+    stack_.push_back({State::kParenHead});
+    return kNeedMore;
+
+  case State::kParenHead:
+    switch (token.type) {
+    case Token::kIdentifier:
+      top.state = State::kCall;
+      top.name = token.symbol;
+      top.operands[0] = static_cast<FlatAst::Index>(args_.size());
+      return kNeedMore;
+    case Token::kNumber:
+      return Error("Found number at the beginning of a parenthetical.");
+    case Token::kIf:
+      top.state = State::kIf;
+      return kNeedMore;
+    case Token::kDef:
+    case Token::kExtern:
+      if (top.expr_only)
+        return Error("Found an internal extern or def.");
+      top.state =
+          token.type == Token::kDef ? State::kDefBody : State::kExtern;
+      stack_.push_back({State::kProtoName});
+      return kNeedMore;
+    case Token::kEof:
+      return Error("EOF found while inside a parenthetical.");
+    default:
+      top.state = State::kBinary;
+      top.op = token.type;
+      return kNeedMore;
+    }
+
+  case State::kCall: {
+    if (token.type == Token::kEof)
+      return Error("Expected ')' while parsing call.");
+    if (token.type != ')')
+      return StartExpr(token);
+    const FlatAst::Index base = top.operands[0];
+    FlatAst::Index call =
+        form_->AddCall(top.name, args_.data() + base, args_.size() - base);
+    args_.resize(base);
+    return Complete(call);
+  }
+
+  case State::kBinary:
+    if (top.count < 2)
+      return StartExpr(token);
+    if (token.type != ')')
+      return Error("Missing ')' after binary expression.");
+    return Complete(
+        form_->AddBinary(top.op, top.operands[0], top.operands[1]));
+
+  case State::kIf:
+    if (top.count < 3)
+      return StartExpr(token);
+    if (token.type != ')')
+      return Error("Missing ')' at end of if-expression.");
+    return Complete(
+        form_->AddIf(top.operands[0], top.operands[1], top.operands[2]));
+
+  case State::kProtoName:
+    if (token.type != Token::kIdentifier)
+      return Error("Expected function name at start of prototype");
+    top.name = token.symbol;
+    top.state = State::kProtoOpen;
+    return kNeedMore;
+
+  case State::kProtoOpen:
+    if (token.type != '(')
+      return Error("Expected '(' in prototype");
+    top.state = State::kProtoParams;
+    top.operands[0] = static_cast<FlatAst::Index>(params_.size());
+    return kNeedMore;
+
+  case State::kProtoParams: {
+    if (token.type == Token::kIdentifier) {
+      params_.push_back(token.symbol);
+      return kNeedMore;
+    }
+    if (token.type != ')')
+      return Error("Expected ')' at end of prototype");
+    const FlatAst::Index base = top.operands[0];
+    FlatAst::Index proto = form_->AddPrototype(
+        top.name, params_.data() + base, params_.size() - base);
+    params_.resize(base);
+    return Complete(proto);
+  }
+
+  case State::kDefBody:
+    // operands[0] is the prototype, which is always complete by now.
+    if (top.count < 2)
+      return StartExpr(token);
+    if (token.type != ')')
+      return Error("Expected ')' at end of definition.");
+    return Complete(form_->AddFunction(top.operands[0], top.operands[1]));
+
+  case State::kExtern:
+    if (token.type != ')')
+      return Error("Expected ')' at end of extern declaration.");
+    return Complete(top.operands[0]);
+
+  case State::kFormBody:
+    // Never on top: its child completes the form.
+    break;
+  }
+  return Error("Internal error: token after the end of a form.");
+}
+
+FormBuilder::Status FormBuilder::FeedFrom(Lexer *lexer) {
+  for (;;) {
+    Status status = Feed(lexer->token());
+    if (status == kError)
+      return status;
+    lexer->Next();
+    if (status == kDone)
+      return status;
+  }
+}
+
+} // namespace benscope
@@ -0,0 +1,97 @@
+// Builds a top-level form into a FlatAst one token at a time.
+
+#ifndef __BENSCOPE_PARSING_FORM_BUILDER_H__
+#define __BENSCOPE_PARSING_FORM_BUILDER_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/symbol.h"
+
+namespace benscope {
+
+// The same grammar as Parser's recursive descent, run as a pushdown automaton
+// over an explicit stack.  Nesting depth is bounded by memory rather than by
+// the native stack, and because the builder is fed tokens instead of pulling
+// them, a caller can suspend between any two tokens.
+//
+//   FormBuilder builder;
+//   builder.Start(&form);
+//   while ((status = builder.Feed(token)) == FormBuilder::kNeedMore)
+//     token = <next token>;
+class FormBuilder {
+public:
+  enum Status {
+    // The token was consumed and the form is not finished yet.
+    kNeedMore,
+    // The token was consumed and finished the form; form->root() is set.
+    kDone,
+    // The token does not fit the grammar.  It was not consumed, the error has
+    // been reported on std::cerr, and the builder must be restarted.
+    kError,
+  };
+
+  // Clears `form` and begins a new top-level form in it.
+  void Start(FlatAst *form);
+
+  Status Feed(const Token &token);
+
+  // Feeds tokens from `lexer`, starting with its current one, until the form
+  // is done or an error occurs.  On kDone the lexer is left on the token
+  // after the form; on kError, on the offending token.
+  Status FeedFrom(Lexer *lexer);
+
+  // Whether Start() has been called and the form is incomplete.
+  bool in_progress() const { return !stack_.empty(); }
+
+private:
+  enum class State : std::uint8_t {
+    kForm,       // Expecting the '(' that opens a top-level form.
+    kFormBody,   // Waiting for the form's contents.
+    kParenHead,  // Just after '(': the next token says what this is.
+    kCall,       // Collecting arguments until ')'.
+    kBinary,     // Collecting two operands, then ')'.
+    kIf,         // Collecting three operands, then ')'.
+    kProtoName,  // Expecting a function name.
+    kProtoOpen,  // Expecting the '(' of the parameter list.
+    kProtoParams, // Collecting parameter names until ')'.
+    kDefBody,    // Waiting for the prototype, then the body, then ')'.
+    kExtern,     // Waiting for the prototype, then ')'.
+  };
+
+  struct Frame {
+    State state;
+    // kParenHead: only an expression may follow.
+    bool expr_only = false;
+    char op = 0;
+    std::uint8_t count = 0;
+    Symbol name;
+    // Operands collected so far; for kCall and kProtoParams, the offset of
+    // this frame's entries in args_ or params_.
+    FlatAst::Index operands[3] = {FlatAst::kNone, FlatAst::kNone,
+                                  FlatAst::kNone};
+  };
+
+  Status Error(const char *message);
+  // Handles the first token of an operand of the top frame.  Numbers and
+  // variables are delivered straight away, without a frame of their own.
+  Status StartExpr(const Token &token);
+  // Hands a finished operand to the top frame.
+  Status Deliver(FlatAst::Index index);
+  // Pops the finished top frame and hands `index` to the frame below.
+  // Returns kDone if that completes the form.
+  Status Complete(FlatAst::Index index);
+
+  FlatAst *form_ = nullptr;
+  std::vector<Frame> stack_;
+  // Pending call arguments and prototype parameters of the open frames,
+  // innermost last.
+  std::vector<FlatAst::Index> args_;
+  std::vector<Symbol> params_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_PARSING_FORM_BUILDER_H__
@@ -0,0 +1,68 @@
+#include "benscope/parsing/form_builder.h"
+
+#include <string_view>
+#include <vector>
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/printer.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+// Feeds every token of `source` and records the status each one produced.
+std::vector<FormBuilder::Status> FeedAll(std::string_view source,
+                                         FlatAst *form) {
+  Lexer lexer(source);
+  FormBuilder builder;
+  builder.Start(form);
+  std::vector<FormBuilder::Status> statuses;
+  for (; lexer.token().type != Token::kEof; lexer.Next()) {
+    statuses.push_back(builder.Feed(lexer.token()));
+    if (statuses.back() != FormBuilder::kNeedMore)
+      break;
+  }
+  return statuses;
+}
+
+TEST(FormBuilderTest, FinishesOnClosingParen) {
+  FlatAst form;
+  EXPECT_THAT(FeedAll("(def f (x) (g x 1)) (ignored)", &form),
+              ElementsAre(FormBuilder::kNeedMore, FormBuilder::kNeedMore,
+                          FormBuilder::kNeedMore, FormBuilder::kNeedMore,
+                          FormBuilder::kNeedMore, FormBuilder::kNeedMore,
+                          FormBuilder::kNeedMore, FormBuilder::kNeedMore,
+                          FormBuilder::kNeedMore, FormBuilder::kNeedMore,
+                          FormBuilder::kNeedMore, FormBuilder::kDone));
+
+  PrintingVisitor v;
+  v.Print(form);
+  EXPECT_THAT(v.ToString(), Eq("[DEFINE f(x) :== [CALL g {x} [1]]]"));
+}
+
+TEST(FormBuilderTest, WrapsExpressions) {
+  FlatAst form;
+  FeedAll("(if a b c)", &form);
+
+  PrintingVisitor v;
+  v.Print(form);
+  EXPECT_THAT(v.ToString(),
+              Eq("[DEFINE __anon_expr() :== [IF {a} THEN {b} ELSE {c}]]"));
+}
+
+TEST(FormBuilderTest, StopsAtTheBadToken) {
+  FlatAst form;
+  EXPECT_THAT(FeedAll("(+ 1 (extern f ()))", &form),
+              ElementsAre(FormBuilder::kNeedMore, FormBuilder::kNeedMore,
+                          FormBuilder::kNeedMore, FormBuilder::kNeedMore,
+                          FormBuilder::kError));
+}
+
+} // namespace
+} // namespace benscope
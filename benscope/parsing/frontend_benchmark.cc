@@ -0,0 +1,207 @@
+// Front-end speed and memory on generated programs of several shapes: tokens/s
+// through Lexer::Next, forms/s through Parser::ParseNext, and the heap
+// allocations and peak live heap bytes per pass.  Run with
+// --benchmark_counters_tabular=true to track regressions across shapes.
+
+#include <malloc.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parallel_parser.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/parsing/program_generator.h"
+
+namespace {
+
+// Every heap allocation in this binary goes through these, which keep count.
+std::atomic<std::int64_t> allocations{0};
+std::atomic<std::int64_t> live_bytes{0};
+std::atomic<std::int64_t> peak_bytes{0};
+
+void *Allocate(std::size_t size) {
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  std::int64_t live =
+      live_bytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed) +
+      malloc_usable_size(p);
+  std::int64_t peak = peak_bytes.load(std::memory_order_relaxed);
+  while (live > peak && !peak_bytes.compare_exchange_weak(peak, live))
+    ;
+  return p;
+}
+
+void Deallocate(void *p) {
+  if (p == nullptr)
+    return;
+  live_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+  std::free(p);
+}
+
+} // namespace
+
+void *operator new(std::size_t size) { return Allocate(size); }
+void *operator new[](std::size_t size) { return Allocate(size); }
+void operator delete(void *p) noexcept { Deallocate(p); }
+void operator delete[](void *p) noexcept { Deallocate(p); }
+void operator delete(void *p, std::size_t) noexcept { Deallocate(p); }
+void operator delete[](void *p, std::size_t) noexcept { Deallocate(p); }
+
+namespace benscope {
+namespace {
+
+ProgramShape Shape(int forms, int depth, int identifiers,
+                   int identifier_length, int number_percent) {
+  ProgramShape shape;
+  shape.forms = forms;
+  shape.depth = depth;
+  shape.identifiers = identifiers;
+  shape.identifier_length = identifier_length;
+  shape.number_percent = number_percent;
+  return shape;
+}
+
+// Production-sized inputs of a few characteristic shapes, a few megabytes
+// each.
+const ProgramShape kTypical = Shape(20000, 6, 8, 5, 30);
+const ProgramShape kDeep = Shape(2000, 200, 8, 5, 30);
+const ProgramShape kNumeric = Shape(20000, 6, 8, 5, 90);
+const ProgramShape kLongNames = Shape(20000, 6, 64, 24, 30);
+
+const std::string &Source(const ProgramShape &shape) {
+  static auto *cache = new std::map<std::tuple<int, int, int, int, int>,
+                                    std::string>;
+  std::string &source =
+      (*cache)[{shape.forms, shape.depth, shape.identifiers,
+                shape.identifier_length, shape.number_percent}];
+  if (source.empty())
+    source = GenerateProgram(shape);
+  return source;
+}
+
+// Reports the allocations and peak heap of one pass, measured outside the
+// timing loop so the bookkeeping does not distort it.
+template <typename Pass>
+void MeasureHeap(benchmark::State &state, const char *unit, Pass pass) {
+  const std::int64_t start_allocations = allocations.load();
+  const std::int64_t start_bytes = live_bytes.load();
+  peak_bytes = start_bytes;
+  std::int64_t units = pass();
+  state.counters[std::string("allocs/") + unit] =
+      static_cast<double>(allocations.load() - start_allocations) / units;
+  state.counters["peak_bytes"] =
+      benchmark::Counter(peak_bytes.load() - start_bytes,
+                         benchmark::Counter::kDefaults,
+                         benchmark::Counter::OneK::kIs1024);
+}
+
+std::int64_t Lex(const std::string &source) {
+  std::int64_t tokens = 0;
+  Lexer lexer(source);
+  for (; lexer.token().type != Token::kEof; lexer.Next())
+    ++tokens;
+  return tokens;
+}
+
+// Parses every form into the pointer tree, keeping them all, as a compiler
+// would.
+std::int64_t ParseTree(const std::string &source) {
+  std::vector<std::unique_ptr<AST>> forms;
+  Parser parser(std::make_unique<Lexer>(source));
+  while (!parser.eof()) {
+    if (std::unique_ptr<AST> form = parser.ParseNext())
+      forms.push_back(std::move(form));
+    else
+      parser.GetNextToken();
+  }
+  return forms.size();
+}
+
+// Parses every form into one reused FlatAst, as a streaming driver does.
+std::int64_t ParseFlat(const std::string &source) {
+  std::int64_t forms = 0;
+  FlatAst form;
+  Parser parser(std::make_unique<Lexer>(source));
+  while (!parser.eof()) {
+    if (parser.ParseNext(&form))
+      ++forms;
+    else
+      parser.GetNextToken();
+  }
+  return forms;
+}
+
+void SetRate(benchmark::State &state, const std::string &source,
+             const char *unit, std::int64_t units) {
+  state.SetBytesProcessed(state.iterations() * source.size());
+  state.counters[unit] = benchmark::Counter(
+      static_cast<double>(units), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_Lex(benchmark::State &state, const ProgramShape &shape) {
+  const std::string &source = Source(shape);
+  std::int64_t tokens = 0;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(tokens = Lex(source));
+  SetRate(state, source, "tokens/s", tokens);
+  MeasureHeap(state, "token", [&] { return Lex(source); });
+}
+
+void BM_ParseTree(benchmark::State &state, const ProgramShape &shape) {
+  const std::string &source = Source(shape);
+  std::int64_t forms = 0;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(forms = ParseTree(source));
+  SetRate(state, source, "forms/s", forms);
+  MeasureHeap(state, "form", [&] { return ParseTree(source); });
+}
+
+void BM_ParseFlat(benchmark::State &state, const ProgramShape &shape) {
+  const std::string &source = Source(shape);
+  std::int64_t forms = 0;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(forms = ParseFlat(source));
+  SetRate(state, source, "forms/s", forms);
+  MeasureHeap(state, "form", [&] { return ParseFlat(source); });
+}
+
+// Flat forms, all kept, on one thread.
+void BM_ParseForms(benchmark::State &state, const ProgramShape &shape) {
+  const std::string &source = Source(shape);
+  std::int64_t forms = 0;
+  auto pass = [&] {
+    return static_cast<std::int64_t>(ParseForms(source, 1).size());
+  };
+  for (auto _ : state)
+    benchmark::DoNotOptimize(forms = pass());
+  SetRate(state, source, "forms/s", forms);
+  MeasureHeap(state, "form", pass);
+}
+
+#define FRONTEND_BENCHMARKS(shape)                                             \
+  BENCHMARK_CAPTURE(BM_Lex, shape, k##shape);                                  \
+  BENCHMARK_CAPTURE(BM_ParseTree, shape, k##shape);                            \
+  BENCHMARK_CAPTURE(BM_ParseFlat, shape, k##shape);                            \
+  BENCHMARK_CAPTURE(BM_ParseForms, shape, k##shape)
+
+FRONTEND_BENCHMARKS(Typical);
+FRONTEND_BENCHMARKS(Deep);
+FRONTEND_BENCHMARKS(Numeric);
+FRONTEND_BENCHMARKS(LongNames);
+
+} // namespace
+} // namespace benscope
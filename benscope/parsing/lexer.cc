@@ -5,29 +5,30 @@
 #include <iostream>
 #include <string>
 
+#include "benscope/parsing/char_class.h"
+#include "benscope/parsing/numeric_literal.h"
+
 namespace benscope {
 
 Lexer::Lexer(std::istream *input) : input_(input) { Next(); }
 
-// static
-bool Lexer::IsWhitespace(char c) {
-  return c == ' ' || (c > '\010' && c < '\016');
-}
-
-// static
-bool Lexer::IsDelimiter(char c) {
-  return c == '(' || c == ')' || c == '\'' || c == '"' || c == '`' ||
-         c == ';' || c == '|' || c == '[' || c == ']' || c == '{' || c == '}' ||
-         IsWhitespace(c) || c == Token::kEof;
+Lexer::Lexer(std::string_view source)
+    : cursor_(source.data()), end_(source.data() + source.size()) {
+  Next();
 }
 
 void Lexer::Next() {
+  if (input_ == nullptr) {
+    NextFromBuffer();
+    return;
+  }
+
   char c;
   do {
     c = NextChar();
-  } while (IsWhitespace(c));
+  } while (char_class::IsWhitespace(c));
 
-  if (IsDelimiter(c)) {
+  if (char_class::IsDelimiter(c)) {
     token_.type = c;
     return;
   }
@@ -36,23 +37,60 @@ void Lexer::Next() {
   do {
     identifier_.push_back(c);
     c = NextChar();
-  } while (!IsDelimiter(c));
+  } while (!char_class::IsDelimiter(c));
   PutBack(c);
 
-  if (TokenIsNumeric()) {
-    token_.type = Token::kNumber;
-    token_.value.double_value = std::strtod(identifier_.c_str(), nullptr);
-  } else if (identifier_ == "def") {
-    token_.type = Token::kDef;
-  } else if (identifier_ == "extern") {
-    token_.type = Token::kExtern;
-  } else if (identifier_ == "if") {
-    token_.type = Token::kIf;
-  } else if (identifier_.size() == 1 && !std::isalnum(identifier_[0])) {
-    token_.type = identifier_[0];
+  SetWordToken(identifier_);
+}
+
+void Lexer::NextFromBuffer() {
+  // Single separating spaces are the common case; only hand longer runs
+  // (indentation, blank lines) to the bulk scanner.
+  if (cursor_ != end_ && char_class::IsWhitespace(*cursor_)) {
+    ++cursor_;
+    if (cursor_ != end_ && char_class::IsWhitespace(*cursor_))
+      cursor_ = char_class::SkipWhitespace(cursor_, end_);
+  }
+
+  if (cursor_ == end_) {
+    token_.type = Token::kEof;
+    return;
+  }
+
+  if (char_class::IsDelimiter(*cursor_)) {
+    token_.type = *cursor_++;
+    return;
+  }
+
+  const char *start = cursor_;
+  cursor_ = char_class::FindDelimiter(cursor_ + 1, end_);
+  SetWordToken(std::string_view(start, cursor_ - start));
+}
+
+void Lexer::SetWordToken(std::string_view word) {
+  ClassifyWord(word, &token_);
+  // Buffer mode can point into the source rather than the interned copy.
+  if (token_.type == Token::kIdentifier && input_ == nullptr)
+    token_.value.string_value = word;
+}
+
+// static
+void Lexer::ClassifyWord(std::string_view word, Token *token) {
+  if (char_class::Is(word[0], char_class::kNumberStart) &&
+      ParseNumber(word, &token->value.double_value)) {
+    token->type = Token::kNumber;
+  } else if (word == "def") {
+    token->type = Token::kDef;
+  } else if (word == "extern") {
+    token->type = Token::kExtern;
+  } else if (word == "if") {
+    token->type = Token::kIf;
+  } else if (word.size() == 1 && !std::isalnum(word[0])) {
+    token->type = word[0];
   } else {
-    token_.type = Token::kIdentifier;
-    token_.value.string_value = identifier_;
+    token->type = Token::kIdentifier;
+    token->symbol = Symbol::Intern(word);
+    token->value.string_value = token->symbol.name();
   }
 }
 
@@ -72,68 +110,6 @@ void Lexer::PutBack(char c) {
   lookahead_ = c;
 }
 
-bool Lexer::TokenIsNumeric() {
-  constexpr int kPrefix = 0, kIntPart = 2, kFracPart = 3, kExp = 4;
-  int state = kPrefix;
-  for (char c : identifier_) {
-    switch (std::tolower(c)) {
-    case '#':
-    case 'b':
-    case 'o':
-    case 'x':
-    case 'i':
-      if (state == kPrefix) {
-        continue;
-      } else {
-        return false;
-      }
-    case 's':
-    case 'f':
-    case 'l':
-      if (state == kIntPart || state == kFracPart) {
-        state = kExp;
-        continue;
-      } else {
-        return false;
-      }
-    case 'd':
-    case 'e':
-      if (state == kPrefix) {
-        continue;
-      } else if (state == kIntPart || state == kFracPart) {
-        state = kExp;
-        continue;
-      } else {
-        return false;
-      }
-    case '.':
-      if (state == kPrefix || state == kIntPart) {
-        state = kFracPart;
-        continue;
-      } else {
-        return false;
-      }
-    case '0':
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9':
-      if (state == kPrefix) {
-        state = kIntPart;
-      }
-      continue;
-    default:
-      return false;
-    }
-  }
-  return state != kPrefix;
-}
-
 void Lexer::Debug() {
   switch (token_.type) {
   case Token::kDef:
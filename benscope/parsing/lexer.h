@@ -3,8 +3,11 @@
 
 #include <cstdint>
 #include <istream>
+#include <string>
 #include <string_view>
 
+#include "benscope/parsing/symbol.h"
+
 namespace benscope {
 
 union TokenValue {
@@ -25,32 +28,50 @@ struct Token {
 
   char type;
   TokenValue value;
+  // The interned name of a kIdentifier token.
+  Symbol symbol;
 };
 
 class Lexer {
 public:
+  // Reads characters one at a time from `input`, which must outlive the lexer.
+  // An identifier's string_value is its interned name.
   explicit Lexer(std::istream *input);
 
+  // Lexes an in-memory source, e.g. a SourceBuffer's view().  Identifier
+  // string_values point directly into `source` and stay valid for as long as
+  // it does, not just until the next call to Next().
+  explicit Lexer(std::string_view source);
+
   void Debug();
   void Next();
 
+  // Sets `token` from a complete word: a number, keyword, single-character
+  // operator or identifier.  An identifier's string_value is its interned
+  // name, so `word` need not outlive the token.
+  static void ClassifyWord(std::string_view word, Token *token);
+
   const Token &token() const { return token_; }
 
 private:
-  static bool IsDelimiter(char c);
-  static bool IsWhitespace(char c);
+  static constexpr char kNone = 5;
 
+  void NextFromBuffer();
+  void SetWordToken(std::string_view word);
 
-  static constexpr char kNone = 5;
-  
   char NextChar();
   void PutBack(char c);
-  bool TokenIsNumeric();
 
-  std::istream *input_;
-  Token token_{Token::kEof, {0}};
+  // Stream mode.
+  std::istream *input_ = nullptr;
   char lookahead_ = kNone;
   std::string identifier_;
+
+  // Buffer mode, used when input_ is null.
+  const char *cursor_ = nullptr;
+  const char *end_ = nullptr;
+
+  Token token_{Token::kEof, {}};
 };
 } // namespace benscope
 
@@ -0,0 +1,120 @@
+// Lexer throughput.  Run with --benchmark_counters_tabular=true to compare
+// tokens/s across the scanning implementations.
+
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "benscope/parsing/char_class.h"
+#include "benscope/parsing/lexer.h"
+
+namespace benscope {
+namespace {
+
+// Roughly the shape of our generated sources: nested arithmetic over short
+// identifiers, indented one form per line.
+std::string MakeSource(int forms) {
+  std::mt19937 rng(42);
+  std::string source;
+  for (int f = 0; f < forms; ++f) {
+    source += "(def f" + std::to_string(f) + " (alpha beta gamma)\n";
+    for (int i = 0; i < 8; ++i) {
+      source += "        (+ (* alpha " + std::to_string(rng() % 1000) +
+                ".25) (- beta_" + std::to_string(rng() % 10) + " gamma))\n";
+    }
+    source += ")\n\n";
+  }
+  return source;
+}
+
+// Machine-generated code at its worst: deep indentation and long mangled
+// names.  This is where block scanning pays off.
+std::string MakeWideSource(int forms) {
+  std::string source;
+  const std::string name(40, 'n');
+  for (int f = 0; f < forms; ++f) {
+    source += "(def " + name + std::to_string(f) + " (" + name + ")\n";
+    for (int i = 0; i < 8; ++i) {
+      source += std::string(48, ' ') + "(+ " + name + " " + name + "_" +
+                std::to_string(i) + ")\n";
+    }
+    source += ")\n\n";
+  }
+  return source;
+}
+
+const std::string &Source() {
+  static const std::string *source = new std::string(MakeSource(2000));
+  return *source;
+}
+
+const std::string &WideSource() {
+  static const std::string *source = new std::string(MakeWideSource(1000));
+  return *source;
+}
+
+void CountTokens(benchmark::State &state, const std::string &source,
+                 int64_t tokens) {
+  state.counters["tokens/s"] =
+      benchmark::Counter(static_cast<double>(tokens), benchmark::Counter::kIsRate);
+  state.SetBytesProcessed(state.iterations() * source.size());
+}
+
+void BM_LexStream(benchmark::State &state) {
+  int64_t tokens = 0;
+  for (auto _ : state) {
+    std::istringstream input(Source());
+    Lexer lexer(&input);
+    for (; lexer.token().type != Token::kEof; lexer.Next())
+      ++tokens;
+  }
+  CountTokens(state, Source(), tokens);
+}
+BENCHMARK(BM_LexStream);
+
+void BM_LexBuffer(benchmark::State &state) {
+  int64_t tokens = 0;
+  for (auto _ : state) {
+    Lexer lexer(Source());
+    for (; lexer.token().type != Token::kEof; lexer.Next())
+      ++tokens;
+  }
+  CountTokens(state, Source(), tokens);
+}
+BENCHMARK(BM_LexBuffer);
+
+// The raw scanning kernels, per implementation, driven the way the buffer
+// lexer drives them: alternate whitespace runs and words.
+void BM_Scan(benchmark::State &state, const std::string &(*source)(),
+             const char_class::Scanner *scanner) {
+  if (scanner == nullptr) {
+    state.SkipWithError("Not supported on this CPU.");
+    return;
+  }
+  const char *begin = source().data(), *end = begin + source().size();
+  int64_t tokens = 0;
+  for (auto _ : state) {
+    const char *p = begin;
+    while (p != end) {
+      p = scanner->skip_whitespace(p, end);
+      if (p == end)
+        break;
+      p = char_class::IsDelimiter(*p) ? p + 1
+                                      : scanner->find_delimiter(p + 1, end);
+      ++tokens;
+    }
+    benchmark::DoNotOptimize(p);
+  }
+  CountTokens(state, source(), tokens);
+}
+BENCHMARK_CAPTURE(BM_Scan, typical_scalar, Source, &char_class::ScalarScanner());
+BENCHMARK_CAPTURE(BM_Scan, typical_sse2, Source, char_class::Sse2Scanner());
+BENCHMARK_CAPTURE(BM_Scan, typical_avx2, Source, char_class::Avx2Scanner());
+BENCHMARK_CAPTURE(BM_Scan, wide_scalar, WideSource,
+                  &char_class::ScalarScanner());
+BENCHMARK_CAPTURE(BM_Scan, wide_sse2, WideSource, char_class::Sse2Scanner());
+BENCHMARK_CAPTURE(BM_Scan, wide_avx2, WideSource, char_class::Avx2Scanner());
+
+} // namespace
+} // namespace benscope
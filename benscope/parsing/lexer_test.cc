@@ -68,6 +68,22 @@ TEST(LexerTest, NumericLiterals) {
   EXPECT_THAT(lexer.token().value.double_value, Eq(1.125));
 }
 
+TEST(LexerTest, RadixAndExponentLiterals) {
+  Lexer lexer("#xff 1.5d2 #b101 x1");
+
+  EXPECT_THAT(lexer.token().type, Eq(Token::kNumber));
+  EXPECT_THAT(lexer.token().value.double_value, Eq(255.0));
+  lexer.Next();
+  EXPECT_THAT(lexer.token().type, Eq(Token::kNumber));
+  EXPECT_THAT(lexer.token().value.double_value, Eq(150.0));
+  lexer.Next();
+  EXPECT_THAT(lexer.token().type, Eq(Token::kNumber));
+  EXPECT_THAT(lexer.token().value.double_value, Eq(5.0));
+  lexer.Next();
+  EXPECT_THAT(lexer.token().type, Eq(Token::kIdentifier));
+  EXPECT_THAT(lexer.token().value.string_value, Eq("x1"));
+}
+
 TEST(LexerTest, ReservedWords) {
   std::stringstream ss;
   ss << "def defy extern external if";
@@ -125,6 +141,7 @@ TEST(LexerTest, LexDefintion) {
     if (tok.type == Token::kIdentifier) {
       EXPECT_TRUE(i != ids.end());
       EXPECT_THAT(tok.value.string_value, Eq(*i));
+      EXPECT_THAT(tok.symbol, Eq(Symbol::Intern(*i)));
       ++i;
     } else if (tok.type == Token::kNumber) {
       EXPECT_TRUE(n != nums.end());
@@ -139,5 +156,43 @@ TEST(LexerTest, LexDefintion) {
   EXPECT_TRUE(n == nums.end());
 }
 
+TEST(LexerTest, BufferMatchesStream) {
+  constexpr std::string_view kSource =
+      "(def fib (n o y)\n  (if (< y 2) n (fib (+ n o) n (- y 1.5e0))))";
+  std::stringstream ss;
+  ss << kSource;
+
+  Lexer streamed(&ss);
+  Lexer buffered(kSource);
+  while (streamed.token().type != Token::kEof) {
+    ASSERT_THAT(buffered.token().type, Eq(streamed.token().type));
+    if (streamed.token().type == Token::kIdentifier) {
+      EXPECT_THAT(buffered.token().value.string_value,
+                  Eq(streamed.token().value.string_value));
+    } else if (streamed.token().type == Token::kNumber) {
+      EXPECT_THAT(buffered.token().value.double_value,
+                  Eq(streamed.token().value.double_value));
+    }
+    streamed.Next();
+    buffered.Next();
+  }
+  EXPECT_THAT(buffered.token().type, Eq(Token::kEof));
+}
+
+TEST(LexerTest, BufferViewsOutliveTokens) {
+  constexpr std::string_view kSource = "alpha beta";
+  Lexer lexer(kSource);
+
+  std::string_view alpha = lexer.token().value.string_value;
+  lexer.Next();
+  std::string_view beta = lexer.token().value.string_value;
+  lexer.Next();
+
+  EXPECT_THAT(alpha, Eq("alpha"));
+  EXPECT_THAT(beta, Eq("beta"));
+  EXPECT_THAT(alpha.data(), Eq(kSource.data()));
+  EXPECT_THAT(lexer.token().type, Eq(Token::kEof));
+}
+
 } // namespace
 } // namespace benscope
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "benscope/parsing/numeric_literal.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace benscope {
+namespace {
+
+// Powers of ten that are exactly representable as doubles.
+constexpr double kExactPowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+constexpr int kMaxExactPowerOfTen = 22;
+constexpr std::uint64_t kMaxExactMantissa = std::uint64_t{1} << 53;
+
+int DigitValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c |= 0x20;
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 10;
+  return 36;
+}
+
+int RadixBits(int radix) {
+  switch (radix) {
+  case 2:
+    return 1;
+  case 8:
+    return 3;
+  default:
+    return 4;
+  }
+}
+
+} // namespace
+
+bool ParseNumber(std::string_view word, double *value) {
+  const char *p = word.data();
+  const char *const end = p + word.size();
+
+  int radix = 10;
+  while (end - p >= 2 && p[0] == '#') {
+    switch (p[1] | 0x20) {
+    case 'x':
+      radix = 16;
+      break;
+    case 'o':
+      radix = 8;
+      break;
+    case 'b':
+      radix = 2;
+      break;
+    case 'd':
+      radix = 10;
+      break;
+    case 'e':
+    case 'i':
+      break;
+    default:
+      return false;
+    }
+    p += 2;
+  }
+
+  // Accumulate as many significant digits as fit in 64 bits; `scale` counts
+  // the radix places the mantissa must be shifted by to get the true value.
+  const int max_digits = radix == 10 ? 19 : 64 / RadixBits(radix);
+  const char *const mantissa_begin = p;
+  std::uint64_t mantissa = 0;
+  int digits = 0, scale = 0;
+  bool any_digit = false, seen_dot = false, truncated = false;
+  for (; p != end; ++p) {
+    if (*p == '.') {
+      if (seen_dot)
+        return false;
+      seen_dot = true;
+      continue;
+    }
+    int d = DigitValue(*p);
+    if (d >= radix)
+      break;
+    any_digit = true;
+    if (digits < max_digits) {
+      mantissa = mantissa * radix + d;
+      if (mantissa != 0)
+        ++digits;
+      if (seen_dot)
+        --scale;
+    } else {
+      truncated |= d != 0;
+      if (!seen_dot)
+        ++scale;
+    }
+  }
+  if (!any_digit)
+    return false;
+  const char *const mantissa_end = p;
+
+  int exponent = 0;
+  if (p != end) {
+    if (radix != 10)
+      return false;
+    switch (*p | 0x20) {
+    case 'e':
+    case 's':
+    case 'f':
+    case 'd':
+    case 'l':
+      break;
+    default:
+      return false;
+    }
+    ++p;
+    bool negative = false;
+    if (p != end && (*p == '+' || *p == '-'))
+      negative = *p++ == '-';
+    if (p == end)
+      return false;
+    for (; p != end; ++p) {
+      if (*p < '0' || *p > '9')
+        return false;
+      if (exponent < 100000)
+        exponent = exponent * 10 + (*p - '0');
+    }
+    if (negative)
+      exponent = -exponent;
+  }
+
+  if (radix != 10) {
+    // Scaling by a power of two is exact, so the only rounding is the
+    // conversion of the mantissa.  Dropped nonzero digits become a sticky bit
+    // so that it still rounds correctly.
+    if (truncated)
+      mantissa |= 1;
+    *value = std::ldexp(static_cast<double>(mantissa), scale * RadixBits(radix));
+    return true;
+  }
+
+  // Clinger's fast path: both the mantissa and the power of ten are exact
+  // doubles, so a single multiply or divide rounds correctly.
+  int exp10 = scale + exponent;
+  if (mantissa == 0) {
+    *value = 0.0;
+    return true;
+  }
+  if (!truncated && mantissa <= kMaxExactMantissa &&
+      exp10 >= -kMaxExactPowerOfTen && exp10 <= kMaxExactPowerOfTen) {
+    double m = static_cast<double>(mantissa);
+    *value = exp10 < 0 ? m / kExactPowersOfTen[-exp10]
+                       : m * kExactPowersOfTen[exp10];
+    return true;
+  }
+
+  // Rare: too many digits or an extreme exponent.  Hand strtod the mantissa
+  // with a plain 'e' exponent, which it does understand.
+  std::string normalized(mantissa_begin, mantissa_end);
+  normalized += 'e';
+  normalized += std::to_string(exponent);
+  *value = std::strtod(normalized.c_str(), nullptr);
+  return true;
+}
+
+} // namespace benscope
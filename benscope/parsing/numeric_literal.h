@@ -0,0 +1,28 @@
+// Numeric literal recognition and conversion.
+
+#ifndef __BENSCOPE_PARSING_NUMERIC_LITERAL_H__
+#define __BENSCOPE_PARSING_NUMERIC_LITERAL_H__
+
+#include <string_view>
+
+namespace benscope {
+
+// Decides whether `word` is a numeric literal and, if so, stores its value in
+// *value, in a single pass over the characters.  Returns false and leaves
+// *value alone for anything else, which the lexer then treats as an
+// identifier.  Letters are case-insensitive.
+//
+//   number   ::= prefix* mantissa exponent?
+//   prefix   ::= '#x' | '#o' | '#b' | '#d'    radix 16, 8, 2, 10
+//              | '#e' | '#i'                  exactness; ignored
+//   mantissa ::= digit+ ('.' digit*)? | '.' digit+
+//   exponent ::= ('e' | 's' | 'f' | 'd' | 'l') ('+' | '-')? decimal-digit+
+//
+// Digits are those of the radix, and exponents are only allowed in radix 10
+// (in radix 16 'd', 'e' and 'f' are digits).  Decimal values are correctly
+// rounded.
+bool ParseNumber(std::string_view word, double *value);
+
+} // namespace benscope
+
+#endif // __BENSCOPE_PARSING_NUMERIC_LITERAL_H__
@@ -0,0 +1,91 @@
+#include "benscope/parsing/numeric_literal.h"
+
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::DoubleEq;
+using ::testing::Eq;
+
+double Parse(std::string_view word) {
+  double value = -12345;
+  EXPECT_TRUE(ParseNumber(word, &value)) << word;
+  return value;
+}
+
+bool IsNumber(std::string_view word) {
+  double value;
+  return ParseNumber(word, &value);
+}
+
+TEST(NumericLiteralTest, Decimal) {
+  EXPECT_THAT(Parse("0"), Eq(0.0));
+  EXPECT_THAT(Parse("42"), Eq(42.0));
+  EXPECT_THAT(Parse("1.125"), Eq(1.125));
+  EXPECT_THAT(Parse(".5"), Eq(0.5));
+  EXPECT_THAT(Parse("2."), Eq(2.0));
+  EXPECT_THAT(Parse("0.1"), Eq(0.1));
+  EXPECT_THAT(Parse("000123.4500"), Eq(123.45));
+}
+
+TEST(NumericLiteralTest, ExponentMarkers) {
+  EXPECT_THAT(Parse("1e3"), Eq(1000.0));
+  EXPECT_THAT(Parse("1.5s2"), Eq(150.0));
+  EXPECT_THAT(Parse("25f-1"), Eq(2.5));
+  EXPECT_THAT(Parse("3d+2"), Eq(300.0));
+  EXPECT_THAT(Parse("7L0"), Eq(7.0));
+  EXPECT_THAT(Parse("1E-400"), Eq(0.0));
+  EXPECT_THAT(Parse("1e400"), Eq(HUGE_VAL));
+}
+
+TEST(NumericLiteralTest, Radix) {
+  EXPECT_THAT(Parse("#xff"), Eq(255.0));
+  EXPECT_THAT(Parse("#XdeadBEEF"), Eq(3735928559.0));
+  EXPECT_THAT(Parse("#b1011"), Eq(11.0));
+  EXPECT_THAT(Parse("#o777"), Eq(511.0));
+  EXPECT_THAT(Parse("#d19"), Eq(19.0));
+  EXPECT_THAT(Parse("#x1.8"), Eq(1.5));
+  EXPECT_THAT(Parse("#b0.011"), Eq(0.375));
+  // Exactness prefixes combine with radix prefixes and are otherwise ignored.
+  EXPECT_THAT(Parse("#e#x10"), Eq(16.0));
+  EXPECT_THAT(Parse("#i2.5"), Eq(2.5));
+  EXPECT_THAT(Parse("#xffffffffffffffffff"), Eq(0x1p72 - 1));
+}
+
+TEST(NumericLiteralTest, NotNumbers) {
+  for (std::string_view word :
+       {"", ".", "#", "#x", "#q1", "x1", "e1", "d2", "1e", "1e+", "1.2.3",
+        "#b102", "#o8", "#xff.f.", "1x", "12abc", "+", "-5", "1e5.0", "#x1e+2",
+        "fib"}) {
+    EXPECT_FALSE(IsNumber(word)) << word;
+  }
+}
+
+// Whatever the fast path can't round exactly has to fall back, so every
+// decimal must agree with strtod.
+TEST(NumericLiteralTest, MatchesStrtod) {
+  std::mt19937_64 rng(99);
+  for (int i = 0; i < 20000; ++i) {
+    std::string text = std::to_string(rng() % 100000000000000000ull);
+    if (rng() % 2)
+      text.insert(rng() % text.size(), ".");
+    if (rng() % 2)
+      text += "e" + std::to_string(static_cast<int>(rng() % 640) - 320);
+    EXPECT_THAT(Parse(text), Eq(std::strtod(text.c_str(), nullptr))) << text;
+  }
+  for (std::string_view long_text :
+       {"123456789012345678901234567890", "0.30000000000000000000000001",
+        "2.2250738585072011e-308", "9007199254740993"}) {
+    std::string text(long_text);
+    EXPECT_THAT(Parse(text), Eq(std::strtod(text.c_str(), nullptr))) << text;
+  }
+}
+
+} // namespace
+} // namespace benscope
@@ -0,0 +1,115 @@
+#include "benscope/parsing/parallel_parser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+
+namespace benscope {
+namespace {
+
+// Workers claim this much source at a time, so that small forms do not cost
+// a trip through the shared counter each.
+constexpr std::size_t kBatchBytes = 16 << 10;
+
+void ParseBatch(std::string_view source, std::vector<FlatAst> *forms) {
+  Parser parser(std::make_unique<Lexer>(source));
+  // Build each form in a reused scratch tree and keep an exactly sized copy,
+  // rather than growing a fresh one node by node.
+  FlatAst scratch;
+  while (!parser.eof()) {
+    if (parser.ParseNext(&scratch)) {
+      forms->push_back(scratch);
+    } else {
+      std::cerr << "Unhandled text.";
+      parser.GetNextToken();
+    }
+  }
+}
+
+} // namespace
+
+std::vector<std::string_view> SplitForms(std::string_view source) {
+  std::vector<std::string_view> pieces;
+  const char *begin = source.data();
+  const char *const end = begin + source.size();
+  int depth = 0;
+  for (const char *p = begin; p != end; ++p) {
+    switch (*p) {
+    case '(':
+      ++depth;
+      break;
+    case ')':
+      // A stray ')' at the top level is left for the parser to complain
+      // about, along with the next form.
+      if (depth > 0 && --depth == 0) {
+        pieces.emplace_back(begin, p + 1 - begin);
+        begin = p + 1;
+      }
+      break;
+    case Token::kEof:
+      // The lexer stops here too.
+      if (begin != p)
+        pieces.emplace_back(begin, p - begin);
+      return pieces;
+    }
+  }
+  if (begin != end)
+    pieces.emplace_back(begin, end - begin);
+  return pieces;
+}
+
+std::vector<FlatAst> ParseForms(std::string_view source, int threads) {
+  // Group consecutive pieces into batches of roughly kBatchBytes.  Each piece
+  // normally holds one form, which sizes the result vectors up front.
+  struct Batch {
+    std::string_view source;
+    std::size_t pieces;
+  };
+  std::vector<Batch> batches;
+  const std::vector<std::string_view> pieces = SplitForms(source);
+  for (std::string_view piece : pieces) {
+    if (batches.empty() || batches.back().source.size() >= kBatchBytes) {
+      batches.push_back({piece, 1});
+    } else {
+      Batch &batch = batches.back();
+      batch.source = std::string_view(batch.source.data(),
+                                      batch.source.size() + piece.size());
+      ++batch.pieces;
+    }
+  }
+
+  std::vector<std::vector<FlatAst>> results(batches.size());
+  std::atomic<std::size_t> next{0};
+  auto work = [&] {
+    for (std::size_t i; (i = next.fetch_add(1)) < batches.size();) {
+      results[i].reserve(batches[i].pieces);
+      ParseBatch(batches[i].source, &results[i]);
+    }
+  };
+
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min<std::size_t>(threads, batches.size());
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; ++t)
+    workers.emplace_back(work);
+  work();
+  for (std::thread &worker : workers)
+    worker.join();
+
+  std::vector<FlatAst> forms;
+  forms.reserve(pieces.size());
+  for (std::vector<FlatAst> &batch : results)
+    std::move(batch.begin(), batch.end(), std::back_inserter(forms));
+  return forms;
+}
+
+} // namespace benscope
@@ -0,0 +1,29 @@
+// Parses the top-level forms of a source on several threads.
+
+#ifndef __BENSCOPE_PARSING_PARALLEL_PARSER_H__
+#define __BENSCOPE_PARSING_PARALLEL_PARSER_H__
+
+#include <string_view>
+#include <vector>
+
+#include "benscope/parsing/flat_ast.h"
+
+namespace benscope {
+
+// Splits `source` just after each ')' that closes a top-level form, by
+// counting parentheses without lexing.  Concatenating the pieces gives back
+// `source`.  Anything between forms, such as stray tokens, stays in the
+// piece of the form that follows it, so parsing each piece on its own
+// reports the same errors as parsing the whole.
+std::vector<std::string_view> SplitForms(std::string_view source);
+
+// Parses every top-level form of `source`, spreading the pieces from
+// SplitForms over `threads` worker threads (0 means one per core), and
+// returns them in source order.  Forms that fail to parse are reported on
+// std::cerr and skipped, as with a sequential Parser loop, although messages
+// from different threads may interleave.
+std::vector<FlatAst> ParseForms(std::string_view source, int threads = 0);
+
+} // namespace benscope
+
+#endif // __BENSCOPE_PARSING_PARALLEL_PARSER_H__
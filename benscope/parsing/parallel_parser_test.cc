@@ -0,0 +1,72 @@
+#include "benscope/parsing/parallel_parser.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/parsing/printer.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+
+std::string PrintSequential(std::string_view text) {
+  Parser parser(std::make_unique<Lexer>(text));
+  FlatAst form;
+  PrintingVisitor v;
+  while (!parser.eof()) {
+    if (parser.ParseNext(&form))
+      v.Print(form);
+    else
+      parser.GetNextToken();
+  }
+  return v.ToString();
+}
+
+std::string PrintAll(const std::vector<FlatAst> &forms) {
+  PrintingVisitor v;
+  for (const FlatAst &form : forms)
+    v.Print(form);
+  return v.ToString();
+}
+
+TEST(SplitFormsTest, SplitsAfterTopLevelParens) {
+  EXPECT_THAT(SplitForms("(def f (x) (+ x 1))\n(f 2) (extern g ())"),
+              ElementsAre("(def f (x) (+ x 1))", "\n(f 2)", " (extern g ())"));
+}
+
+TEST(SplitFormsTest, KeepsStrayTextWithTheNextForm) {
+  EXPECT_THAT(SplitForms("x ) (f 1) y"), ElementsAre("x ) (f 1)", " y"));
+  EXPECT_THAT(SplitForms("(f (g 1)"), ElementsAre("(f (g 1)"));
+}
+
+TEST(SplitFormsTest, StopsAtEof) {
+  EXPECT_THAT(SplitForms("(f 1)\4(g 2)"), ElementsAre("(f 1)"));
+  EXPECT_THAT(SplitForms(""), IsEmpty());
+}
+
+TEST(ParseFormsTest, MatchesSequentialParse) {
+  std::string source;
+  for (int i = 0; i < 2000; ++i) {
+    source += "(def f" + std::to_string(i) + " (a b) (if (< a " +
+              std::to_string(i) + ") (f" + std::to_string(i) +
+              " b a) (+ a b)))\n(f" + std::to_string(i) + " 1 2)\n";
+    if (i % 500 == 0)
+      source += "oops ) (def) ";
+  }
+  const std::string expected = PrintSequential(source);
+  for (int threads : {1, 2, 4, 16})
+    EXPECT_THAT(PrintAll(ParseForms(source, threads)), Eq(expected))
+        << threads << " threads";
+}
+
+} // namespace
+} // namespace benscope
@@ -8,6 +8,7 @@ template <typename T> std::unique_ptr<T> LogError(std::string_view message) {
   std::cerr << message << "\n";
   return nullptr;
 }
+
 } // namespace
 
 bool Parser::eof() { return token_.type == Token::kEof; }
@@ -21,12 +22,13 @@ std::unique_ptr<AST> Parser::ParseNext() {
   GetNextToken(); // Eat '('
 
   auto ast = ParseParenExpr();
+  if (!ast)
+    return nullptr;
 
-  if (dynamic_cast<ExprAST *>(ast.get())) {
-    std::unique_ptr<ExprAST> expr(dynamic_cast<ExprAST *>(ast.release()));
+  if (std::unique_ptr<ExprAST> expr = AstCast<ExprAST>(ast)) {
     // Make an anonymous proto.
-    auto p = std::make_unique<PrototypeAST>(std::string(kAnonExpr),
-                                            std::vector<std::string>{});
+    auto p = std::make_unique<PrototypeAST>(AnonExprSymbol(),
+                                            std::vector<Symbol>{});
     return std::make_unique<FunctionAST>(std::move(p), std::move(expr));
   }
 
@@ -72,9 +74,10 @@ std::unique_ptr<ExprAST> Parser::ParseExpression() {
   case '(': {
     GetNextToken();
     auto ast = ParseParenExpr();
-    if (dynamic_cast<ExprAST *>(ast.get())) {
-      return std::unique_ptr<ExprAST>(dynamic_cast<ExprAST *>(ast.release()));
-    }
+    if (!ast)
+      return nullptr;
+    if (std::unique_ptr<ExprAST> expr = AstCast<ExprAST>(ast))
+      return expr;
     return LogError<ExprAST>("Found an internal extern or def.");
   }
   case Token::kEof:
@@ -102,15 +105,15 @@ std::unique_ptr<PrototypeAST> Parser::ParsePrototype() {
     return LogError<PrototypeAST>(
         "Expected function name at start of prototype");
 
-  std::string fnName(token_.value.string_value);
+  Symbol fnName = token_.symbol;
   GetNextToken();
 
   if (token_.type != '(')
     return LogError<PrototypeAST>("Expected '(' in prototype");
 
-  std::vector<std::string> argNames;
+  std::vector<Symbol> argNames;
   while (GetNextToken().type == Token::kIdentifier) {
-    argNames.emplace_back(token_.value.string_value);
+    argNames.push_back(token_.symbol);
   }
 
   if (token_.type != ')')
@@ -135,7 +138,7 @@ std::unique_ptr<NumberExprAST> Parser::ParseNumberExpr() {
 /// variableexpr ::= identifier
 std::unique_ptr<VariableExprAST> Parser::ParseVariableExpr() {
   //std::cerr << "\nParseVariableExpr\n";
-  auto result = std::make_unique<VariableExprAST>(token_.value.string_value);
+  auto result = std::make_unique<VariableExprAST>(token_.symbol);
   GetNextToken(); // consume the identifier
   return std::move(result);
 }
@@ -196,7 +199,7 @@ std::unique_ptr<AST> Parser::ParseParenExpr() {
 /// callexpr ::= {'('} identifier expr* ')'
 std::unique_ptr<CallExprAST> Parser::ParseCallExpr() {
   // std::cerr << "(Enter ParseCallExpr)\n";
-  std::string idName(token_.value.string_value);
+  Symbol idName = token_.symbol;
 
   std::vector<std::unique_ptr<ExprAST>> args;
   GetNextToken(); // Eat callee name;
@@ -236,4 +239,9 @@ std::unique_ptr<BinaryExprAST> Parser::ParseOpExpr() {
   return std::make_unique<BinaryExprAST>(op, std::move(lhs), std::move(rhs));
 }
 
-} // namespace benscope
\ No newline at end of file
+bool Parser::ParseNext(FlatAst *form) {
+  builder_.Start(form);
+  return builder_.FeedFrom(lexer_.get()) == FormBuilder::kDone;
+}
+
+} // namespace benscope
@@ -6,6 +6,8 @@
 #include <vector>
 
 #include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/form_builder.h"
 #include "benscope/parsing/lexer.h"
 
 namespace benscope {
@@ -15,9 +17,18 @@ public:
   explicit Parser(std::unique_ptr<Lexer> lexer)
       : lexer_(std::move(lexer)), token_(lexer_->token()) {}
 
+  // Recursive descent into a pointer tree.  Native stack use grows with the
+  // nesting depth of the input, so very deeply nested machine-generated code
+  // should go through the FlatAst overload instead.
   std::unique_ptr<AST> ParseNext();
   std::unique_ptr<ExprAST> ParseExpression();
 
+  // Parses the next top-level form into `form`, replacing its contents, and
+  // returns whether that succeeded.  Reusing one FlatAst across calls keeps
+  // its storage, so steady-state parsing allocates nothing per node.  This
+  // runs FormBuilder's explicit stack, so any nesting depth is fine.
+  bool ParseNext(FlatAst *form);
+
   const Token &GetNextToken();
 
   bool eof();
@@ -40,6 +51,8 @@ private:
 
   std::unique_ptr<Lexer> lexer_;
   const Token &token_;
+
+  FormBuilder builder_;
 };
 } // namespace benscope
 
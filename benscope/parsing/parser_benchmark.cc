@@ -0,0 +1,119 @@
+// Parser throughput: recursive descent into the pointer tree versus the
+// explicit-stack FormBuilder into a reused FlatAst, and the latter split across
+// threads by ParseForms.  BM_LoadAstFile reads the same forms back from a
+// binary AST file instead.  Run with --benchmark_counters_tabular=true.
+
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "benchmark/benchmark.h"
+#include "benscope/parsing/ast_file.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parallel_parser.h"
+#include "benscope/parsing/parser.h"
+
+namespace benscope {
+namespace {
+
+// Nested arithmetic, conditionals and calls over a few variables.
+std::string MakeExpr(std::mt19937 *rng, int depth) {
+  if (depth == 0) {
+    switch ((*rng)() % 3) {
+    case 0:
+      return std::to_string((*rng)() % 1000);
+    case 1:
+      return "alpha";
+    default:
+      return "beta";
+    }
+  }
+  switch ((*rng)() % 4) {
+  case 0:
+    return "(+ " + MakeExpr(rng, depth - 1) + " " + MakeExpr(rng, depth - 1) +
+           ")";
+  case 1:
+    return "(< " + MakeExpr(rng, depth - 1) + " " + MakeExpr(rng, depth - 1) +
+           ")";
+  case 2:
+    return "(if " + MakeExpr(rng, depth - 1) + " " +
+           MakeExpr(rng, depth - 1) + " " + MakeExpr(rng, depth - 1) + ")";
+  default:
+    return "(f " + MakeExpr(rng, depth - 1) + " " + MakeExpr(rng, depth - 1) +
+           ")";
+  }
+}
+
+const std::string &Source() {
+  static const std::string *source = [] {
+    std::mt19937 rng(42);
+    auto *source = new std::string;
+    for (int f = 0; f < 500; ++f) {
+      *source += "(def f" + std::to_string(f) + " (alpha beta)\n  " +
+                 MakeExpr(&rng, 6) + ")\n";
+    }
+    return source;
+  }();
+  return *source;
+}
+
+void SetBytes(benchmark::State &state) {
+  state.SetBytesProcessed(state.iterations() * Source().size());
+}
+
+void BM_ParseTree(benchmark::State &state) {
+  for (auto _ : state) {
+    Parser parser(std::make_unique<Lexer>(Source()));
+    while (!parser.eof())
+      benchmark::DoNotOptimize(parser.ParseNext());
+  }
+  SetBytes(state);
+}
+BENCHMARK(BM_ParseTree);
+
+void BM_ParseFlat(benchmark::State &state) {
+  FlatAst form;
+  for (auto _ : state) {
+    Parser parser(std::make_unique<Lexer>(Source()));
+    while (!parser.eof())
+      benchmark::DoNotOptimize(parser.ParseNext(&form));
+  }
+  SetBytes(state);
+}
+BENCHMARK(BM_ParseFlat);
+
+void BM_ParseParallel(benchmark::State &state) {
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ParseForms(Source(), state.range(0)));
+  SetBytes(state);
+}
+BENCHMARK(BM_ParseParallel)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+void BM_LoadAstFile(benchmark::State &state) {
+  AstWriter writer;
+  for (const FlatAst &form : ParseForms(Source(), 1))
+    writer.Add(form);
+  const std::string bytes = writer.Finish();
+
+  FlatAst form;
+  for (auto _ : state) {
+    // The file takes ownership of its buffer, so make a fresh one each time.
+    state.PauseTiming();
+    std::istringstream input(bytes);
+    std::unique_ptr<SourceBuffer> buffer = SourceBuffer::ReadStream(&input);
+    state.ResumeTiming();
+
+    std::unique_ptr<AstFile> file = AstFile::FromBuffer(std::move(buffer));
+    for (std::size_t i = 0; i < file->size(); ++i)
+      file->Load(i, &form);
+  }
+  SetBytes(state);
+  state.counters["file_bytes"] = bytes.size();
+}
+BENCHMARK(BM_LoadAstFile);
+
+} // namespace
+} // namespace benscope
@@ -25,6 +25,18 @@ std::unique_ptr<AST> Parse(std::string_view text) {
   return Parser(std::make_unique<Lexer>(&ss)).ParseNext();
 }
 
+std::string PrintFlat(std::string_view text) {
+  Parser parser(std::make_unique<Lexer>(text));
+  FlatAst form;
+  PrintingVisitor v;
+  while (!parser.eof()) {
+    if (!parser.ParseNext(&form))
+      return "<error>";
+    v.Print(form);
+  }
+  return v.ToString();
+}
+
 std::unique_ptr<AST> ParseExpr(std::string_view text) {
   std::stringstream ss;
   ss << text;
@@ -35,19 +47,19 @@ TEST(ParserTest, CallExpr) {
   auto ast = ParseExpr("(f x y)");
 
   PrintingVisitor v;
-  ast->Accept(v);
+  v.Dispatch(*ast);
   EXPECT_THAT(v.ToString(), Eq("[CALL f {x} {y}]"));
 
-  auto call = dynamic_cast<CallExprAST *>(ast.get());
+  auto call = AstCast<CallExprAST>(ast.get());
   ASSERT_THAT(call, NotNull());
-  EXPECT_THAT(call->callee, Eq("f"));
+  EXPECT_THAT(call->callee.name(), Eq("f"));
 
   std::vector<std::string> vars;
   for (auto &arg : call->args) {
-    auto var = dynamic_cast<VariableExprAST *>(arg.get());
+    auto var = AstCast<VariableExprAST>(arg.get());
     EXPECT_THAT(var, NotNull());
     if (var)
-      vars.push_back(var->name_);
+      vars.emplace_back(var->name_.name());
   }
 
   EXPECT_THAT(vars, ElementsAre("x", "y"));
@@ -65,12 +77,59 @@ TEST(ParserTest, MultiLine) {
   )");
 
   PrintingVisitor v;
-  ast->Accept(v);
+  v.Dispatch(*ast);
 
   EXPECT_THAT(v.ToString(),
               Eq("[DEFINE fib(old new gen) :== [IF [{gen} < [2]] THEN {new} "
                  "ELSE [CALL fib {new} [{old} + {new}] [{gen} - [1]]]]]"));
 }
 
+TEST(ParserTest, FlatMatchesTree) {
+  constexpr std::string_view kSource = R"(
+    (extern sin (x))
+    (def fib (old new gen)
+      (if (< gen 2) new (fib new (+ old new) (- gen 1))))
+    (fib 1 (sin (f)) 30)
+  )";
+
+  Parser parser(std::make_unique<Lexer>(kSource));
+  PrintingVisitor tree;
+  while (!parser.eof()) {
+    auto ast = parser.ParseNext();
+    ASSERT_THAT(ast, NotNull());
+    tree.Dispatch(*ast);
+  }
+
+  EXPECT_THAT(PrintFlat(kSource), Eq(tree.ToString()));
+}
+
+TEST(ParserTest, FlatDeepNesting) {
+  // Far deeper than the recursive parser or printer could go on a default
+  // thread stack.
+  constexpr int kDepth = 1000000;
+  std::string source;
+  for (int i = 0; i < kDepth; ++i)
+    source += "(+ 1 ";
+  source += "x";
+  source.append(kDepth, ')');
+
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  ASSERT_TRUE(parser.ParseNext(&form));
+  EXPECT_TRUE(parser.eof());
+  EXPECT_THAT(form.size(), Eq(2 * kDepth + 3));
+
+  PrintingVisitor v;
+  v.Print(form);
+  EXPECT_THAT(v.ToString().substr(0, 40),
+              Eq("[DEFINE __anon_expr() :== [[1] + [[1] + "));
+}
+
+TEST(ParserTest, FlatErrors) {
+  EXPECT_THAT(PrintFlat("(f (def g () 1))"), Eq("<error>"));
+  EXPECT_THAT(PrintFlat("(+ 1)"), Eq("<error>"));
+  EXPECT_THAT(PrintFlat("(f (+))"), Eq("<error>"));
+}
+
 } // namespace
 } // namespace benscope
\ No newline at end of file
@@ -10,30 +10,30 @@ namespace benscope {
 
 void PrintingVisitor::Visit(const BinaryExprAST &expr) {
   absl::StrAppend(&_buffer, "[");
-  expr.lhs->Accept(*this);
+  Dispatch(*expr.lhs);
   _buffer.push_back(' ');
   _buffer.push_back(expr.op);
   _buffer.push_back(' ');
-  expr.rhs->Accept(*this);
+  Dispatch(*expr.rhs);
   absl::StrAppend(&_buffer, "]");
 }
 
 void PrintingVisitor::Visit(const CallExprAST &expr) {
-  absl::StrAppend(&_buffer, "[CALL ", expr.callee);
+  absl::StrAppend(&_buffer, "[CALL ", expr.callee.name());
   for (const auto &arg : expr.args) {
     absl::StrAppend(&_buffer, " ");
-    arg->Accept(*this);
+    Dispatch(*arg);
   }
   absl::StrAppend(&_buffer, "]");
 }
 
 void PrintingVisitor::Visit(const IfExprAST &expr) {
   absl::StrAppend(&_buffer, "[IF ");
-  expr.test->Accept(*this);
+  Dispatch(*expr.test);
   absl::StrAppend(&_buffer, " THEN ");
-  expr.if_true->Accept(*this);
+  Dispatch(*expr.if_true);
   absl::StrAppend(&_buffer, " ELSE ");
-  expr.if_false->Accept(*this);
+  Dispatch(*expr.if_false);
   absl::StrAppend(&_buffer, "]");
 }
 
@@ -42,26 +42,101 @@ void PrintingVisitor::Visit(const NumberExprAST &expr) {
 };
 
 void PrintingVisitor::Visit(const VariableExprAST &expr) {
-  absl::StrAppend(&_buffer, "{", expr.name_, "}");
+  absl::StrAppend(&_buffer, "{", expr.name_.name(), "}");
 };
 
 void PrintingVisitor::Visit(const FunctionAST &ast) {
   _inFunc = true;
   absl::StrAppend(&_buffer, "[DEFINE ");
-  ast.proto->Accept(*this);
+  Dispatch(*ast.proto);
   absl::StrAppend(&_buffer, " :== ");
-  ast.body->Accept(*this);
+  Dispatch(*ast.body);
   absl::StrAppend(&_buffer, "]");
   _inFunc = false;
 };
 
 void PrintingVisitor::Visit(const PrototypeAST &ast) {
+  PrintPrototype(ast.name, ast.args);
+};
+
+void PrintingVisitor::Print(const FlatAst &form) {
+  form.Walk(form.root(), [&](const FlatAst::Node &n, int step) {
+    switch (n.kind) {
+    case AstKind::kNumber:
+      absl::StrAppend(&_buffer, "[", n.value, "]");
+      break;
+    case AstKind::kVariable:
+      absl::StrAppend(&_buffer, "{", n.name.name(), "}");
+      break;
+    case AstKind::kBinary:
+      if (step == 0) {
+        absl::StrAppend(&_buffer, "[");
+        return n.operands[0];
+      }
+      if (step == 1) {
+        _buffer.push_back(' ');
+        _buffer.push_back(n.op);
+        _buffer.push_back(' ');
+        return n.operands[1];
+      }
+      absl::StrAppend(&_buffer, "]");
+      break;
+    case AstKind::kCall: {
+      if (step == 0)
+        absl::StrAppend(&_buffer, "[CALL ", n.name.name());
+      FlatAst::Range<FlatAst::Index> args = form.args(n);
+      if (step < static_cast<int>(args.size())) {
+        absl::StrAppend(&_buffer, " ");
+        return args[step];
+      }
+      absl::StrAppend(&_buffer, "]");
+      break;
+    }
+    case AstKind::kIf:
+      if (step < 3) {
+        static constexpr const char *kSeparators[] = {"[IF ", " THEN ",
+                                                      " ELSE "};
+        absl::StrAppend(&_buffer, kSeparators[step]);
+        return n.operands[step];
+      }
+      absl::StrAppend(&_buffer, "]");
+      break;
+    case AstKind::kPrototype: {
+      FlatAst::Range<Symbol> params = form.params(n);
+      PrintPrototype(n.name, absl::MakeConstSpan(params.begin(), params.end()));
+      break;
+    }
+    case AstKind::kFunction:
+      if (step == 0) {
+        _inFunc = true;
+        absl::StrAppend(&_buffer, "[DEFINE ");
+        return n.operands[0];
+      }
+      if (step == 1) {
+        absl::StrAppend(&_buffer, " :== ");
+        return n.operands[1];
+      }
+      absl::StrAppend(&_buffer, "]");
+      _inFunc = false;
+      break;
+    }
+    return FlatAst::kNone;
+  });
+}
+
+void PrintingVisitor::PrintPrototype(Symbol name,
+                                     absl::Span<const Symbol> args) {
   if (!_inFunc)
     absl::StrAppend(&_buffer, "[EXTERN ");
-  absl::StrAppend(&_buffer, ast.name, "(", absl::StrJoin(ast.args, " "), ")");
+  absl::StrAppend(&_buffer, name.name(), "(",
+                  absl::StrJoin(args, " ",
+                                [](std::string *out, Symbol arg) {
+                                  absl::StrAppend(out, arg.name());
+                                }),
+                  ")");
   if (!_inFunc)
     absl::StrAppend(&_buffer, "]");
-};
+}
 
 std::string_view PrintingVisitor::ToStringView() { return _buffer; }
 const std::string &PrintingVisitor::ToString() { return _buffer; }
@@ -5,24 +5,33 @@
 
 #include <string>
 
+#include "absl/types/span.h"
+
 #include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
 
 namespace benscope {
-class PrintingVisitor : public AstVisitor {
+class PrintingVisitor : public StaticAstVisitor<PrintingVisitor> {
 public:
-  void Visit(const BinaryExprAST &expr) override;
-  void Visit(const CallExprAST &expr) override;
-  void Visit(const IfExprAST &expr) override;
-  void Visit(const NumberExprAST &expr) override;
-  void Visit(const VariableExprAST &expr) override;
+  void Visit(const BinaryExprAST &expr);
+  void Visit(const CallExprAST &expr);
+  void Visit(const IfExprAST &expr);
+  void Visit(const NumberExprAST &expr);
+  void Visit(const VariableExprAST &expr);
+
+  void Visit(const FunctionAST &ast);
+  void Visit(const PrototypeAST &ast);
 
-  void Visit(const FunctionAST &ast) override;
-  void Visit(const PrototypeAST &ast) override;
+  // Appends the same text as visiting the equivalent tree would, without
+  // recursing.
+  void Print(const FlatAst &form);
 
   std::string_view ToStringView();
   const std::string &ToString();
 
 private:
+  void PrintPrototype(Symbol name, absl::Span<const Symbol> args);
+
   std::string _buffer;
   bool _inFunc = false;
 };
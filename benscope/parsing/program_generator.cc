@@ -0,0 +1,150 @@
+#include "benscope/parsing/program_generator.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace benscope {
+namespace {
+
+// Depth of the operands off the main path of an expression.
+constexpr int kSideDepth = 2;
+
+class Generator {
+public:
+  explicit Generator(const ProgramShape &shape)
+      : shape_(shape), rng_(shape.seed) {
+    const char kLetters[] = "abcdefghijklmnopqrstuvwxyz";
+    for (int i = 0; i < std::max(1, shape.identifiers); ++i) {
+      std::string name;
+      for (int c = 0; c < std::max(1, shape.identifier_length); ++c)
+        name += kLetters[Pick(26)];
+      // Keep names distinct and clear of the keywords.
+      name += std::to_string(i);
+      names_.push_back(name);
+    }
+  }
+
+  std::string Program() {
+    std::string out;
+    const int externs = std::min(shape_.forms, 4);
+    for (int f = 0; f < shape_.forms; ++f) {
+      if (f < externs) {
+        Function fn = NewFunction("ext");
+        out += "(extern " + fn.name + " (" + Params(fn.arity) + "))\n";
+        functions_.push_back(fn);
+      } else if (f % 8 == 7) {
+        // A top-level expression over literals only.
+        params_ = 0;
+        out += Expr(shape_.depth) + "\n";
+      } else {
+        Function fn = NewFunction("fn");
+        params_ = fn.arity;
+        out += "(def " + fn.name + " (" + Params(fn.arity) + ")\n  " +
+               Expr(shape_.depth) + ")\n";
+        functions_.push_back(fn);
+      }
+    }
+    return out;
+  }
+
+private:
+  struct Function {
+    std::string name;
+    int arity;
+  };
+
+  // std::mt19937 itself is fully specified, unlike the distributions, so
+  // this gives the same programs with any standard library.
+  int Pick(int n) { return rng_() % n; }
+
+  Function NewFunction(const char *prefix) {
+    return {prefix + std::to_string(functions_.size()),
+            1 + Pick(std::min<int>(3, names_.size()))};
+  }
+
+  std::string Params(int arity) {
+    std::string out;
+    for (int i = 0; i < arity; ++i)
+      out += (i > 0 ? " " : "") + names_[i];
+    return out;
+  }
+
+  std::string Number() {
+    switch (Pick(4)) {
+    case 0:
+      return std::to_string(Pick(1000));
+    case 1:
+      return std::to_string(Pick(1000)) + "." + std::to_string(Pick(100));
+    case 2:
+      return std::to_string(1 + Pick(9)) + "e" + std::to_string(Pick(20) - 10);
+    default: {
+      static const char kHex[] = "0123456789abcdef";
+      std::string out = "#x";
+      for (int i = 0; i < 4; ++i)
+        out += kHex[Pick(16)];
+      return out;
+    }
+    }
+  }
+
+  std::string Leaf() {
+    if (params_ == 0 || Pick(100) < shape_.number_percent)
+      return Number();
+    return names_[Pick(params_)];
+  }
+
+  // Opens one level of an expression whose first operand is yet to come,
+  // returning the text that closes it.  `below` is the number of levels
+  // under this one.
+  std::string Open(int below, std::string *out) {
+    const int choice = Pick(functions_.empty() ? 3 : 4);
+    if (choice == 0) {
+      *out += "(if ";
+      return " " + Side(below) + " " + Side(below) + ")";
+    }
+    if (choice < 3) {
+      static const char kOps[] = "+-*<";
+      *out += "(";
+      *out += kOps[Pick(4)];
+      *out += " ";
+      return " " + Side(below) + ")";
+    }
+    const Function &fn = functions_[Pick(functions_.size())];
+    *out += "(" + fn.name + " ";
+    std::string close;
+    for (int i = 1; i < fn.arity; ++i)
+      close += " " + Side(below);
+    return close + ")";
+  }
+
+  std::string Side(int below) { return Expr(std::min(below, kSideDepth)); }
+
+  // An expression `depth` levels deep, built along its first operands without
+  // recursing, so that any depth is fine.
+  std::string Expr(int depth) {
+    std::string out;
+    std::vector<std::string> closers;
+    for (int d = 0; d < depth; ++d)
+      closers.push_back(Open(depth - d - 1, &out));
+    out += Leaf();
+    for (auto it = closers.rbegin(); it != closers.rend(); ++it)
+      out += *it;
+    return out;
+  }
+
+  const ProgramShape &shape_;
+  std::mt19937 rng_;
+  std::vector<std::string> names_;
+  std::vector<Function> functions_;
+  // Parameters in scope in the current body.
+  int params_ = 0;
+};
+
+} // namespace
+
+std::string GenerateProgram(const ProgramShape &shape) {
+  return Generator(shape).Program();
+}
+
+} // namespace benscope
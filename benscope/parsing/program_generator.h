@@ -0,0 +1,34 @@
+// Deterministic synthetic programs for benchmarks and tests.
+
+#ifndef __BENSCOPE_PARSING_PROGRAM_GENERATOR_H__
+#define __BENSCOPE_PARSING_PROGRAM_GENERATOR_H__
+
+#include <cstdint>
+#include <string>
+
+namespace benscope {
+
+struct ProgramShape {
+  // Top-level forms: externs first, then definitions with a top-level
+  // expression after every few.
+  int forms = 1000;
+  // How deeply each body nests.  One operand per level follows the full
+  // depth and the others stay shallow, so size grows linearly with depth.
+  int depth = 6;
+  // Distinct parameter names, and their length in characters.
+  int identifiers = 8;
+  int identifier_length = 5;
+  // Fraction of leaves that are numeric literals rather than variables, in
+  // percent.  Literals mix integers, decimals, exponents and #x prefixes.
+  int number_percent = 30;
+  std::uint32_t seed = 42;
+};
+
+// Generates a well-formed program of the given shape.  The same shape always
+// gives the same text.  Every call is to a function declared earlier with the
+// matching number of arguments, so the programs also compile.
+std::string GenerateProgram(const ProgramShape &shape);
+
+} // namespace benscope
+
+#endif // __BENSCOPE_PARSING_PROGRAM_GENERATOR_H__
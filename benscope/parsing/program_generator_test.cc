@@ -0,0 +1,73 @@
+#include "benscope/parsing/program_generator.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Ne;
+
+// Parses `source`, failing on any error, and returns the number of forms and
+// the deepest parenthesis nesting.
+std::pair<int, int> Measure(const std::string &source) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  int forms = 0;
+  while (!parser.eof()) {
+    EXPECT_TRUE(parser.ParseNext(&form)) << "form " << forms;
+    ++forms;
+  }
+  int depth = 0, max_depth = 0;
+  for (char c : source) {
+    depth += c == '(' ? 1 : c == ')' ? -1 : 0;
+    max_depth = std::max(depth, max_depth);
+  }
+  return {forms, max_depth};
+}
+
+TEST(ProgramGeneratorTest, IsDeterministic) {
+  ProgramShape shape;
+  shape.forms = 50;
+  EXPECT_THAT(GenerateProgram(shape), Eq(GenerateProgram(shape)));
+  ProgramShape other = shape;
+  other.seed = 7;
+  EXPECT_THAT(GenerateProgram(other), Ne(GenerateProgram(shape)));
+}
+
+TEST(ProgramGeneratorTest, FollowsTheShape) {
+  ProgramShape shape;
+  shape.forms = 40;
+  shape.depth = 30;
+  auto [forms, depth] = Measure(GenerateProgram(shape));
+  EXPECT_THAT(forms, Eq(40));
+  // The body's nesting, inside (def ...).
+  EXPECT_THAT(depth, Ge(31));
+}
+
+TEST(ProgramGeneratorTest, HandlesExtremes) {
+  ProgramShape shape;
+  // The first four forms are externs.
+  shape.forms = 6;
+  shape.depth = 100000;
+  shape.identifiers = 1;
+  shape.identifier_length = 1;
+  shape.number_percent = 100;
+  auto [forms, depth] = Measure(GenerateProgram(shape));
+  EXPECT_THAT(forms, Eq(6));
+  EXPECT_THAT(depth, Ge(100000));
+}
+
+} // namespace
+} // namespace benscope
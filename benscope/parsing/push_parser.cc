@@ -0,0 +1,75 @@
+#include "benscope/parsing/push_parser.h"
+
+#include <cassert>
+
+#include "benscope/parsing/char_class.h"
+
+namespace benscope {
+
+void PushParser::Push(std::string_view chunk) {
+  assert(!finished_ && cursor_ == end_);
+  cursor_ = chunk.data();
+  end_ = chunk.data() + chunk.size();
+}
+
+void PushParser::Finish() {
+  assert(cursor_ == end_);
+  finished_ = true;
+}
+
+bool PushParser::NextToken(Token *token) {
+  if (!partial_.empty()) {
+    // Finish the word the previous chunk ended in.
+    const char *stop = char_class::FindDelimiter(cursor_, end_);
+    partial_.append(cursor_, stop);
+    cursor_ = stop;
+    if (cursor_ == end_ && !finished_)
+      return false;
+    Lexer::ClassifyWord(partial_, token);
+    partial_.clear();
+    return true;
+  }
+
+  cursor_ = char_class::SkipWhitespace(cursor_, end_);
+  if (cursor_ == end_)
+    return false;
+
+  if (char_class::IsDelimiter(*cursor_)) {
+    token->type = *cursor_++;
+    return true;
+  }
+
+  const char *start = cursor_;
+  cursor_ = char_class::FindDelimiter(cursor_ + 1, end_);
+  if (cursor_ == end_ && !finished_) {
+    // The word may continue in the next chunk.
+    partial_.assign(start, end_);
+    return false;
+  }
+  Lexer::ClassifyWord(std::string_view(start, cursor_ - start), token);
+  return true;
+}
+
+FormBuilder::Status PushParser::Next() {
+  Token token{Token::kEof, {}};
+  while (NextToken(&token)) {
+    if (!builder_.in_progress()) {
+      if (token.type == Token::kEof)
+        continue;
+      builder_.Start(&form_);
+    }
+    // On an error the builder has stopped and the token is dropped, so the
+    // next call starts over after it.
+    if (FormBuilder::Status status = builder_.Feed(token);
+        status != FormBuilder::kNeedMore)
+      return status;
+  }
+
+  if (finished_ && builder_.in_progress()) {
+    token.type = Token::kEof;
+    return builder_.Feed(token);
+  }
+  return FormBuilder::kNeedMore;
+}
+
+} // namespace benscope
@@ -0,0 +1,74 @@
+// Parses top-level forms from input that arrives in chunks.
+
+#ifndef __BENSCOPE_PARSING_PUSH_PARSER_H__
+#define __BENSCOPE_PARSING_PUSH_PARSER_H__
+
+#include <string>
+#include <string_view>
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/form_builder.h"
+#include "benscope/parsing/lexer.h"
+
+namespace benscope {
+
+// A Parser for sources that are not all in memory at once, such as pipes and
+// sockets.  The caller pushes chunks of any size and pulls each form as soon
+// as its closing paren has arrived.  A word cut off at the end of a chunk and
+// a half-built form are both kept until the next chunk.
+//
+//   PushParser parser;
+//   while (<read a chunk>) {
+//     parser.Push(chunk);
+//     while ((status = parser.Next()) != FormBuilder::kNeedMore)
+//       if (status == FormBuilder::kDone)
+//         <use parser.form()>;
+//   }
+//   parser.Finish();
+//   <drain Next() as above>
+//
+// Errors are reported on std::cerr and recovered from as by the usual Parser
+// loop: the offending token is skipped and parsing starts over at the next
+// one.
+class PushParser {
+public:
+  // Makes `chunk` the pending input.  It must stay valid until Next() returns
+  // kNeedMore, which is also when the next chunk may be pushed.
+  void Push(std::string_view chunk);
+
+  // Marks the end of the input: a word at the end of the last chunk is
+  // complete, and a form that is still open is an error.  Nothing may be
+  // pushed afterwards.
+  void Finish();
+
+  // Parses from the pending input.  Returns kDone with the form in form(),
+  // kError after reporting a malformed form, or kNeedMore once the pending
+  // input is used up.  A Token::kEof character between forms is ignored.
+  FormBuilder::Status Next();
+
+  // The form of the last kDone, valid until the next call to Next().
+  const FlatAst &form() const { return form_; }
+
+  // Whether a form or a word has been started but not finished.
+  bool in_progress() const {
+    return builder_.in_progress() || !partial_.empty();
+  }
+
+private:
+  // Lexes the next token from the pending input.  Returns false if more input
+  // is needed first.
+  bool NextToken(Token *token);
+
+  FormBuilder builder_;
+  FlatAst form_;
+
+  const char *cursor_ = nullptr;
+  const char *end_ = nullptr;
+  // The start of a word that ran into the end of a chunk.
+  std::string partial_;
+  bool finished_ = false;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_PARSING_PUSH_PARSER_H__
@@ -0,0 +1,97 @@
+#include "benscope/parsing/push_parser.h"
+
+#include <memory>
+#include <string>
+
+#include "benscope/parsing/parser.h"
+#include "benscope/parsing/printer.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::Eq;
+
+std::string PrintSequential(std::string_view text) {
+  Parser parser(std::make_unique<Lexer>(text));
+  FlatAst form;
+  PrintingVisitor v;
+  while (!parser.eof()) {
+    if (parser.ParseNext(&form))
+      v.Print(form);
+    else
+      parser.GetNextToken();
+  }
+  return v.ToString();
+}
+
+// Pushes `text` in chunks of `chunk_size` and prints the forms, plus "!" for
+// each error.
+std::string PrintPushed(std::string_view text, std::size_t chunk_size) {
+  PushParser parser;
+  PrintingVisitor v;
+  std::string errors;
+  auto drain = [&] {
+    for (FormBuilder::Status status;
+         (status = parser.Next()) != FormBuilder::kNeedMore;) {
+      if (status == FormBuilder::kDone)
+        v.Print(parser.form());
+      else
+        errors += "!";
+    }
+  };
+  for (std::size_t i = 0; i < text.size(); i += chunk_size) {
+    // Copy each chunk so nothing can point into it once it is used up.
+    std::string chunk(text.substr(i, chunk_size));
+    parser.Push(chunk);
+    drain();
+  }
+  parser.Finish();
+  drain();
+  return v.ToString() + errors;
+}
+
+TEST(PushParserTest, AnyChunkingMatchesSequentialParse) {
+  constexpr std::string_view kSource =
+      "(extern sin (angle))\n"
+      "(def fib (a b n)\n"
+      "  (if (< n 2)\n"
+      "      b\n"
+      "      (fib b (+ a b) (- n 1))))\n"
+      "(fib 1 0 #x1e) (sin 1.5e0)";
+  const std::string expected = PrintSequential(kSource);
+  for (std::size_t size = 1; size <= kSource.size(); ++size)
+    EXPECT_THAT(PrintPushed(kSource, size), Eq(expected)) << size;
+}
+
+TEST(PushParserTest, FormIsReadyAtItsClosingParen) {
+  PushParser parser;
+  parser.Push("(f 1");
+  EXPECT_THAT(parser.Next(), Eq(FormBuilder::kNeedMore));
+  EXPECT_TRUE(parser.in_progress());
+  parser.Push("2)(g");
+  EXPECT_THAT(parser.Next(), Eq(FormBuilder::kDone));
+  PrintingVisitor v;
+  v.Print(parser.form());
+  EXPECT_THAT(v.ToString(), Eq(PrintSequential("(f 12)")));
+  EXPECT_THAT(parser.Next(), Eq(FormBuilder::kNeedMore));
+  EXPECT_TRUE(parser.in_progress());
+}
+
+TEST(PushParserTest, RecoversFromErrors) {
+  // As in the Parser loop, "1", "2" and ")" are each skipped with an error.
+  EXPECT_THAT(PrintPushed("(1 2) (f 1)", 3),
+              Eq(PrintSequential("(f 1)") + "!!!"));
+  // An unfinished form is an error only once the input ends.
+  EXPECT_THAT(PrintPushed("(f 1) (g", 4), Eq(PrintSequential("(f 1)") + "!"));
+}
+
+TEST(PushParserTest, IgnoresEofBetweenForms) {
+  EXPECT_THAT(PrintPushed("(f 1)\4(g 2)", 2),
+              Eq(PrintSequential("(f 1) (g 2)")));
+}
+
+} // namespace
+} // namespace benscope
@@ -0,0 +1,61 @@
+#include "benscope/parsing/source_buffer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace benscope {
+
+// static
+std::unique_ptr<SourceBuffer> SourceBuffer::MapFile(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Unable to open " << path << "\n";
+    return nullptr;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *mapping = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      ::close(fd);
+      ::madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+      std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+      buffer->mapping_ = mapping;
+      buffer->mapping_size_ = st.st_size;
+      buffer->view_ = std::string_view(static_cast<const char *>(mapping),
+                                       buffer->mapping_size_);
+      return buffer;
+    }
+  }
+  ::close(fd);
+
+  // Not mappable (or empty); read it the slow way.
+  std::ifstream input(path, std::ios::binary);
+  if (!input) {
+    std::cerr << "Unable to read " << path << "\n";
+    return nullptr;
+  }
+  return ReadStream(&input);
+}
+
+// static
+std::unique_ptr<SourceBuffer> SourceBuffer::ReadStream(std::istream *input) {
+  std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+  buffer->owned_.assign(std::istreambuf_iterator<char>(*input),
+                        std::istreambuf_iterator<char>());
+  buffer->view_ = buffer->owned_;
+  return buffer;
+}
+
+SourceBuffer::~SourceBuffer() {
+  if (mapping_ != nullptr)
+    ::munmap(mapping_, mapping_size_);
+}
+
+} // namespace benscope
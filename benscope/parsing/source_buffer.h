@@ -0,0 +1,45 @@
+// Whole-file source storage for the zero-copy lexer.
+
+#ifndef __BENSCOPE_PARSING_SOURCE_BUFFER_H__
+#define __BENSCOPE_PARSING_SOURCE_BUFFER_H__
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace benscope {
+
+// A read-only, contiguous view of an entire source text.  The bytes are either
+// memory-mapped from a file or read into a buffer owned by this object; either
+// way they stay put until the SourceBuffer is destroyed, so string_views into
+// view() may be held for the whole parse.
+class SourceBuffer {
+public:
+  // Maps the file at `path` into memory.  Falls back to reading it when the
+  // file can't be mapped (pipes, character devices, ...).  Returns null if the
+  // file can't be opened.
+  static std::unique_ptr<SourceBuffer> MapFile(const std::string &path);
+
+  // Reads `input` until EOF.
+  static std::unique_ptr<SourceBuffer> ReadStream(std::istream *input);
+
+  SourceBuffer(const SourceBuffer &) = delete;
+  SourceBuffer &operator=(const SourceBuffer &) = delete;
+  ~SourceBuffer();
+
+  std::string_view view() const { return view_; }
+
+private:
+  SourceBuffer() = default;
+
+  std::string owned_;
+  void *mapping_ = nullptr;
+  std::size_t mapping_size_ = 0;
+  std::string_view view_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_PARSING_SOURCE_BUFFER_H__
@@ -0,0 +1,117 @@
+#include "benscope/parsing/symbol.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace benscope {
+namespace {
+
+class SymbolTable {
+public:
+  static SymbolTable &Get() {
+    static SymbolTable *table = new SymbolTable();
+    return *table;
+  }
+
+  std::uint32_t Intern(std::string_view name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = ids_.find(name);
+    if (it != ids_.end())
+      return it->second;
+
+    std::uint32_t id = next_id_++;
+    if (id >= kChunkSize * kMaxChunks) {
+      std::cerr << "Too many distinct symbols.\n";
+      std::abort();
+    }
+    std::atomic<std::string_view *> &chunk = chunks_[id / kChunkSize];
+    if (chunk.load(std::memory_order_relaxed) == nullptr)
+      chunk.store(new std::string_view[kChunkSize], std::memory_order_release);
+
+    std::string_view stored = Store(name);
+    chunk.load(std::memory_order_relaxed)[id % kChunkSize] = stored;
+    ids_.emplace(stored, id);
+    return id;
+  }
+
+  // Lock-free.  Safe against concurrent interning because a thread can only
+  // hold an id that was published to it after its entry was written.
+  std::string_view Name(std::uint32_t id) const {
+    return chunks_[id / kChunkSize].load(std::memory_order_acquire)[id %
+                                                                    kChunkSize];
+  }
+
+private:
+  static constexpr std::uint32_t kChunkSize = 1 << 12;
+  static constexpr std::uint32_t kMaxChunks = 1 << 12;
+  static constexpr std::size_t kBlockSize = 1 << 16;
+
+  SymbolTable() { Intern(""); }
+
+  // Copies `name` into stable storage.
+  std::string_view Store(std::string_view name) {
+    // Nothing to copy, and no block to copy it to before the first name.
+    if (name.empty())
+      return std::string_view();
+    if (name.size() > kBlockSize / 4) {
+      blocks_.emplace_back(new char[name.size()]);
+      std::memcpy(blocks_.back().get(), name.data(), name.size());
+      return std::string_view(blocks_.back().get(), name.size());
+    }
+    if (block_remaining_ < name.size()) {
+      blocks_.emplace_back(new char[kBlockSize]);
+      block_next_ = blocks_.back().get();
+      block_remaining_ = kBlockSize;
+    }
+    std::memcpy(block_next_, name.data(), name.size());
+    std::string_view stored(block_next_, name.size());
+    block_next_ += name.size();
+    block_remaining_ -= name.size();
+    return stored;
+  }
+
+  std::mutex mutex_;
+  absl::flat_hash_map<std::string_view, std::uint32_t> ids_;
+  std::uint32_t next_id_ = 0;
+  std::atomic<std::string_view *> chunks_[kMaxChunks] = {};
+
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char *block_next_ = nullptr;
+  std::size_t block_remaining_ = 0;
+};
+
+} // namespace
+
+// static
+Symbol Symbol::Intern(std::string_view name) {
+  // Each thread remembers the names it has interned, keyed by the table's own
+  // stable copy, so repeated names skip the table's lock.  That keeps
+  // threads that lex in parallel from serializing on it.
+  static constexpr std::size_t kMaxCached = 1 << 16;
+  thread_local absl::flat_hash_map<std::string_view, std::uint32_t> cache;
+  auto it = cache.find(name);
+  if (it != cache.end())
+    return Symbol(it->second);
+
+  SymbolTable &table = SymbolTable::Get();
+  std::uint32_t id = table.Intern(name);
+  if (cache.size() >= kMaxCached)
+    cache.clear();
+  cache.emplace(table.Name(id), id);
+  return Symbol(id);
+}
+
+std::string_view Symbol::name() const { return SymbolTable::Get().Name(id_); }
+
+std::ostream &operator<<(std::ostream &out, Symbol symbol) {
+  return out << symbol.name();
+}
+
+} // namespace benscope
@@ -0,0 +1,46 @@
+// Interned names.
+
+#ifndef __BENSCOPE_PARSING_SYMBOL_H__
+#define __BENSCOPE_PARSING_SYMBOL_H__
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <utility>
+
+namespace benscope {
+
+// A name, interned in a process-wide table so that it can be copied, compared
+// and hashed as a 32-bit integer.  Interned text is never freed: name() views
+// stay valid for the life of the process.  Interning is thread-safe.
+class Symbol {
+public:
+  // The empty name.
+  constexpr Symbol() = default;
+
+  static Symbol Intern(std::string_view name);
+
+  std::uint32_t id() const { return id_; }
+  std::string_view name() const;
+  bool empty() const { return id_ == 0; }
+
+  friend bool operator==(Symbol a, Symbol b) { return a.id_ == b.id_; }
+  friend bool operator!=(Symbol a, Symbol b) { return a.id_ != b.id_; }
+  // Orders by interning time, not alphabetically.
+  friend bool operator<(Symbol a, Symbol b) { return a.id_ < b.id_; }
+
+  template <typename H> friend H AbslHashValue(H h, Symbol s) {
+    return H::combine(std::move(h), s.id_);
+  }
+
+private:
+  explicit constexpr Symbol(std::uint32_t id) : id_(id) {}
+
+  std::uint32_t id_ = 0;
+};
+
+std::ostream &operator<<(std::ostream &out, Symbol symbol);
+
+} // namespace benscope
+
+#endif // __BENSCOPE_PARSING_SYMBOL_H__
@@ -0,0 +1,62 @@
+#include "benscope/parsing/symbol.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+
+TEST(SymbolTest, InternIsIdempotent) {
+  Symbol a = Symbol::Intern("alpha");
+  Symbol b = Symbol::Intern(std::string("alp") + "ha");
+  EXPECT_THAT(a, Eq(b));
+  EXPECT_THAT(a.id(), Eq(b.id()));
+  EXPECT_THAT(a, Ne(Symbol::Intern("beta")));
+  EXPECT_THAT(a.name(), Eq("alpha"));
+}
+
+TEST(SymbolTest, EmptySymbol) {
+  EXPECT_TRUE(Symbol().empty());
+  EXPECT_THAT(Symbol::Intern(""), Eq(Symbol()));
+  EXPECT_THAT(Symbol().name(), Eq(""));
+}
+
+TEST(SymbolTest, NamesOutliveTheirSource) {
+  Symbol s;
+  {
+    std::string temporary = "short-lived";
+    s = Symbol::Intern(temporary);
+  }
+  EXPECT_THAT(s.name(), Eq("short-lived"));
+  EXPECT_THAT(Symbol::Intern(std::string(5000, 'z')).name().size(), Eq(5000));
+}
+
+TEST(SymbolTest, ConcurrentInterning) {
+  constexpr int kThreads = 8, kNames = 5000;
+  std::vector<std::vector<Symbol>> seen(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([t, &seen] {
+      for (int i = 0; i < kNames; ++i)
+        seen[t].push_back(Symbol::Intern("name" + std::to_string(i)));
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  for (int i = 0; i < kNames; ++i) {
+    for (int t = 1; t < kThreads; ++t)
+      ASSERT_THAT(seen[t][i], Eq(seen[0][i]));
+    ASSERT_THAT(seen[0][i].name(), Eq("name" + std::to_string(i)));
+  }
+}
+
+} // namespace
+} // namespace benscope
@@ -0,0 +1,78 @@
+#include "benscope/transforms/call_graph.h"
+
+#include <algorithm>
+
+#include "absl/container/flat_hash_set.h"
+
+namespace benscope {
+
+void CallGraph::Define(const FlatAst &form) {
+  const FlatAst::Node &root = form[form.root()];
+  if (root.kind != AstKind::kFunction) {
+    functions_[root.name] = Function();
+    return;
+  }
+
+  Function &function = functions_[form[root.operands[0]].name];
+  function.defined = true;
+  function.callees.clear();
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    if (form[i].kind == AstKind::kCall)
+      function.callees.push_back(form[i].name);
+  }
+  std::sort(function.callees.begin(), function.callees.end());
+  function.callees.erase(
+      std::unique(function.callees.begin(), function.callees.end()),
+      function.callees.end());
+}
+
+template <typename Visit>
+bool CallGraph::Reach(Symbol from, Visit visit) const {
+  absl::flat_hash_set<Symbol> seen;
+  std::vector<Symbol> stack;
+  auto push_callees = [&](Symbol name) {
+    if (const std::vector<Symbol> *callees = Callees(name)) {
+      for (Symbol callee : *callees) {
+        if (seen.insert(callee).second)
+          stack.push_back(callee);
+      }
+    }
+  };
+
+  push_callees(from);
+  while (!stack.empty()) {
+    Symbol name = stack.back();
+    stack.pop_back();
+    if (!visit(name))
+      return false;
+    push_callees(name);
+  }
+  return true;
+}
+
+bool CallGraph::IsPure(Symbol name) const {
+  return Callees(name) != nullptr &&
+         Reach(name, [this](Symbol f) { return Callees(f) != nullptr; });
+}
+
+bool CallGraph::IsRecursive(Symbol name) const {
+  return !Reach(name, [name](Symbol f) { return f != name; });
+}
+
+std::vector<Symbol> CallGraph::Dependents(Symbol name) const {
+  std::vector<Symbol> dependents;
+  for (const auto &[caller, function] : functions_) {
+    if (function.defined && caller != name &&
+        !Reach(caller, [name](Symbol f) { return f != name; }))
+      dependents.push_back(caller);
+  }
+  return dependents;
+}
+
+const std::vector<Symbol> *CallGraph::Callees(Symbol name) const {
+  auto it = functions_.find(name);
+  return it != functions_.end() && it->second.defined ? &it->second.callees
+                                                       : nullptr;
+}
+
+} // namespace benscope
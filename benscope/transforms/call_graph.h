@@ -0,0 +1,55 @@
+// Which functions call which, and what follows from that.
+
+#ifndef __BENSCOPE_TRANSFORMS_CALL_GRAPH_H__
+#define __BENSCOPE_TRANSFORMS_CALL_GRAPH_H__
+
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/symbol.h"
+
+namespace benscope {
+
+// The functions defined and declared so far, with the functions each body
+// calls.  A defined function computes a double from doubles and nothing
+// else; only externs, whose bodies are unknown, can have side effects.  So a
+// function is pure exactly when everything it can reach is defined.
+class CallGraph {
+public:
+  // Records the function a def form defines, replacing any earlier
+  // definition, or the function an extern declares.
+  void Define(const FlatAst &form);
+
+  // Whether `name` and every function it can call are defined, so that its
+  // result depends on nothing but its arguments.
+  bool IsPure(Symbol name) const;
+
+  // Whether `name` can call itself, directly or through other functions.
+  bool IsRecursive(Symbol name) const;
+
+  // The functions the body of `name` calls directly, each once, or null if
+  // `name` is not defined.
+  const std::vector<Symbol> *Callees(Symbol name) const;
+
+  // The defined functions other than `name` that can call it, directly or
+  // through other functions, in no particular order.  These are the ones to
+  // recompile when `name` is redefined.
+  std::vector<Symbol> Dependents(Symbol name) const;
+
+private:
+  struct Function {
+    bool defined = false;
+    std::vector<Symbol> callees;
+  };
+
+  // Calls `visit(name)` on each function reachable from the callees of
+  // `from`, once each, until it returns false.  Returns false if it did.
+  template <typename Visit> bool Reach(Symbol from, Visit visit) const;
+
+  absl::flat_hash_map<Symbol, Function> functions_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_TRANSFORMS_CALL_GRAPH_H__
@@ -0,0 +1,88 @@
+#include "benscope/transforms/call_graph.h"
+
+#include <memory>
+#include <string>
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/parsing/symbol.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::IsEmpty;
+using ::testing::IsNull;
+using ::testing::Pointee;
+using ::testing::UnorderedElementsAre;
+
+CallGraph Build(const std::string &source) {
+  Parser parser(std::make_unique<Lexer>(source));
+  CallGraph graph;
+  FlatAst form;
+  while (parser.ParseNext(&form))
+    graph.Define(form);
+  return graph;
+}
+
+Symbol S(const char *name) { return Symbol::Intern(name); }
+
+TEST(CallGraphTest, RecordsCallees) {
+  CallGraph graph = Build("(def f (x) (+ (g x) (h (g x))))");
+  EXPECT_THAT(graph.Callees(S("f")),
+              Pointee(UnorderedElementsAre(S("g"), S("h"))));
+  EXPECT_THAT(graph.Callees(S("g")), IsNull());
+}
+
+TEST(CallGraphTest, PureWhenEverythingReachableIsDefined) {
+  CallGraph graph = Build("(extern sin (x))"
+                          "(def a (x) (+ x 1))"
+                          "(def b (x) (a (b x)))"
+                          "(def c (x) (sin x))"
+                          "(def d (x) (b (c x)))"
+                          "(def e (x) (undefined x))");
+  EXPECT_TRUE(graph.IsPure(S("a")));
+  EXPECT_TRUE(graph.IsPure(S("b")));
+  EXPECT_FALSE(graph.IsPure(S("sin")));
+  EXPECT_FALSE(graph.IsPure(S("c")));
+  EXPECT_FALSE(graph.IsPure(S("d")));
+  EXPECT_FALSE(graph.IsPure(S("e")));
+}
+
+TEST(CallGraphTest, FindsRecursion) {
+  CallGraph graph = Build("(def fib (n) (if (< n 2) n (+ (fib (- n 1)) "
+                          "(fib (- n 2)))))"
+                          "(def even (n) (if n (odd (- n 1)) 1))"
+                          "(def odd (n) (if n (even (- n 1)) 0))"
+                          "(def twice (n) (+ (fib n) (fib n)))");
+  EXPECT_TRUE(graph.IsRecursive(S("fib")));
+  EXPECT_TRUE(graph.IsRecursive(S("even")));
+  EXPECT_TRUE(graph.IsRecursive(S("odd")));
+  EXPECT_FALSE(graph.IsRecursive(S("twice")));
+}
+
+TEST(CallGraphTest, RedefinitionReplacesCallees) {
+  CallGraph graph = Build("(def f (x) (f x)) (def f (x) x)");
+  EXPECT_FALSE(graph.IsRecursive(S("f")));
+  graph = Build("(def f (x) x) (extern f (x))");
+  EXPECT_FALSE(graph.IsPure(S("f")));
+}
+
+TEST(CallGraphTest, FindsDependents) {
+  CallGraph graph = Build("(def g (x) (+ x 1))"
+                          "(def f (x) (g x))"
+                          "(def e (x) (f (f x)))"
+                          "(def h (x) (* x 2))"
+                          "(def r (x) (r (g x)))");
+  EXPECT_THAT(graph.Dependents(S("g")),
+              UnorderedElementsAre(S("f"), S("e"), S("r")));
+  EXPECT_THAT(graph.Dependents(S("e")), IsEmpty());
+  // A function is not its own dependent, even when recursive.
+  EXPECT_THAT(graph.Dependents(S("r")), IsEmpty());
+}
+
+} // namespace
+} // namespace benscope
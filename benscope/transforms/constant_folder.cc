@@ -0,0 +1,187 @@
+#include "benscope/transforms/constant_folder.h"
+
+#include <cmath>
+#include <utility>
+
+namespace benscope {
+namespace {
+
+bool IsCommutative(char op) { return op == '+' || op == '*'; }
+
+// Evaluates a binary operator as the LLVM backend's code would.  Returns false
+// for operators with no fixed meaning.
+bool Evaluate(char op, double lhs, double rhs, double *result) {
+  switch (op) {
+  case '+':
+    *result = lhs + rhs;
+    return true;
+  case '-':
+    *result = lhs - rhs;
+    return true;
+  case '*':
+    *result = lhs * rhs;
+    return true;
+  case '/':
+    *result = lhs / rhs;
+    return true;
+  case '<':
+    // An unordered comparison, as with fcmp ult.
+    *result = !(lhs >= rhs) ? 1.0 : 0.0;
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+FlatAst::Index ConstantFolder::Emit(const Value &value) {
+  switch (value.kind) {
+  case Value::kConstant:
+    return out_.AddNumber(value.constant);
+  case Value::kNode:
+    return value.index;
+  case Value::kChain:
+    if ((value.op == '*' && value.constant == 1.0) ||
+        (value.op == '+' && value.constant == 0.0 &&
+         std::signbit(value.constant)))
+      return value.index;
+    return out_.AddBinary(value.op, value.index,
+                          out_.AddNumber(value.constant));
+  }
+  return FlatAst::kNone;
+}
+
+bool ConstantFolder::ShouldSwap(const Value &a, const Value &b) const {
+  // Either operand may be evaluated first only if neither can have side
+  // effects that the other could observe; variables and constants have
+  // none.
+  auto leaf = [&](const Value &v) {
+    return out_[v.index].kind == AstKind::kVariable;
+  };
+  if (!(a.pure && b.pure) && !leaf(a) && !leaf(b))
+    return false;
+  auto rank = [&](const Value &v) {
+    const FlatAst::Node &node = out_[v.index];
+    return node.kind == AstKind::kVariable ? 1 + std::uint64_t{node.name.id()}
+                                           : 0;
+  };
+  return rank(a) > rank(b);
+}
+
+ConstantFolder::Value ConstantFolder::Binary(char op, Value lhs, Value rhs) {
+  double folded;
+  if (lhs.kind == Value::kConstant && rhs.kind == Value::kConstant &&
+      Evaluate(op, lhs.constant, rhs.constant, &folded))
+    return {Value::kConstant, 0, true, FlatAst::kNone, folded};
+
+  // x - c is exactly x + -c, which can join a chain.
+  if (op == '-' && rhs.kind == Value::kConstant) {
+    op = '+';
+    rhs.constant = -rhs.constant;
+  }
+
+  if (!IsCommutative(op)) {
+    FlatAst::Index l = Emit(lhs);
+    FlatAst::Index r = Emit(rhs);
+    return {Value::kNode, 0, lhs.pure && rhs.pure, out_.AddBinary(op, l, r)};
+  }
+
+  // Split each side into the part still to be computed and its constant.
+  struct Part {
+    bool has_base = false, has_constant = false;
+    Value base;
+    double constant = 0;
+  };
+  auto split = [&](const Value &v) {
+    Part part;
+    if (v.kind == Value::kConstant) {
+      part.has_constant = true;
+      part.constant = v.constant;
+    } else if (v.kind == Value::kChain && v.op == op) {
+      part.has_base = part.has_constant = true;
+      part.base = {Value::kNode, 0, v.pure, v.index};
+      part.constant = v.constant;
+    } else {
+      part.has_base = true;
+      part.base = {Value::kNode, 0, v.pure, Emit(v)};
+    }
+    return part;
+  };
+  Part l = split(lhs), r = split(rhs);
+
+  Value base;
+  if (l.has_base && r.has_base) {
+    if (ShouldSwap(l.base, r.base))
+      std::swap(l.base, r.base);
+    base = {Value::kNode, 0, l.base.pure && r.base.pure,
+            out_.AddBinary(op, l.base.index, r.base.index)};
+  } else {
+    base = l.has_base ? l.base : r.base;
+  }
+
+  if (!l.has_constant && !r.has_constant)
+    return base;
+  double constant = !l.has_constant   ? r.constant
+                    : !r.has_constant ? l.constant
+                                      : (Evaluate(op, l.constant, r.constant,
+                                                  &folded),
+                                         folded);
+  return {Value::kChain, op, base.pure, base.index, constant};
+}
+
+void ConstantFolder::Run(FlatAst *form) {
+  const FlatAst &in = *form;
+  out_.Clear();
+  values_.clear();
+  values_.reserve(in.size());
+
+  for (FlatAst::Index i = 0; i < in.size(); ++i) {
+    const FlatAst::Node &node = in[i];
+    Value value = {Value::kNode};
+    switch (node.kind) {
+    case AstKind::kNumber:
+      value = {Value::kConstant, 0, true, FlatAst::kNone, node.value};
+      break;
+    case AstKind::kVariable:
+      value.index = out_.AddVariable(node.name);
+      break;
+    case AstKind::kBinary:
+      value = Binary(node.op, values_[node.operands[0]],
+                     values_[node.operands[1]]);
+      break;
+    case AstKind::kCall:
+      args_.clear();
+      for (FlatAst::Index arg : in.args(node))
+        args_.push_back(Emit(values_[arg]));
+      value.pure = false;
+      value.index = out_.AddCall(node.name, args_.data(), args_.size());
+      break;
+    case AstKind::kIf: {
+      const Value &test = values_[node.operands[0]];
+      const Value &if_true = values_[node.operands[1]];
+      const Value &if_false = values_[node.operands[2]];
+      value.pure = test.pure && if_true.pure && if_false.pure;
+      FlatAst::Index t = Emit(test);
+      FlatAst::Index a = Emit(if_true);
+      value.index = out_.AddIf(t, a, Emit(if_false));
+      break;
+    }
+    case AstKind::kPrototype: {
+      FlatAst::Range<Symbol> params = in.params(node);
+      value.index = out_.AddPrototype(node.name, params.begin(), params.size());
+      break;
+    }
+    case AstKind::kFunction: {
+      FlatAst::Index proto = values_[node.operands[0]].index;
+      value.index = out_.AddFunction(proto, Emit(values_[node.operands[1]]));
+      break;
+    }
+    }
+    values_.push_back(value);
+  }
+  out_.set_root(Emit(values_[in.root()]));
+  std::swap(*form, out_);
+}
+
+} // namespace benscope
@@ -0,0 +1,74 @@
+// Backend-independent constant folding and reassociation over FlatAst forms.
+
+#ifndef __BENSCOPE_TRANSFORMS_CONSTANT_FOLDER_H__
+#define __BENSCOPE_TRANSFORMS_CONSTANT_FOLDER_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "benscope/parsing/flat_ast.h"
+
+namespace benscope {
+
+// Rewrites a form before code generation so that neither backend spends code
+// on arithmetic that is known at compile time:
+//
+//   - Binary operators over two constants are evaluated, with the semantics
+//     of the LLVM backend ('<' is true when either side is NaN).
+//   - Chains of '+' or '*' gather their constants into one operand at the
+//     end, so (+ (+ x 1) 2) becomes (+ x 3) and (* 2 (* x 3)) becomes
+//     (* x 6).  (- x c) joins '+' chains as (+ x -c), which is exact.
+//   - Commutative operands are put in a canonical order, compound
+//     expressions before variables before constants, when that cannot
+//     reorder calls.
+//   - x * 1 and x + -0 become x.
+//
+// Reassociation is done as under -ffast-math: the folded constant is exact,
+// but x + 1 + 2 and x + 3 may round differently.  `if` is left as it is, even
+// with a constant test, because the backends do not yet agree on which
+// values are true.
+//
+// The pass visits nodes in index order, without recursion, and emits each
+// node at most once, so a folded form has no unreachable nodes.
+class ConstantFolder {
+public:
+  // Rewrites `form` in place.  The folder keeps its buffers for the next
+  // form.
+  void Run(FlatAst *form);
+
+private:
+  // What a node of the input folds to.
+  struct Value {
+    enum Kind : std::uint8_t {
+      // Just `constant`, not yet emitted.
+      kConstant,
+      // The emitted node `index`.
+      kNode,
+      // (op index constant), with the constant not yet emitted so that more
+      // can be folded into it.
+      kChain,
+    };
+    Kind kind;
+    // kChain: '+' or '*'.
+    char op = 0;
+    // Whether evaluating the node cannot call anything.
+    bool pure = true;
+    FlatAst::Index index = FlatAst::kNone;
+    double constant = 0;
+  };
+
+  // Emits whatever is still pending in `value` and returns its node.
+  FlatAst::Index Emit(const Value &value);
+  Value Binary(char op, Value lhs, Value rhs);
+  // Whether `a` and `b` should trade places as operands of a commutative
+  // operator.
+  bool ShouldSwap(const Value &a, const Value &b) const;
+
+  FlatAst out_;
+  std::vector<Value> values_;
+  std::vector<FlatAst::Index> args_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_TRANSFORMS_CONSTANT_FOLDER_H__
@@ -0,0 +1,91 @@
+#include "benscope/transforms/constant_folder.h"
+
+#include <memory>
+#include <string>
+
+#include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/parsing/printer.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::Eq;
+
+// Folds the single form in `source` and prints its body.
+std::string Fold(const std::string &source) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  if (!parser.ParseNext(&form))
+    return "<parse error>";
+  ConstantFolder folder;
+  folder.Run(&form);
+
+  const FlatAst::Node &root = form[form.root()];
+  PrintingVisitor v;
+  v.Dispatch(*form.Inflate(root.kind == AstKind::kFunction ? root.operands[1]
+                                                           : form.root()));
+  return v.ToString();
+}
+
+TEST(ConstantFolderTest, FoldsConstants) {
+  EXPECT_THAT(Fold("(def f () (* (+ 1 2) (- 10 4)))"), Eq("[18]"));
+  EXPECT_THAT(Fold("(def f () (/ 1 4))"), Eq("[0.25]"));
+  EXPECT_THAT(Fold("(def f () (< 1 2))"), Eq("[1]"));
+  EXPECT_THAT(Fold("(def f () (< 2 1))"), Eq("[0]"));
+}
+
+TEST(ConstantFolderTest, GathersConstantsInChains) {
+  EXPECT_THAT(Fold("(def f (x) (+ (+ x 1) 2))"), Eq("[{x} + [3]]"));
+  EXPECT_THAT(Fold("(def f (x) (+ 1 (+ 2 x)))"), Eq("[{x} + [3]]"));
+  EXPECT_THAT(Fold("(def f (x) (* 2 (* x 3)))"), Eq("[{x} * [6]]"));
+  EXPECT_THAT(Fold("(def f (x) (- (+ x 5) 2))"), Eq("[{x} + [3]]"));
+  EXPECT_THAT(Fold("(def f (x y) (+ (+ x 1) (+ y 2)))"),
+              Eq("[[{x} + {y}] + [3]]"));
+}
+
+TEST(ConstantFolderTest, DropsIdentities) {
+  EXPECT_THAT(Fold("(def f (x) (* (* x 2) 0.5))"), Eq("{x}"));
+  EXPECT_THAT(Fold("(def f (x) (- x 0))"), Eq("{x}"));
+  // x + 0 is not x when x is -0.
+  EXPECT_THAT(Fold("(def f (x) (+ x 0))"), Eq("[{x} + [0]]"));
+  EXPECT_THAT(Fold("(def f (x) (- (+ x 1) 1))"), Eq("[{x} + [0]]"));
+}
+
+TEST(ConstantFolderTest, CanonicalizesCommutativeOperands) {
+  EXPECT_THAT(Fold("(def f (x) (* (+ x (+ 1 2)) (+ (+ 2 1) x)))"),
+              Eq("[[{x} + [3]] * [{x} + [3]]]"));
+  EXPECT_THAT(Fold("(def f (x) (+ 1 x))"), Eq("[{x} + [1]]"));
+  EXPECT_THAT(Fold("(def f (x) (+ x (* x 2)))"), Eq("[[{x} * [2]] + {x}]"));
+  EXPECT_THAT(Fold("(def f (x) (- 1 x))"), Eq("[[1] - {x}]"));
+}
+
+TEST(ConstantFolderTest, KeepsCallOrder) {
+  EXPECT_THAT(Fold("(def f (x) (+ (g x) (+ (h x) 1)))"),
+              Eq("[[[CALL g {x}] + [CALL h {x}]] + [1]]"));
+  EXPECT_THAT(Fold("(def f (x) (+ (g (+ x 1)) (* 2 3)))"),
+              Eq("[[CALL g [{x} + [1]]] + [6]]"));
+}
+
+TEST(ConstantFolderTest, LeavesIfAlone) {
+  EXPECT_THAT(Fold("(def f (x) (if (< 1 2) (+ x 0.5 ) (+ 1 1)))"),
+              Eq("[IF [1] THEN [{x} + [0.5]] ELSE [2]]"));
+}
+
+TEST(ConstantFolderTest, EmitsOnlyReachableNodes) {
+  Parser parser(std::make_unique<Lexer>("(def f (x) (+ (+ (+ x 1) 2) 3))"));
+  FlatAst form;
+  ASSERT_TRUE(parser.ParseNext(&form));
+  ConstantFolder folder;
+  folder.Run(&form);
+  // x, 6, x + 6, the prototype and the function.
+  EXPECT_THAT(form.size(), Eq(5));
+}
+
+} // namespace
+} // namespace benscope
@@ -0,0 +1,96 @@
+#include "benscope/transforms/hash_conser.h"
+
+#include <cstring>
+
+namespace benscope {
+
+FlatAst::Index HashConser::Intern(const Key &key, const FlatAst::Node &node,
+                                  const FlatAst &in) {
+  auto [it, inserted] = nodes_.try_emplace(key, FlatAst::kNone);
+  if (!inserted)
+    return it->second;
+
+  FlatAst::Index index = FlatAst::kNone;
+  switch (node.kind) {
+  case AstKind::kNumber:
+    index = out_.AddNumber(node.value);
+    break;
+  case AstKind::kVariable:
+    index = out_.AddVariable(node.name);
+    break;
+  case AstKind::kBinary:
+    index = out_.AddBinary(node.op, merged_[node.operands[0]],
+                           merged_[node.operands[1]]);
+    break;
+  case AstKind::kCall:
+    index = out_.AddCall(node.name, args_.data(), args_.size());
+    break;
+  case AstKind::kIf:
+    index = out_.AddIf(merged_[node.operands[0]], merged_[node.operands[1]],
+                       merged_[node.operands[2]]);
+    break;
+  case AstKind::kPrototype: {
+    FlatAst::Range<Symbol> params = in.params(node);
+    index = out_.AddPrototype(node.name, params.begin(), params.size());
+    break;
+  }
+  case AstKind::kFunction:
+    index = out_.AddFunction(merged_[node.operands[0]],
+                             merged_[node.operands[1]]);
+    break;
+  }
+  it->second = index;
+  return index;
+}
+
+void HashConser::Run(FlatAst *form) {
+  const FlatAst &in = *form;
+  out_.Clear();
+  merged_.clear();
+  merged_.reserve(in.size());
+  nodes_.clear();
+  arg_lists_.clear();
+
+  for (FlatAst::Index i = 0; i < in.size(); ++i) {
+    const FlatAst::Node &node = in[i];
+    Key key{node.kind, node.op, node.name.id(), 0, 0, 0};
+    auto &[kind, op, name, a, b, c] = key;
+    switch (node.kind) {
+    case AstKind::kNumber:
+      // By bits, so that 0 and -0 stay apart.
+      name = 0;
+      std::memcpy(&a, &node.value, sizeof(double));
+      break;
+    case AstKind::kVariable:
+      break;
+    case AstKind::kBinary:
+    case AstKind::kFunction:
+      a = merged_[node.operands[0]];
+      b = merged_[node.operands[1]];
+      break;
+    case AstKind::kIf:
+      a = merged_[node.operands[0]];
+      b = merged_[node.operands[1]];
+      c = merged_[node.operands[2]];
+      break;
+    case AstKind::kCall:
+      args_.clear();
+      for (FlatAst::Index arg : in.args(node)) {
+        args_.push_back(merged_[arg]);
+        a = arg_lists_.try_emplace({a, merged_[arg]}, arg_lists_.size() + 1)
+                .first->second;
+      }
+      b = args_.size();
+      break;
+    case AstKind::kPrototype:
+      // Never shared; there is one per form.
+      a = i;
+      break;
+    }
+    merged_.push_back(Intern(key, node, in));
+  }
+  out_.set_root(merged_[in.root()]);
+  std::swap(*form, out_);
+}
+
+} // namespace benscope
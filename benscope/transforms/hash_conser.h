@@ -0,0 +1,57 @@
+// Merges structurally equal subexpressions of a form into a DAG.
+
+#ifndef __BENSCOPE_TRANSFORMS_HASH_CONSER_H__
+#define __BENSCOPE_TRANSFORMS_HASH_CONSER_H__
+
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+
+namespace benscope {
+
+// Rebuilds a form so that each distinct expression is a single node, shared
+// by every parent that uses it.  Two nodes are the same when they have the
+// same kind, operator, name or value bits, and the same (already merged)
+// operands, so equality is decided with one hash lookup per node.
+//
+// Calls are merged too: functions in the language have no side effects, so
+// (f x) has one value wherever it appears in a body.  Backends use
+// FlatAst::CountUses() to find the shared nodes and keep their values for
+// reuse, as long as the first evaluation dominates the later uses; a value
+// computed in one branch of an `if` is computed again outside it.
+//
+// Best run after ConstantFolder, whose canonical operand order lets
+// (+ a b) and (+ b a) merge.
+class HashConser {
+public:
+  // Rewrites `form` in place.  The conser keeps its tables for the next form.
+  void Run(FlatAst *form);
+
+private:
+  // Kind, operator, name, and up to three operands or a value's bits.
+  using Key = std::tuple<AstKind, char, std::uint32_t, std::uint64_t,
+                         std::uint64_t, std::uint64_t>;
+
+  FlatAst::Index Intern(const Key &key, const FlatAst::Node &node,
+                        const FlatAst &in);
+
+  FlatAst out_;
+  // The merged node of each input node.
+  std::vector<FlatAst::Index> merged_;
+  absl::flat_hash_map<Key, FlatAst::Index> nodes_;
+  // Argument lists, interned one argument at a time: (list, arg) -> list.
+  // The empty list is 0.
+  absl::flat_hash_map<std::pair<std::uint64_t, FlatAst::Index>,
+                      std::uint64_t>
+      arg_lists_;
+  std::vector<FlatAst::Index> args_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_TRANSFORMS_HASH_CONSER_H__
@@ -0,0 +1,82 @@
+#include "benscope/transforms/hash_conser.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/parsing/printer.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+
+FlatAst Merge(const std::string &source) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  EXPECT_TRUE(parser.ParseNext(&form));
+  HashConser conser;
+  conser.Run(&form);
+  return form;
+}
+
+const FlatAst::Node &Body(const FlatAst &form) {
+  return form[form[form.root()].operands[1]];
+}
+
+TEST(HashConserTest, SharesEqualSubexpressions) {
+  FlatAst form = Merge("(def f (x) (* (+ x 1) (+ x 1)))");
+  const FlatAst::Node &body = Body(form);
+  EXPECT_THAT(body.operands[0], Eq(body.operands[1]));
+  // x, 1, x + 1, the product, the prototype and the function.
+  EXPECT_THAT(form.size(), Eq(6));
+
+  std::vector<std::uint32_t> uses;
+  form.CountUses(&uses);
+  EXPECT_THAT(uses[body.operands[0]], Eq(2));
+}
+
+TEST(HashConserTest, SharesCallsWithEqualArguments) {
+  FlatAst form = Merge("(def f (x y) (+ (g x (h y)) (g x (h y))))");
+  const FlatAst::Node &body = Body(form);
+  EXPECT_THAT(body.operands[0], Eq(body.operands[1]));
+
+  form = Merge("(def f (x y) (+ (g x y) (g y x)))");
+  EXPECT_THAT(Body(form).operands[0], Ne(Body(form).operands[1]));
+  form = Merge("(def f (x) (+ (g x) (h x)))");
+  EXPECT_THAT(Body(form).operands[0], Ne(Body(form).operands[1]));
+  form = Merge("(def f (x) (+ (g x) (g x x)))");
+  EXPECT_THAT(Body(form).operands[0], Ne(Body(form).operands[1]));
+}
+
+TEST(HashConserTest, KeepsDistinctExpressionsApart) {
+  FlatAst form = Merge("(def f (x) (+ (- x 1) (- 1 x)))");
+  EXPECT_THAT(Body(form).operands[0], Ne(Body(form).operands[1]));
+  form = Merge("(def f (x) (+ (* x 2) (+ x 2)))");
+  EXPECT_THAT(Body(form).operands[0], Ne(Body(form).operands[1]));
+}
+
+TEST(HashConserTest, PrintsTheSameTree) {
+  const std::string source =
+      "(def f (x) (if (< x 1) (+ (g x) (g x)) (* (g x) (+ x 1))))";
+  FlatAst form = Merge(source);
+  PrintingVisitor merged;
+  merged.Dispatch(*form.Inflate());
+
+  Parser parser(std::make_unique<Lexer>(source));
+  PrintingVisitor original;
+  original.Dispatch(*parser.ParseNext());
+  EXPECT_THAT(merged.ToString(), Eq(original.ToString()));
+}
+
+} // namespace
+} // namespace benscope
@@ -0,0 +1,136 @@
+#include "benscope/transforms/inliner.h"
+
+#include <utility>
+
+namespace benscope {
+namespace {
+
+// Appends a copy of `node` of `src` to `dst`, with its operands replaced by
+// their copies in `map`.  `args` is scratch space.
+FlatAst::Index CopyNode(const FlatAst &src, const FlatAst::Node &node,
+                        const std::vector<FlatAst::Index> &map,
+                        std::vector<FlatAst::Index> *args, FlatAst *dst) {
+  switch (node.kind) {
+  case AstKind::kNumber:
+    return dst->AddNumber(node.value);
+  case AstKind::kVariable:
+    return dst->AddVariable(node.name);
+  case AstKind::kBinary:
+    return dst->AddBinary(node.op, map[node.operands[0]],
+                          map[node.operands[1]]);
+  case AstKind::kCall:
+    args->clear();
+    for (FlatAst::Index arg : src.args(node))
+      args->push_back(map[arg]);
+    return dst->AddCall(node.name, args->data(), args->size());
+  case AstKind::kIf:
+    return dst->AddIf(map[node.operands[0]], map[node.operands[1]],
+                      map[node.operands[2]]);
+  case AstKind::kPrototype: {
+    FlatAst::Range<Symbol> params = src.params(node);
+    return dst->AddPrototype(node.name, params.begin(), params.size());
+  }
+  case AstKind::kFunction:
+    return dst->AddFunction(map[node.operands[0]], map[node.operands[1]]);
+  }
+  return FlatAst::kNone;
+}
+
+} // namespace
+
+void Inliner::Define(const FlatAst &form) {
+  const FlatAst::Node &root = form[form.root()];
+  if (root.kind != AstKind::kFunction) {
+    functions_.erase(root.name);
+    return;
+  }
+  const FlatAst::Node &proto = form[root.operands[0]];
+  FlatAst::Range<Symbol> params = form.params(proto);
+  functions_.erase(proto.name);
+
+  std::size_t size = 0;
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    const FlatAst::Node &node = form[i];
+    switch (node.kind) {
+    case AstKind::kPrototype:
+    case AstKind::kFunction:
+      continue;
+    case AstKind::kCall:
+      if (node.name == proto.name)
+        return;
+      break;
+    case AstKind::kVariable: {
+      bool is_param = false;
+      for (Symbol param : params)
+        is_param |= param == node.name;
+      if (!is_param)
+        return;
+      break;
+    }
+    default:
+      break;
+    }
+    if (++size > budget_)
+      return;
+  }
+
+  Function &function = functions_[proto.name];
+  function.params.assign(params.begin(), params.end());
+  function.body.Clear();
+  map_.assign(form.size(), FlatAst::kNone);
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    const FlatAst::Node &node = form[i];
+    if (node.kind != AstKind::kPrototype && node.kind != AstKind::kFunction)
+      map_[i] = CopyNode(form, node, map_, &scratch_, &function.body);
+  }
+  function.body.set_root(map_[root.operands[1]]);
+}
+
+int Inliner::Run(FlatAst *form) {
+  const FlatAst &in = *form;
+  const FlatAst::Node &root = in[in.root()];
+  // A form must not inline an older version of its own function.
+  Symbol self;
+  if (root.kind == AstKind::kFunction)
+    self = in[root.operands[0]].name;
+
+  out_.Clear();
+  map_.assign(in.size(), FlatAst::kNone);
+  int inlined = 0;
+  for (FlatAst::Index i = 0; i < in.size(); ++i) {
+    const FlatAst::Node &node = in[i];
+    auto callee = node.kind == AstKind::kCall && node.name != self
+                      ? functions_.find(node.name)
+                      : functions_.end();
+    if (callee == functions_.end() ||
+        callee->second.params.size() != in.args(node).size()) {
+      map_[i] = CopyNode(in, node, map_, &scratch_, &out_);
+      continue;
+    }
+
+    const Function &function = callee->second;
+    call_args_.clear();
+    for (FlatAst::Index arg : in.args(node))
+      call_args_.push_back(map_[arg]);
+    const FlatAst &body = function.body;
+    body_map_.assign(body.size(), FlatAst::kNone);
+    for (FlatAst::Index j = 0; j < body.size(); ++j) {
+      const FlatAst::Node &body_node = body[j];
+      if (body_node.kind != AstKind::kVariable) {
+        body_map_[j] = CopyNode(body, body_node, body_map_, &scratch_, &out_);
+        continue;
+      }
+      for (std::size_t p = 0; p < function.params.size(); ++p) {
+        if (function.params[p] == body_node.name)
+          body_map_[j] = call_args_[p];
+      }
+    }
+    map_[i] = body_map_[body.root()];
+    ++inlined;
+  }
+  out_.set_root(map_[in.root()]);
+  std::swap(*form, out_);
+  return inlined;
+}
+
+} // namespace benscope
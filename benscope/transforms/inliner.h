@@ -0,0 +1,69 @@
+// Inlines small functions defined by earlier forms into later ones.
+
+#ifndef __BENSCOPE_TRANSFORMS_INLINER_H__
+#define __BENSCOPE_TRANSFORMS_INLINER_H__
+
+#include <cstddef>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/symbol.h"
+
+namespace benscope {
+
+// Keeps the bodies of the small functions seen so far and substitutes them
+// for calls in later forms, so that a helper like (def sq (x) (* x x)) costs
+// neither backend a call.  Each top-level form is still compiled on its own;
+// this is what lets a caller see into its callees.
+//
+// A call is replaced when the callee's body has at most `budget` expression
+// nodes, takes the same number of arguments, and refers only to its
+// parameters.  Each argument's expression is shared by every use of the
+// parameter, making a DAG, and is not evaluated at all if the parameter is
+// unused; both are safe because functions have no side effects.
+//
+// Recursion is guarded twice over: a function that calls itself is never
+// recorded, and a form never inlines an older definition of its own
+// function.  Bodies are recorded after their own calls were inlined, so
+// inlining one never needs another round.  A later redefinition of a callee
+// does not reach callers that inlined the old body, as with any inliner.
+//
+// Run before ConstantFolder, so that constant arguments fold into the
+// inlined bodies, and Define() after all passes, so that the recorded bodies
+// are as small as they will get.
+class Inliner {
+public:
+  static constexpr std::size_t kDefaultBudget = 16;
+
+  explicit Inliner(std::size_t budget = kDefaultBudget) : budget_(budget) {}
+
+  // Records the function `form` defines, if it can be inlined, or forgets
+  // the function an extern or a larger definition replaces.
+  void Define(const FlatAst &form);
+
+  // Replaces the calls in `form` to recorded functions with their bodies.
+  // Returns the number of calls replaced.
+  int Run(FlatAst *form);
+
+private:
+  struct Function {
+    std::vector<Symbol> params;
+    // Just the expression nodes, with the body's root last.
+    FlatAst body;
+  };
+
+  std::size_t budget_;
+  absl::flat_hash_map<Symbol, Function> functions_;
+
+  FlatAst out_;
+  // The copy of each input node, and of each node of an inlined body.
+  std::vector<FlatAst::Index> map_;
+  std::vector<FlatAst::Index> body_map_;
+  std::vector<FlatAst::Index> call_args_;
+  std::vector<FlatAst::Index> scratch_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_TRANSFORMS_INLINER_H__
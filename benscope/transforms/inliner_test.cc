@@ -0,0 +1,83 @@
+#include "benscope/transforms/inliner.h"
+
+#include <memory>
+#include <string>
+
+#include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/parsing/printer.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::Eq;
+
+// Runs every form of `source` through an inliner in order and prints the
+// body of the last one.
+std::string Inline(const std::string &source,
+                   std::size_t budget = Inliner::kDefaultBudget) {
+  Parser parser(std::make_unique<Lexer>(source));
+  Inliner inliner(budget);
+  FlatAst form;
+  std::string printed;
+  while (parser.ParseNext(&form)) {
+    inliner.Run(&form);
+    inliner.Define(form);
+
+    // Inlined arguments are shared by every use of their parameter, which
+    // the flat printer walks once per use.
+    FlatAst body = form;
+    const FlatAst::Node &root = form[form.root()];
+    if (root.kind == AstKind::kFunction)
+      body.set_root(root.operands[1]);
+    PrintingVisitor v;
+    v.Print(body);
+    printed = v.ToString();
+  }
+  return printed;
+}
+
+TEST(InlinerTest, SubstitutesArguments) {
+  EXPECT_THAT(Inline("(def sq (x) (* x x)) (def f (y) (+ (sq y) 1))"),
+              Eq("[[{y} * {y}] + [1]]"));
+  EXPECT_THAT(Inline("(def sq (x) (* x x)) (def f (y) (sq (+ y 1)))"),
+              Eq("[[{y} + [1]] * [{y} + [1]]]"));
+  EXPECT_THAT(Inline("(def first (a b) a) (def f (y) (first y (g y)))"),
+              Eq("{y}"));
+}
+
+TEST(InlinerTest, InlinesAcrossSeveralForms) {
+  EXPECT_THAT(Inline("(def inc (x) (+ x 1))"
+                     "(def inc2 (x) (inc (inc x)))"
+                     "(def f (y) (inc2 y))"),
+              Eq("[[{y} + [1]] + [1]]"));
+}
+
+TEST(InlinerTest, GuardsAgainstRecursion) {
+  EXPECT_THAT(Inline("(def r (x) (if x (r x) 1)) (def f (y) (r y))"),
+              Eq("[CALL r {y}]"));
+  EXPECT_THAT(Inline("(def sq (x) (* x x)) (def sq (x) (+ (sq x) 1))"),
+              Eq("[[CALL sq {x}] + [1]]"));
+}
+
+TEST(InlinerTest, RespectsTheBudget) {
+  const std::string source = "(def g (x) (+ x (+ x x))) (def f (y) (g y))";
+  EXPECT_THAT(Inline(source, 5), Eq("[{y} + [{y} + {y}]]"));
+  EXPECT_THAT(Inline(source, 4), Eq("[CALL g {y}]"));
+}
+
+TEST(InlinerTest, LeavesInvalidCallsAlone) {
+  EXPECT_THAT(Inline("(def g (x) x) (def f (y) (g y y))"),
+              Eq("[CALL g {y} {y}]"));
+  EXPECT_THAT(Inline("(def g (x) z) (def f (y) (g y))"), Eq("[CALL g {y}]"));
+  EXPECT_THAT(Inline("(def g (x) x) (extern g (x)) (def f (y) (g y))"),
+              Eq("[CALL g {y}]"));
+}
+
+} // namespace
+} // namespace benscope
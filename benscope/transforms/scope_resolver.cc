@@ -0,0 +1,41 @@
+#include "benscope/transforms/scope_resolver.h"
+
+#include <iostream>
+#include <vector>
+
+#include "benscope/parsing/symbol.h"
+
+namespace benscope {
+
+bool ResolveScopes(FlatAst *form) {
+  const FlatAst::Node &root = (*form)[form->root()];
+  if (root.kind != AstKind::kFunction)
+    return true;
+  FlatAst::Range<Symbol> params = form->params((*form)[root.operands[0]]);
+
+  // Parameter lists are short, so a scan beats hashing.  Each unknown name is
+  // remembered so that it is reported only once.
+  std::vector<Symbol> unknown;
+  for (FlatAst::Index i = 0; i < form->size(); ++i) {
+    const FlatAst::Node &node = (*form)[i];
+    if (node.kind != AstKind::kVariable)
+      continue;
+    FlatAst::Index slot = params.size();
+    while (slot > 0 && params[slot - 1] != node.name)
+      --slot;
+    if (slot > 0) {
+      form->set_slot(i, slot - 1);
+      continue;
+    }
+    bool reported = false;
+    for (Symbol name : unknown)
+      reported |= name == node.name;
+    if (!reported) {
+      std::cerr << "Unknown variable " << node.name << "\n";
+      unknown.push_back(node.name);
+    }
+  }
+  return unknown.empty();
+}
+
+} // namespace benscope
@@ -0,0 +1,23 @@
+// Resolves variables to parameter numbers before code generation.
+
+#ifndef __BENSCOPE_TRANSFORMS_SCOPE_RESOLVER_H__
+#define __BENSCOPE_TRANSFORMS_SCOPE_RESOLVER_H__
+
+#include "benscope/parsing/flat_ast.h"
+
+namespace benscope {
+
+// Binds every variable of a function form to the number of the parameter it
+// names (FlatAst::set_slot), so that backends find a variable's value by
+// indexing an array instead of hashing its name in each enclosing scope.
+// The only scope is the function's parameter list; if a name appears in it
+// twice, the last one wins.
+//
+// Reports each unknown variable once, on std::cerr, and returns false if
+// there were any; the form should not be compiled then.  Run after all
+// other passes, which do not keep slots when they rebuild a form.
+bool ResolveScopes(FlatAst *form);
+
+} // namespace benscope
+
+#endif // __BENSCOPE_TRANSFORMS_SCOPE_RESOLVER_H__
@@ -0,0 +1,65 @@
+#include "benscope/transforms/scope_resolver.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+
+FlatAst Parse(const std::string &source) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  EXPECT_TRUE(parser.ParseNext(&form));
+  return form;
+}
+
+// The slots of the form's variables, in index order.
+std::vector<FlatAst::Index> Slots(const FlatAst &form) {
+  std::vector<FlatAst::Index> slots;
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    if (form[i].kind == AstKind::kVariable)
+      slots.push_back(form[i].operands[0]);
+  }
+  return slots;
+}
+
+TEST(ScopeResolverTest, BindsParameters) {
+  FlatAst form = Parse("(def f (a b c) (+ c (g a b a)))");
+  EXPECT_THAT(Slots(form), ElementsAre(FlatAst::kNone, FlatAst::kNone,
+                                       FlatAst::kNone, FlatAst::kNone));
+  EXPECT_TRUE(ResolveScopes(&form));
+  EXPECT_THAT(Slots(form), ElementsAre(2, 0, 1, 0));
+}
+
+TEST(ScopeResolverTest, LastDuplicateWins) {
+  FlatAst form = Parse("(def f (a a) a)");
+  EXPECT_TRUE(ResolveScopes(&form));
+  EXPECT_THAT(Slots(form), ElementsAre(1));
+}
+
+TEST(ScopeResolverTest, ReportsUnknownVariables) {
+  FlatAst form = Parse("(def f (a) (+ b (+ a b)))");
+  EXPECT_FALSE(ResolveScopes(&form));
+  EXPECT_THAT(Slots(form), ElementsAre(FlatAst::kNone, 0, FlatAst::kNone));
+}
+
+TEST(ScopeResolverTest, IgnoresExterns) {
+  FlatAst form = Parse("(extern f (a))");
+  EXPECT_TRUE(ResolveScopes(&form));
+  EXPECT_THAT(Slots(form), IsEmpty());
+}
+
+} // namespace
+} // namespace benscope
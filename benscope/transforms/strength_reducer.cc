@@ -0,0 +1,117 @@
+#include "benscope/transforms/strength_reducer.h"
+
+#include <cmath>
+#include <utility>
+
+namespace benscope {
+namespace {
+
+// Sets `reciprocal` to 1 / `value` if that is exactly representable.
+bool ExactReciprocal(double value, double *reciprocal) {
+  int exponent;
+  if (!std::isfinite(value) || std::fabs(std::frexp(value, &exponent)) != 0.5)
+    return false;
+  *reciprocal = 1 / value;
+  return std::isfinite(*reciprocal);
+}
+
+} // namespace
+
+FlatAst::Index StrengthReducer::Emit(const Value &value) {
+  return value.is_constant ? out_.AddNumber(value.constant) : value.index;
+}
+
+StrengthReducer::Value StrengthReducer::Binary(char op, Value lhs, Value rhs) {
+  auto is = [](const Value &v, double c) {
+    return v.is_constant && v.constant == c;
+  };
+
+  double reciprocal;
+  if (op == '/' && rhs.is_constant && costs_.multiply < costs_.divide &&
+      ExactReciprocal(rhs.constant, &reciprocal)) {
+    op = '*';
+    rhs.constant = reciprocal;
+  }
+
+  switch (op) {
+  case '+':
+    if (is(lhs, 0))
+      return rhs;
+    if (is(rhs, 0))
+      return lhs;
+    break;
+  case '-':
+    if (is(rhs, 0))
+      return lhs;
+    break;
+  case '*':
+    if (is(lhs, 1) || is(lhs, 2))
+      std::swap(lhs, rhs);
+    if (is(rhs, 1))
+      return lhs;
+    if (is(rhs, 2) && !lhs.is_constant &&
+        out_[lhs.index].kind == AstKind::kVariable &&
+        costs_.add + costs_.variable < costs_.multiply + costs_.number) {
+      FlatAst::Index twin = out_.AddVariable(out_[lhs.index].name);
+      return {false, 0, out_.AddBinary('+', lhs.index, twin)};
+    }
+    break;
+  case '/':
+    if (is(rhs, 1))
+      return lhs;
+    break;
+  }
+  FlatAst::Index l = Emit(lhs);
+  return {false, 0, out_.AddBinary(op, l, Emit(rhs))};
+}
+
+void StrengthReducer::Run(FlatAst *form) {
+  const FlatAst &in = *form;
+  out_.Clear();
+  values_.clear();
+  values_.reserve(in.size());
+
+  for (FlatAst::Index i = 0; i < in.size(); ++i) {
+    const FlatAst::Node &node = in[i];
+    Value value = {false, 0, FlatAst::kNone};
+    switch (node.kind) {
+    case AstKind::kNumber:
+      value = {true, node.value, FlatAst::kNone};
+      break;
+    case AstKind::kVariable:
+      value.index = out_.AddVariable(node.name);
+      break;
+    case AstKind::kBinary:
+      value = Binary(node.op, values_[node.operands[0]],
+                     values_[node.operands[1]]);
+      break;
+    case AstKind::kCall:
+      args_.clear();
+      for (FlatAst::Index arg : in.args(node))
+        args_.push_back(Emit(values_[arg]));
+      value.index = out_.AddCall(node.name, args_.data(), args_.size());
+      break;
+    case AstKind::kIf: {
+      FlatAst::Index test = Emit(values_[node.operands[0]]);
+      FlatAst::Index if_true = Emit(values_[node.operands[1]]);
+      value.index = out_.AddIf(test, if_true, Emit(values_[node.operands[2]]));
+      break;
+    }
+    case AstKind::kPrototype: {
+      FlatAst::Range<Symbol> params = in.params(node);
+      value.index = out_.AddPrototype(node.name, params.begin(), params.size());
+      break;
+    }
+    case AstKind::kFunction: {
+      FlatAst::Index proto = values_[node.operands[0]].index;
+      value.index = out_.AddFunction(proto, Emit(values_[node.operands[1]]));
+      break;
+    }
+    }
+    values_.push_back(value);
+  }
+  out_.set_root(Emit(values_[in.root()]));
+  std::swap(*form, out_);
+}
+
+} // namespace benscope
@@ -0,0 +1,64 @@
+// Replaces expensive arithmetic with cheaper equivalents under a backend's
+// cost model.
+
+#ifndef __BENSCOPE_TRANSFORMS_STRENGTH_REDUCER_H__
+#define __BENSCOPE_TRANSFORMS_STRENGTH_REDUCER_H__
+
+#include <vector>
+
+#include "benscope/parsing/flat_ast.h"
+
+namespace benscope {
+
+// What each kind of node costs a backend, in whatever unit it likes, as long
+// as it is the same for every field.
+struct CostModel {
+  int add;
+  int multiply;
+  int divide;
+  // Loading a constant or a variable's value as an operand.
+  int number;
+  int variable;
+};
+
+// Rewrites a form so that it computes the same values more cheaply:
+//
+//   - (/ x c) becomes (* x 1/c) when 1/c is exact, i.e. c is a power of two,
+//     and multiplying is cheaper than dividing.  The result is bit for bit
+//     the same.
+//   - (* x 2) becomes (+ x x) when x is a variable and the add and the second
+//     load are cheaper than the multiply and the constant.
+//   - (* x 1), (/ x 1), (+ x 0) and (- x 0) become x.  As with
+//     -fno-signed-zeros, x + 0 may then be -0 where it would have been +0.
+//
+// Best run after ConstantFolder, which moves constants to the right where
+// they can be seen here.  Like it, the pass rebuilds the form in index order
+// without recursion and leaves no unreachable nodes.
+class StrengthReducer {
+public:
+  explicit StrengthReducer(const CostModel &costs) : costs_(costs) {}
+
+  // Rewrites `form` in place.
+  void Run(FlatAst *form);
+
+private:
+  // What a node of the input becomes: a constant not yet emitted, or an
+  // emitted node.
+  struct Value {
+    bool is_constant;
+    double constant;
+    FlatAst::Index index;
+  };
+
+  FlatAst::Index Emit(const Value &value);
+  Value Binary(char op, Value lhs, Value rhs);
+
+  CostModel costs_;
+  FlatAst out_;
+  std::vector<Value> values_;
+  std::vector<FlatAst::Index> args_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_TRANSFORMS_STRENGTH_REDUCER_H__
@@ -0,0 +1,82 @@
+#include "benscope/transforms/strength_reducer.h"
+
+#include <memory>
+#include <string>
+
+#include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/parsing/printer.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::Eq;
+
+// Add, multiply, divide, number, variable.
+constexpr CostModel kSlowMultiply = {1, 10, 20, 1, 1};
+constexpr CostModel kFlat = {1, 1, 1, 1, 1};
+
+// Reduces the single form in `source` and prints its body.
+std::string Reduce(const std::string &source,
+                   const CostModel &costs = kSlowMultiply) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  if (!parser.ParseNext(&form))
+    return "<parse error>";
+  StrengthReducer reducer(costs);
+  reducer.Run(&form);
+
+  const FlatAst::Node &root = form[form.root()];
+  PrintingVisitor v;
+  v.Dispatch(*form.Inflate(root.kind == AstKind::kFunction ? root.operands[1]
+                                                           : form.root()));
+  return v.ToString();
+}
+
+TEST(StrengthReducerTest, DoublesByAdding) {
+  EXPECT_THAT(Reduce("(def f (x) (* x 2))"), Eq("[{x} + {x}]"));
+  EXPECT_THAT(Reduce("(def f (x) (* 2 x))"), Eq("[{x} + {x}]"));
+  EXPECT_THAT(Reduce("(def f (x) (* x 2))", kFlat), Eq("[{x} * [2]]"));
+  // A call would be made twice.
+  EXPECT_THAT(Reduce("(def f (x) (* (g x) 2))"), Eq("[[CALL g {x}] * [2]]"));
+}
+
+TEST(StrengthReducerTest, DividesByMultiplying) {
+  EXPECT_THAT(Reduce("(def f (x) (/ x 4))"), Eq("[{x} * [0.25]]"));
+  EXPECT_THAT(Reduce("(def f (x) (/ x 0.125))"), Eq("[{x} * [8]]"));
+  EXPECT_THAT(Reduce("(def f (x) (/ x 0.5))"), Eq("[{x} + {x}]"));
+  // 1/3 is not exact.
+  EXPECT_THAT(Reduce("(def f (x) (/ x 3))"), Eq("[{x} / [3]]"));
+  EXPECT_THAT(Reduce("(def f (x) (/ x 0))"), Eq("[{x} / [0]]"));
+  EXPECT_THAT(Reduce("(def f (x) (/ x 4))", kFlat), Eq("[{x} / [4]]"));
+  EXPECT_THAT(Reduce("(def f (x) (/ 4 x))"), Eq("[[4] / {x}]"));
+}
+
+TEST(StrengthReducerTest, DropsIdentities) {
+  EXPECT_THAT(Reduce("(def f (x) (* x 1))"), Eq("{x}"));
+  EXPECT_THAT(Reduce("(def f (x) (* 1 (g x)))"), Eq("[CALL g {x}]"));
+  EXPECT_THAT(Reduce("(def f (x) (/ x 1))", kFlat), Eq("{x}"));
+  EXPECT_THAT(Reduce("(def f (x) (+ 0 x))"), Eq("{x}"));
+  EXPECT_THAT(Reduce("(def f (x) (- x 0))"), Eq("{x}"));
+  EXPECT_THAT(Reduce("(def f (x) (- 0 x))"), Eq("[[0] - {x}]"));
+  EXPECT_THAT(Reduce("(def f (x) (if x (+ (* x 1) 0) 1))"),
+              Eq("[IF {x} THEN {x} ELSE [1]]"));
+}
+
+TEST(StrengthReducerTest, EmitsOnlyReachableNodes) {
+  Parser parser(std::make_unique<Lexer>("(def f (x) (+ (* (/ x 1) 1) 0))"));
+  FlatAst form;
+  ASSERT_TRUE(parser.ParseNext(&form));
+  StrengthReducer reducer(kSlowMultiply);
+  reducer.Run(&form);
+  // x, the prototype and the function.
+  EXPECT_THAT(form.size(), Eq(3));
+}
+
+} // namespace
+} // namespace benscope
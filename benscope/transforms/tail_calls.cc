@@ -0,0 +1,37 @@
+#include "benscope/transforms/tail_calls.h"
+
+#include <cstdint>
+
+namespace benscope {
+
+bool FindSelfTailCalls(const FlatAst &form, std::vector<bool> *tail_calls) {
+  tail_calls->assign(form.size(), false);
+  if (form.empty() || form[form.root()].kind != AstKind::kFunction)
+    return false;
+
+  const FlatAst::Node &function = form[form.root()];
+  const FlatAst::Node &proto = form[function.operands[0]];
+  std::vector<std::uint32_t> uses, tail_uses(form.size(), 0);
+  form.CountUses(&uses);
+  ++tail_uses[function.operands[1]];
+
+  // Parents come after their children, so by the time a node is reached,
+  // all of its uses have been counted.
+  bool found = false;
+  for (FlatAst::Index i = form.root(); i-- > 0;) {
+    if (tail_uses[i] == 0 || tail_uses[i] != uses[i])
+      continue;
+    const FlatAst::Node &node = form[i];
+    if (node.kind == AstKind::kIf) {
+      ++tail_uses[node.operands[1]];
+      ++tail_uses[node.operands[2]];
+    } else if (node.kind == AstKind::kCall && node.name == proto.name &&
+               form.args(node).size() == form.params(proto).size()) {
+      (*tail_calls)[i] = true;
+      found = true;
+    }
+  }
+  return found;
+}
+
+} // namespace benscope
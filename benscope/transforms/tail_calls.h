@@ -0,0 +1,24 @@
+// Finds the calls a function makes to itself in tail position.
+
+#ifndef __BENSCOPE_TRANSFORMS_TAIL_CALLS_H__
+#define __BENSCOPE_TRANSFORMS_TAIL_CALLS_H__
+
+#include <vector>
+
+#include "benscope/parsing/flat_ast.h"
+
+namespace benscope {
+
+// Sets (*tail_calls)[i] for each call node i of a kFunction form that calls
+// the function itself, with the right number of arguments, as the last thing
+// it does: the body, or a branch of an `if` in tail position.  Nothing is
+// left to do with such a call's value but return it, so a backend can
+// reassign the parameters and jump back to the start of the body instead.
+//
+// In a DAG (see HashConser) a node is in tail position only if every use of
+// it is.  Returns whether any call was marked.
+bool FindSelfTailCalls(const FlatAst &form, std::vector<bool> *tail_calls);
+
+} // namespace benscope
+
+#endif // __BENSCOPE_TRANSFORMS_TAIL_CALLS_H__
@@ -0,0 +1,70 @@
+#include "benscope/transforms/tail_calls.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/transforms/hash_conser.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+// The names of the first arguments of the marked calls, in index order.
+std::vector<std::string> TailCalls(const std::string &source,
+                                   bool merge = false) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  EXPECT_TRUE(parser.ParseNext(&form));
+  if (merge) {
+    HashConser conser;
+    conser.Run(&form);
+  }
+  std::vector<bool> tail_calls;
+  bool found = FindSelfTailCalls(form, &tail_calls);
+
+  std::vector<std::string> names;
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    if (tail_calls[i])
+      names.emplace_back(form[form.args(form[i])[0]].name.name());
+  }
+  EXPECT_EQ(found, !names.empty());
+  return names;
+}
+
+TEST(TailCallsTest, FindsCallsInTailPosition) {
+  EXPECT_THAT(TailCalls("(def f (a) (f a))"), ElementsAre("a"));
+  EXPECT_THAT(TailCalls("(def fib (n o y) (if (< y 2) n (fib o n y)))"),
+              ElementsAre("o"));
+  EXPECT_THAT(TailCalls("(def f (a b) (if a (if b (f b a) (f a b)) a))"),
+              ElementsAre("b", "a"));
+}
+
+TEST(TailCallsTest, IgnoresOtherCalls) {
+  // Something is still done with the result.
+  EXPECT_THAT(TailCalls("(def f (a) (+ (f a) 1))"), IsEmpty());
+  EXPECT_THAT(TailCalls("(def f (a) (if (f a) a a))"), IsEmpty());
+  // Not itself, or not a valid call.
+  EXPECT_THAT(TailCalls("(def f (a) (g a))"), IsEmpty());
+  EXPECT_THAT(TailCalls("(def f (a) (f a a))"), IsEmpty());
+  EXPECT_THAT(TailCalls("(extern f (a))"), IsEmpty());
+}
+
+TEST(TailCallsTest, SharedCallsMustBeTailCallsEverywhere) {
+  const std::string source = "(def f (a) (if a (f a) (+ (f a) 1)))";
+  EXPECT_THAT(TailCalls(source), ElementsAre("a"));
+  EXPECT_THAT(TailCalls(source, /*merge=*/true), IsEmpty());
+  EXPECT_THAT(TailCalls("(def f (a) (if a (f a) (f a)))", /*merge=*/true),
+              ElementsAre("a"));
+}
+
+} // namespace
+} // namespace benscope
@@ -0,0 +1,277 @@
+#include "benscope/transforms/type_inference.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace benscope {
+namespace {
+
+constexpr std::int64_t kMax = TypeInference::kMaxExactInteger;
+
+// The values a node may take: any double, or the integers in [lo, hi].
+struct Range {
+  bool integer = false;
+  std::int64_t lo = 0, hi = 0;
+};
+
+Range Integers(std::int64_t lo, std::int64_t hi) {
+  if (lo < -kMax || hi > kMax)
+    return Range();
+  return {/*integer=*/true, lo, hi};
+}
+
+Range OfNumber(double value) {
+  // -0 would lose its sign as an integer.
+  if (!(std::fabs(value) <= kMax) || value != std::trunc(value) ||
+      (value == 0 && std::signbit(value)))
+    return Range();
+  const auto i = static_cast<std::int64_t>(value);
+  return Integers(i, i);
+}
+
+bool HasZero(Range r) { return r.lo <= 0 && 0 <= r.hi; }
+
+Range OfBinary(char op, Range l, Range r) {
+  if (op == '<')
+    return Integers(0, 1);
+  if (!l.integer || !r.integer)
+    return Range();
+  switch (op) {
+  case '+':
+    return Integers(l.lo + r.lo, l.hi + r.hi);
+  case '-':
+    return Integers(l.lo - r.hi, l.hi - r.lo);
+  case '*': {
+    // A zero times a negative number is -0.
+    if ((HasZero(l) && r.lo < 0) || (HasZero(r) && l.lo < 0))
+      return Range();
+    const std::int64_t corners[][2] = {
+        {l.lo, r.lo}, {l.lo, r.hi}, {l.hi, r.lo}, {l.hi, r.hi}};
+    std::int64_t lo = kMax, hi = -kMax;
+    for (const auto &corner : corners) {
+      std::int64_t product;
+      if (__builtin_mul_overflow(corner[0], corner[1], &product))
+        return Range();
+      lo = std::min(lo, product);
+      hi = std::max(hi, product);
+    }
+    return Integers(lo, hi);
+  }
+  default:
+    return Range();
+  }
+}
+
+// Narrows the ranges of the parameters compared by `test`, if it is a `<`,
+// to those for which it evaluates to `result`.  `values` holds the ranges of
+// its operands.
+void Narrow(const FlatAst &form, const FlatAst::Node &test, bool result,
+            const std::vector<Range> &values, std::vector<Range> *env) {
+  if (test.kind != AstKind::kBinary || test.op != '<')
+    return;
+  const Range l = values[test.operands[0]], r = values[test.operands[1]];
+  if (!l.integer || !r.integer)
+    return;
+  auto narrow = [&](FlatAst::Index operand, std::int64_t lo, std::int64_t hi) {
+    const FlatAst::Node &n = form[operand];
+    if (n.kind != AstKind::kVariable || n.operands[0] == FlatAst::kNone)
+      return;
+    Range &range = (*env)[n.operands[0]];
+    if (range.integer) {
+      range.lo = std::max(range.lo, lo);
+      range.hi = std::min(range.hi, hi);
+    }
+  };
+  if (result) {
+    narrow(test.operands[0], l.lo, r.hi - 1);
+    narrow(test.operands[1], l.lo + 1, r.hi);
+  } else {
+    narrow(test.operands[0], r.lo, l.hi);
+    narrow(test.operands[1], r.lo, l.hi);
+  }
+}
+
+} // namespace
+
+bool TypeInference::Specialize(const FlatAst &form,
+                               std::vector<bool> *integer_params) {
+  const FlatAst::Node &proto = form[form[form.root()].operands[0]];
+  clones_.erase(proto.name);
+
+  // Start from all integers and give up on the parameters that a self call
+  // might pass a non-integer, until that no longer changes.
+  std::vector<bool> params(form.params(proto).size(), true);
+  FormTypes types;
+  for (bool changed = true; changed;) {
+    std::vector<bool> self_args(params.size(), true);
+    types = Infer(form, params, &self_args);
+    changed = false;
+    for (std::size_t i = 0; i < params.size(); ++i) {
+      if (params[i] && !self_args[i]) {
+        params[i] = false;
+        changed = true;
+      }
+    }
+  }
+
+  // Comparisons are integers either way; the clone is only worth having if
+  // something is computed from integers.
+  bool useful = false;
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    const FlatAst::Node &n = form[i];
+    if (n.kind == AstKind::kBinary && types.integer[i] &&
+        types.integer[n.operands[0]] && types.integer[n.operands[1]])
+      useful = true;
+  }
+  if (!useful || std::find(params.begin(), params.end(), true) == params.end())
+    return false;
+  clones_[proto.name] = params;
+  *integer_params = std::move(params);
+  return true;
+}
+
+FormTypes TypeInference::Infer(const FlatAst &form,
+                               std::vector<bool> integer_params) const {
+  return Infer(form, std::move(integer_params), nullptr);
+}
+
+FormTypes TypeInference::Infer(const FlatAst &form,
+                               std::vector<bool> integer_params,
+                               std::vector<bool> *self_args) const {
+  FormTypes types;
+  types.integer_params = std::move(integer_params);
+  types.integer.assign(form.size(), false);
+  types.callee_params.resize(form.size());
+
+  const FlatAst::Node &root = form[form.root()];
+  if (root.kind != AstKind::kFunction)
+    return types;
+  const FlatAst::Node &proto = form[root.operands[0]];
+
+  // The parameters' ranges, narrowed inside `if` branches.  Each narrowing
+  // gets a new version, and a node already evaluated under the current one
+  // is not walked again.
+  std::vector<std::vector<Range>> envs(1), else_envs;
+  for (std::size_t i = 0; i < form.params(proto).size(); ++i) {
+    envs[0].push_back(i < types.integer_params.size() &&
+                              types.integer_params[i]
+                          ? Integers(-kMax, kMax)
+                          : Range());
+  }
+  std::vector<std::uint32_t> versions = {1};
+  std::uint32_t next_version = 2;
+
+  std::vector<Range> ranges(form.size());
+  std::vector<std::uint32_t> evaluated(form.size(), 0);
+  std::vector<bool> clone_calls(form.size(), true);
+  std::vector<Range> values, branches;
+  auto pop = [&values] {
+    Range r = values.back();
+    values.pop_back();
+    return r;
+  };
+  auto finish = [&](FlatAst::Index index, Range r) {
+    types.integer[index] =
+        r.integer && (evaluated[index] == 0 || types.integer[index]);
+    ranges[index] = r;
+    evaluated[index] = versions.back();
+    values.push_back(r);
+    return FlatAst::kNone;
+  };
+  auto clone_of = [&](Symbol callee) -> const std::vector<bool> * {
+    if (callee == proto.name && !types.integer_params.empty())
+      return &types.integer_params;
+    auto it = clones_.find(callee);
+    return it == clones_.end() ? nullptr : &it->second;
+  };
+
+  form.Walk(root.operands[1], [&](const FlatAst::Node &n, int step) {
+    const FlatAst::Index index = form.index_of(n);
+    if (step == 0 && evaluated[index] == versions.back()) {
+      values.push_back(ranges[index]);
+      return FlatAst::kNone;
+    }
+    switch (n.kind) {
+    case AstKind::kNumber:
+      return finish(index, OfNumber(n.value));
+    case AstKind::kVariable:
+      return finish(index, n.operands[0] < envs.back().size()
+                               ? envs.back()[n.operands[0]]
+                               : Range());
+    case AstKind::kBinary: {
+      if (step < 2)
+        return n.operands[step];
+      Range r = pop(), l = pop();
+      return finish(index, OfBinary(n.op, l, r));
+    }
+    case AstKind::kCall: {
+      FlatAst::Range<FlatAst::Index> args = form.args(n);
+      if (step < static_cast<int>(args.size()))
+        return args[step];
+      std::vector<Range> arg_ranges(values.end() - args.size(), values.end());
+      values.resize(values.size() - args.size());
+
+      const std::vector<bool> *clone = clone_of(n.name);
+      bool integer_args = clone && clone->size() == args.size();
+      for (std::size_t i = 0; integer_args && i < args.size(); ++i)
+        integer_args = !(*clone)[i] || arg_ranges[i].integer;
+      clone_calls[index] = clone_calls[index] && integer_args;
+
+      if (self_args && n.name == proto.name) {
+        for (std::size_t i = 0; i < self_args->size(); ++i) {
+          if (args.size() != self_args->size() || !arg_ranges[i].integer)
+            (*self_args)[i] = false;
+        }
+      }
+      return finish(index, Range());
+    }
+    case AstKind::kIf:
+      switch (step) {
+      case 0:
+        return n.operands[0];
+      case 1: {
+        // Narrow both branches now, while `ranges` holds the test's operands
+        // as evaluated outside them.
+        values.pop_back();
+        std::vector<Range> if_true = envs.back(), if_false = envs.back();
+        Narrow(form, form[n.operands[0]], true, ranges, &if_true);
+        Narrow(form, form[n.operands[0]], false, ranges, &if_false);
+        envs.push_back(std::move(if_true));
+        versions.push_back(next_version++);
+        else_envs.push_back(std::move(if_false));
+        return n.operands[1];
+      }
+      case 2:
+        branches.push_back(pop());
+        envs.back() = std::move(else_envs.back());
+        else_envs.pop_back();
+        versions.back() = next_version++;
+        return n.operands[2];
+      default: {
+        envs.pop_back();
+        versions.pop_back();
+        const Range f = pop(), t = branches.back();
+        branches.pop_back();
+        if (!t.integer || !f.integer)
+          return finish(index, Range());
+        return finish(index,
+                      Integers(std::min(t.lo, f.lo), std::max(t.hi, f.hi)));
+      }
+      }
+    case AstKind::kFunction:
+    case AstKind::kPrototype:
+      break;
+    }
+    return FlatAst::kStop;
+  });
+
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    if (form[i].kind != AstKind::kCall || !evaluated[i] || !clone_calls[i])
+      continue;
+    if (const std::vector<bool> *clone = clone_of(form[i].name))
+      types.callee_params[i] = *clone;
+  }
+  return types;
+}
+
+} // namespace benscope
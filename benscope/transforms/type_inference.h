@@ -0,0 +1,75 @@
+// Finds the values that can be computed with integer arithmetic.
+
+#ifndef __BENSCOPE_TRANSFORMS_TYPE_INFERENCE_H__
+#define __BENSCOPE_TRANSFORMS_TYPE_INFERENCE_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/symbol.h"
+
+namespace benscope {
+
+// What TypeInference::Infer proves about one compilation of a form.
+struct FormTypes {
+  // For a function's integer clone: which parameters are integers.  Empty
+  // for the generic version, whose parameters are all doubles.
+  std::vector<bool> integer_params;
+  // By node: whether every value it takes is an integer no larger in
+  // magnitude than kMaxExactInteger, and never -0, so that 64-bit integer
+  // arithmetic computes exactly the double it stands for.
+  std::vector<bool> integer;
+  // By kCall node: the integer parameters of the callee's clone, if the call
+  // always passes integers there, otherwise empty for the generic version.
+  std::vector<std::vector<bool>> callee_params;
+};
+
+// Every value is a double, but counters, indices and the like only ever
+// hold small integers.  This proves which ones do, by tracking the range of
+// each value, narrowed by the `<` tests of enclosing `if`s, so that a
+// backend can use integer instructions for them.
+//
+// A function whose parameters can be integers gets an integer clone beside
+// its generic version, which stays the entry point for everything else.
+// Calls that pass integers in all the clone's integer parameters go to the
+// clone.
+class TypeInference {
+public:
+  // Integers up to 2^53 are exact in a double.
+  static constexpr std::int64_t kMaxExactInteger = std::int64_t{1} << 53;
+
+  // Chooses the integer parameters of a function form's clone and records
+  // them for calls from this and later forms.  These are the parameters to
+  // which every self call passes an integer, given integers in all of them.
+  // Returns false, and forgets any clone of an earlier definition, if the
+  // clone would do no integer arithmetic.
+  bool Specialize(const FlatAst &form, std::vector<bool> *integer_params);
+
+  // Forgets the clone of `name`, e.g. when it is redefined as an extern.
+  void Forget(Symbol name) { clones_.erase(name); }
+
+  // The integer parameters of the clone of `name`, or null if it has none.
+  const std::vector<bool> *Clone(Symbol name) const {
+    auto it = clones_.find(name);
+    return it == clones_.end() ? nullptr : &it->second;
+  }
+
+  // Types the nodes of `form`; with `integer_params`, for the function's
+  // clone.
+  FormTypes Infer(const FlatAst &form,
+                  std::vector<bool> integer_params = {}) const;
+
+private:
+  // Like Infer, also clearing (*self_args)[i] if a self call may pass a
+  // non-integer as parameter i.
+  FormTypes Infer(const FlatAst &form, std::vector<bool> integer_params,
+                  std::vector<bool> *self_args) const;
+
+  absl::flat_hash_map<Symbol, std::vector<bool>> clones_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_TRANSFORMS_TYPE_INFERENCE_H__
@@ -0,0 +1,139 @@
+#include "benscope/transforms/type_inference.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/transforms/scope_resolver.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+FlatAst Parse(const std::string &source) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  EXPECT_TRUE(parser.ParseNext(&form));
+  EXPECT_TRUE(ResolveScopes(&form));
+  return form;
+}
+
+// Whether the root of the function's body is an integer.
+bool BodyIsInteger(const FlatAst &form, const FormTypes &types) {
+  return types.integer[form[form.root()].operands[1]];
+}
+
+// The callee parameters of the form's calls, in index order.
+std::vector<std::vector<bool>> CalleeParams(const FlatAst &form,
+                                            const FormTypes &types) {
+  std::vector<std::vector<bool>> params;
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    if (form[i].kind == AstKind::kCall)
+      params.push_back(types.callee_params[i]);
+  }
+  return params;
+}
+
+TEST(TypeInferenceTest, TypesIntegerConstants) {
+  TypeInference inference;
+  FlatAst form = Parse("(+ 1 (* 2 3))");
+  EXPECT_TRUE(BodyIsInteger(form, inference.Infer(form)));
+  form = Parse("(+ 1 0.5)");
+  EXPECT_FALSE(BodyIsInteger(form, inference.Infer(form)));
+  form = Parse("(/ 4 2)");
+  EXPECT_FALSE(BodyIsInteger(form, inference.Infer(form)));
+}
+
+TEST(TypeInferenceTest, ComparisonsAreIntegers) {
+  TypeInference inference;
+  FlatAst form = Parse("(def f (a b) (< a b))");
+  EXPECT_TRUE(BodyIsInteger(form, inference.Infer(form)));
+}
+
+TEST(TypeInferenceTest, ParametersAreDoublesInTheGenericVersion) {
+  TypeInference inference;
+  FlatAst form = Parse("(def f (a) (+ a 1))");
+  EXPECT_FALSE(BodyIsInteger(form, inference.Infer(form)));
+}
+
+TEST(TypeInferenceTest, KeepsResultsExact) {
+  TypeInference inference;
+  // a + 1 may pass 2^53.
+  FlatAst form = Parse("(def f (a) (+ a 1))");
+  EXPECT_FALSE(BodyIsInteger(form, inference.Infer(form, {true})));
+  form = Parse("(def f (a) (- a 0))");
+  EXPECT_TRUE(BodyIsInteger(form, inference.Infer(form, {true})));
+  form = Parse("(def f (a) (* a a))");
+  EXPECT_FALSE(BodyIsInteger(form, inference.Infer(form, {true})));
+}
+
+TEST(TypeInferenceTest, NarrowsComparedParameters) {
+  TypeInference inference;
+  FlatAst form = Parse("(def f (a) (if (< a 10) (+ a 1) 0))");
+  EXPECT_TRUE(BodyIsInteger(form, inference.Infer(form, {true})));
+  form = Parse("(def f (a) (if (< a 10) 0 (- a 1)))");
+  EXPECT_TRUE(BodyIsInteger(form, inference.Infer(form, {true})));
+  form = Parse("(def f (a) (if (< a 10) 0 (+ a 1)))");
+  EXPECT_FALSE(BodyIsInteger(form, inference.Infer(form, {true})));
+}
+
+TEST(TypeInferenceTest, AvoidsNegativeZero) {
+  TypeInference inference;
+  FlatAst form = Parse("(- 0 0)");
+  EXPECT_TRUE(BodyIsInteger(form, inference.Infer(form)));
+  // a * 0 is -0 for negative a.
+  form = Parse("(def f (a) (if (< a 10) (* a 0) 0))");
+  EXPECT_FALSE(BodyIsInteger(form, inference.Infer(form, {true})));
+  form = Parse("(def f (a) (if (< a 0) 0 (* a 0)))");
+  EXPECT_TRUE(BodyIsInteger(form, inference.Infer(form, {true})));
+}
+
+TEST(TypeInferenceTest, SpecializesCounters) {
+  TypeInference inference;
+  FlatAst fib =
+      Parse("(def fib (n o y) (if (< y 2) n (fib (+ n o) n (- y 1))))");
+  std::vector<bool> params;
+  ASSERT_TRUE(inference.Specialize(fib, &params));
+  // n and o grow without bound; the counter y does not.
+  EXPECT_THAT(params, ElementsAre(false, false, true));
+  EXPECT_THAT(CalleeParams(fib, inference.Infer(fib, params)),
+              ElementsAre(ElementsAre(false, false, true)));
+  // In the generic version, y is not known to be an integer.
+  EXPECT_THAT(CalleeParams(fib, inference.Infer(fib)),
+              ElementsAre(IsEmpty()));
+
+  FlatAst call = Parse("(fib 1 0.5 4)");
+  EXPECT_THAT(CalleeParams(call, inference.Infer(call)),
+              ElementsAre(ElementsAre(false, false, true)));
+  call = Parse("(fib 1 0 4.5)");
+  EXPECT_THAT(CalleeParams(call, inference.Infer(call)),
+              ElementsAre(IsEmpty()));
+}
+
+TEST(TypeInferenceTest, SkipsFunctionsWithoutIntegerArithmetic) {
+  TypeInference inference;
+  std::vector<bool> params;
+  FlatAst form = Parse("(def f (a b) (/ a b))");
+  EXPECT_FALSE(inference.Specialize(form, &params));
+  // A redefinition forgets the clone.
+  form = Parse("(def f (a) (if (< a 1) 0 (f (- a 1))))");
+  EXPECT_TRUE(inference.Specialize(form, &params));
+  FlatAst call = Parse("(f 3)");
+  EXPECT_THAT(CalleeParams(call, inference.Infer(call)),
+              ElementsAre(ElementsAre(true)));
+  form = Parse("(def f (a) (/ a 2))");
+  EXPECT_FALSE(inference.Specialize(form, &params));
+  EXPECT_THAT(CalleeParams(call, inference.Infer(call)),
+              ElementsAre(IsEmpty()));
+}
+
+} // namespace
+} // namespace benscope
@@ -0,0 +1,240 @@
+#include "benscope/transforms/value_specializer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+
+namespace benscope {
+namespace {
+
+// Compares constants bit for bit, so that 0 and -0 differ.
+bool Same(const std::optional<double> &a, const std::optional<double> &b) {
+  if (!a || !b)
+    return !a && !b;
+  return std::memcmp(&*a, &*b, sizeof(double)) == 0;
+}
+
+// Whether `site` passes every constant of `key`, and maybe others.
+bool Covers(const std::vector<std::optional<double>> &site,
+            const std::vector<std::optional<double>> &key) {
+  if (site.size() != key.size())
+    return false;
+  for (std::size_t i = 0; i < key.size(); ++i) {
+    if (key[i] && !Same(site[i], key[i]))
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+std::vector<Symbol> ValueSpecializer::Record(const FlatAst &form) {
+  std::vector<Symbol> hot;
+  for (FlatAst::Index i = 0; i < form.size(); ++i) {
+    const FlatAst::Node &n = form[i];
+    if (n.kind != AstKind::kCall)
+      continue;
+    FlatAst::Range<FlatAst::Index> args = form.args(n);
+    Values values(args.size());
+    bool constant = false;
+    for (std::size_t j = 0; j < args.size(); ++j) {
+      if (form[args[j]].kind == AstKind::kNumber) {
+        values[j] = form[args[j]].value;
+        constant = true;
+      }
+    }
+    if (!constant)
+      continue;
+
+    std::vector<Values> &sites = functions_[n.name].sites;
+    if (sites.size() == kMaxSites)
+      sites.erase(sites.begin());
+    sites.push_back(std::move(values));
+    if (sites.size() >= kHotCalls &&
+        std::find(hot.begin(), hot.end(), n.name) == hot.end())
+      hot.push_back(n.name);
+  }
+  return hot;
+}
+
+bool ValueSpecializer::Specialize(const FlatAst &source, FlatAst *clone) {
+  const FlatAst::Node &root = source[source.root()];
+  if (root.kind != AstKind::kFunction)
+    return false;
+  const FlatAst::Node &proto = source[root.operands[0]];
+  FlatAst::Range<Symbol> params = source.params(proto);
+  auto it = functions_.find(proto.name);
+  if (it == functions_.end() || it->second.clones.size() >= kMaxClones)
+    return false;
+  Function &function = it->second;
+
+  // The parameters self calls pass on unchanged.  With a name listed twice,
+  // which parameter a variable means is not worth working out here.
+  std::vector<bool> invariant(params.size(), true);
+  for (std::size_t i = 0; i < params.size(); ++i) {
+    if (std::find(params.begin(), params.begin() + i, params[i]) !=
+        params.begin() + i)
+      return false;
+  }
+  for (FlatAst::Index i = 0; i < source.size(); ++i) {
+    const FlatAst::Node &n = source[i];
+    if (n.kind != AstKind::kCall || n.name != proto.name)
+      continue;
+    FlatAst::Range<FlatAst::Index> args = source.args(n);
+    if (args.size() != params.size())
+      return false;
+    for (std::size_t j = 0; j < args.size(); ++j) {
+      const FlatAst::Node &arg = source[args[j]];
+      if (arg.kind != AstKind::kVariable || arg.name != params[j])
+        invariant[j] = false;
+    }
+  }
+
+  // Of the constants calls pass there, each hot on its own, those the most
+  // calls agree on, and then the most of them.
+  Values best;
+  int best_calls = 0;
+  std::size_t best_constants = 0;
+  for (const Values &site : function.sites) {
+    if (site.size() != params.size())
+      continue;
+    Values key(site.size());
+    std::size_t constants = 0;
+    for (std::size_t j = 0; j < site.size(); ++j) {
+      if (!invariant[j] || !site[j])
+        continue;
+      Values one(site.size());
+      one[j] = site[j];
+      if (std::count_if(function.sites.begin(), function.sites.end(),
+                        [&one](const Values &other) {
+                          return Covers(other, one);
+                        }) >= kHotCalls) {
+        key[j] = site[j];
+        ++constants;
+      }
+    }
+    if (constants == 0)
+      continue;
+    int calls = 0;
+    for (const Values &other : function.sites)
+      calls += Covers(other, key);
+    const bool cloned = std::any_of(
+        function.clones.begin(), function.clones.end(),
+        [&key](const ValueClone &c) {
+          return Covers(c.values, key) && Covers(key, c.values);
+        });
+    if (!cloned && calls >= kHotCalls &&
+        (calls > best_calls ||
+         (calls == best_calls && constants > best_constants))) {
+      best = std::move(key);
+      best_calls = calls;
+      best_constants = constants;
+    }
+  }
+  if (best_calls == 0)
+    return false;
+
+  const Symbol name = Symbol::Intern(
+      absl::StrCat(proto.name.name(), ".v", function.next_clone++));
+
+  // Self calls go to the clone, without the replaced arguments.  Only the
+  // nodes still reachable without those are built.
+  std::vector<bool> needed(source.size(), false);
+  needed[source.root()] = true;
+  for (FlatAst::Index i = source.size(); i-- > 0;) {
+    const FlatAst::Node &n = source[i];
+    if (!needed[i])
+      continue;
+    switch (n.kind) {
+    case AstKind::kBinary:
+    case AstKind::kFunction:
+      needed[n.operands[0]] = needed[n.operands[1]] = true;
+      break;
+    case AstKind::kIf:
+      needed[n.operands[0]] = needed[n.operands[1]] = true;
+      needed[n.operands[2]] = true;
+      break;
+    case AstKind::kCall: {
+      FlatAst::Range<FlatAst::Index> args = source.args(n);
+      for (std::size_t j = 0; j < args.size(); ++j) {
+        if (n.name != proto.name || !best[j])
+          needed[args[j]] = true;
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  clone->Clear();
+  std::vector<FlatAst::Index> map(source.size(), FlatAst::kNone);
+  std::vector<FlatAst::Index> args;
+  std::vector<Symbol> clone_params;
+  for (FlatAst::Index i = 0; i < source.size(); ++i) {
+    const FlatAst::Node &n = source[i];
+    if (!needed[i])
+      continue;
+    switch (n.kind) {
+    case AstKind::kNumber:
+      map[i] = clone->AddNumber(n.value);
+      break;
+    case AstKind::kVariable: {
+      auto param = std::find(params.begin(), params.end(), n.name);
+      map[i] = param != params.end() && best[param - params.begin()]
+                   ? clone->AddNumber(*best[param - params.begin()])
+                   : clone->AddVariable(n.name);
+      break;
+    }
+    case AstKind::kBinary:
+      map[i] = clone->AddBinary(n.op, map[n.operands[0]], map[n.operands[1]]);
+      break;
+    case AstKind::kCall: {
+      const bool self = n.name == proto.name;
+      FlatAst::Range<FlatAst::Index> call_args = source.args(n);
+      args.clear();
+      for (std::size_t j = 0; j < call_args.size(); ++j) {
+        if (!self || !best[j])
+          args.push_back(map[call_args[j]]);
+      }
+      map[i] = clone->AddCall(self ? name : n.name, args.data(), args.size());
+      break;
+    }
+    case AstKind::kIf:
+      map[i] = clone->AddIf(map[n.operands[0]], map[n.operands[1]],
+                            map[n.operands[2]]);
+      break;
+    case AstKind::kPrototype:
+      for (std::size_t j = 0; j < params.size(); ++j) {
+        if (!best[j])
+          clone_params.push_back(params[j]);
+      }
+      map[i] = clone->AddPrototype(name, clone_params.data(),
+                                   clone_params.size());
+      break;
+    case AstKind::kFunction:
+      map[i] = clone->AddFunction(map[n.operands[0]], map[n.operands[1]]);
+      break;
+    }
+  }
+  clone->set_root(map[source.root()]);
+
+  function.clones.push_back({name, std::move(best)});
+  return true;
+}
+
+const std::vector<ValueClone> *ValueSpecializer::Clones(Symbol name) const {
+  auto it = functions_.find(name);
+  return it == functions_.end() || it->second.clones.empty()
+             ? nullptr
+             : &it->second.clones;
+}
+
+void ValueSpecializer::Forget(Symbol name) {
+  if (auto it = functions_.find(name); it != functions_.end())
+    it->second.clones.clear();
+}
+
+} // namespace benscope
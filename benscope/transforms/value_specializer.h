@@ -0,0 +1,72 @@
+// Clones functions for the constant arguments their calls keep passing.
+
+#ifndef __BENSCOPE_TRANSFORMS_VALUE_SPECIALIZER_H__
+#define __BENSCOPE_TRANSFORMS_VALUE_SPECIALIZER_H__
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/symbol.h"
+
+namespace benscope {
+
+// A clone of a function with some of its parameters replaced by constants.
+struct ValueClone {
+  Symbol name;
+  // By parameter of the original: the constant the clone has in its place,
+  // if any.  The clone takes the other parameters, in order.
+  std::vector<std::optional<double>> values;
+};
+
+// Counts the constant arguments of the calls seen so far.  When enough of a
+// function's calls agree on the constants they pass, this builds a clone of
+// the function with those constants in place of its parameters, for the
+// usual passes to fold.  The backend guards the function's entry with a
+// test of its arguments that dispatches to the clone.
+//
+// Only parameters that the function's self calls pass on unchanged are
+// replaced: elsewhere, the constants would last for a single call.
+class ValueSpecializer {
+public:
+  // Calls that must pass the same constants before a function is cloned.
+  static constexpr int kHotCalls = 3;
+  // Clones per function, each of which costs a test on every call.
+  static constexpr std::size_t kMaxClones = 4;
+  // Calls remembered per function, the oldest forgotten first.
+  static constexpr std::size_t kMaxSites = 64;
+
+  // Records the constant arguments of the calls in `form`.  Returns the
+  // callees that now have enough calls to be worth a clone.
+  std::vector<Symbol> Record(const FlatAst &form);
+
+  // Builds a clone of the function that `source` defines for the constants
+  // most often passed to it, and records it for Clones().  Returns false if
+  // no constants are passed often enough that have no clone yet.
+  bool Specialize(const FlatAst &source, FlatAst *clone);
+
+  // The clones of `name`, oldest first, or null if there are none.
+  const std::vector<ValueClone> *Clones(Symbol name) const;
+
+  // Forgets the clones of `name`, e.g. when it is redefined.  The calls
+  // recorded so far still count.
+  void Forget(Symbol name);
+
+private:
+  using Values = std::vector<std::optional<double>>;
+
+  struct Function {
+    std::vector<Values> sites;
+    std::vector<ValueClone> clones;
+    // Clone names are never reused, not even after Forget().
+    int next_clone = 1;
+  };
+
+  absl::flat_hash_map<Symbol, Function> functions_;
+};
+
+} // namespace benscope
+
+#endif // __BENSCOPE_TRANSFORMS_VALUE_SPECIALIZER_H__
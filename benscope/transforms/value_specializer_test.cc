@@ -0,0 +1,130 @@
+#include "benscope/transforms/value_specializer.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/parsing/printer.h"
+#include "benscope/parsing/symbol.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::IsNull;
+using ::testing::Optional;
+
+FlatAst Parse(const std::string &source) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  EXPECT_TRUE(parser.ParseNext(&form));
+  return form;
+}
+
+// Records every form of `source` and returns the callees the last one made
+// hot.
+std::vector<Symbol> Record(ValueSpecializer *specializer,
+                           const std::string &source) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  std::vector<Symbol> hot;
+  while (parser.ParseNext(&form))
+    hot = specializer->Record(form);
+  return hot;
+}
+
+std::string Print(const FlatAst &form) {
+  PrintingVisitor v;
+  v.Print(form);
+  return v.ToString();
+}
+
+Symbol S(const char *name) { return Symbol::Intern(name); }
+
+constexpr char kCount[] = "(def count (i n) (if (< i n) (count (+ i 1) n) i))";
+
+TEST(ValueSpecializerTest, WaitsForEnoughCalls) {
+  ValueSpecializer specializer;
+  EXPECT_THAT(Record(&specializer, "(count 0 100) (count x 100)"), IsEmpty());
+  FlatAst clone;
+  EXPECT_FALSE(specializer.Specialize(Parse(kCount), &clone));
+  EXPECT_THAT(Record(&specializer, "(count 5 100)"), ElementsAre(S("count")));
+}
+
+TEST(ValueSpecializerTest, ReplacesParametersPassedOnUnchanged) {
+  ValueSpecializer specializer;
+  Record(&specializer, "(count 0 100) (count 1 100) (count 0 100)");
+  FlatAst clone;
+  ASSERT_TRUE(specializer.Specialize(Parse(kCount), &clone));
+  // i changes from call to call, so only n is replaced.
+  EXPECT_THAT(Print(clone),
+              Eq("[DEFINE count.v1(i) :== [IF [{i} < [100]] THEN "
+                 "[CALL count.v1 [{i} + [1]]] ELSE {i}]]"));
+  const std::vector<ValueClone> *clones = specializer.Clones(S("count"));
+  ASSERT_NE(clones, nullptr);
+  ASSERT_EQ(clones->size(), 1);
+  EXPECT_THAT((*clones)[0].name, Eq(S("count.v1")));
+  EXPECT_THAT((*clones)[0].values,
+              ElementsAre(Eq(std::nullopt), Optional(100.0)));
+
+  // The same constants are not cloned twice.
+  EXPECT_FALSE(specializer.Specialize(Parse(kCount), &clone));
+}
+
+TEST(ValueSpecializerTest, ReplacesAnyParameterOfNonRecursiveFunctions) {
+  ValueSpecializer specializer;
+  Record(&specializer, "(scale 2 x) (scale 2 y) (scale 2 z)");
+  FlatAst clone;
+  ASSERT_TRUE(specializer.Specialize(
+      Parse("(def scale (k x) (* (sin k) x))"), &clone));
+  EXPECT_THAT(Print(clone),
+              Eq("[DEFINE scale.v1(x) :== [[CALL sin [2]] * {x}]]"));
+}
+
+TEST(ValueSpecializerTest, LeavesOutConstantsThatVary) {
+  ValueSpecializer specializer;
+  Record(&specializer, "(scale 2 3) (scale 2 4) (scale 2 5)");
+  FlatAst clone;
+  ASSERT_TRUE(specializer.Specialize(
+      Parse("(def scale (k x) (* (sin k) x))"), &clone));
+  EXPECT_THAT(Print(clone),
+              Eq("[DEFINE scale.v1(x) :== [[CALL sin [2]] * {x}]]"));
+}
+
+TEST(ValueSpecializerTest, TellsZeroFromNegativeZero) {
+  ValueSpecializer specializer;
+  Record(&specializer, "(scale 0 x) (scale 0 y)");
+  // The parser has no negative literals.
+  FlatAst call;
+  const FlatAst::Index args[] = {call.AddNumber(-0.0),
+                                 call.AddVariable(S("z"))};
+  call.set_root(call.AddCall(S("scale"), args, 2));
+  specializer.Record(call);
+  FlatAst clone;
+  EXPECT_FALSE(specializer.Specialize(
+      Parse("(def scale (k x) (* k x))"), &clone));
+}
+
+TEST(ValueSpecializerTest, ForgetsClonesOfRedefinedFunctions) {
+  ValueSpecializer specializer;
+  Record(&specializer, "(count 0 100) (count 1 100) (count 2 100)");
+  FlatAst clone;
+  ASSERT_TRUE(specializer.Specialize(Parse(kCount), &clone));
+  specializer.Forget(S("count"));
+  EXPECT_THAT(specializer.Clones(S("count")), IsNull());
+  // The calls still count, and the new clone gets a new name.
+  ASSERT_TRUE(specializer.Specialize(Parse(kCount), &clone));
+  EXPECT_THAT(specializer.Clones(S("count"))->back().name,
+              Eq(S("count.v2")));
+}
+
+} // namespace
+} // namespace benscope
@@ -0,0 +1,368 @@
+#include "benscope/vm/compiler.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "benscope/transforms/tail_calls.h"
+
+namespace benscope::vm {
+namespace {
+
+// Registers and code positions are 16 bits wide in the bytecode.
+constexpr std::uint32_t kMaxRegisters = 1 << 16;
+constexpr std::size_t kMaxCode = 1 << 16;
+
+// Compiles the body of one function form.
+class FunctionCompiler {
+public:
+  // `self` is the number `f` is to have in `program`.
+  FunctionCompiler(const FlatAst &form, const Program &program,
+                   const Function &f, Program::Index self)
+      : form_(form), program_(program), name_(f.name), arity_(f.arity),
+        self_(self) {}
+
+  // Fills in `f`'s code, constants and frame size.
+  bool Run(Function *f);
+
+private:
+  using Register = std::uint16_t;
+
+  // The function a call to `name` with `argc` arguments refers to.
+  std::optional<Program::Index> Callee(Symbol name, std::size_t argc) const {
+    std::optional<Program::Index> callee;
+    std::size_t arity = arity_;
+    if (name == name_) {
+      callee = self_;
+    } else if ((callee = program_.Find(name)) &&
+               program_[*callee].defined()) {
+      arity = program_[*callee].arity;
+    } else {
+      std::cerr << "Unknown function " << name << "\n";
+      return std::nullopt;
+    }
+    if (arity != argc) {
+      std::cerr << "Wrong number of arguments to " << name << "\n";
+      return std::nullopt;
+    }
+    return callee;
+  }
+
+  std::size_t Emit(Opcode op, std::uint32_t a = 0, std::uint32_t b = 0,
+                   std::uint32_t c = 0) {
+    if (code_.size() == kMaxCode) {
+      std::cerr << "Function too large for the interpreter.\n";
+      ok_ = false;
+    }
+    code_.push_back({op, static_cast<std::uint16_t>(a),
+                     static_cast<std::uint16_t>(b),
+                     static_cast<std::uint16_t>(c)});
+    return code_.size() - 1;
+  }
+
+  // Points the jump at `at` to the next instruction.
+  void Patch(std::size_t at) {
+    Instruction &jump = code_[at];
+    (jump.op == Opcode::kJumpIfNotLess ? jump.c : jump.b) =
+        static_cast<std::uint16_t>(code_.size());
+    label_ = code_.size();
+  }
+
+  // Takes the next temporary, above `top`.
+  Register Temp() { return Reserve(top_++); }
+
+  Register Reserve(std::uint32_t r) {
+    if (r >= kMaxRegisters) {
+      std::cerr << "Function too large for the interpreter.\n";
+      ok_ = false;
+      return 0;
+    }
+    if (r + 1 > registers_)
+      registers_ = r + 1;
+    return static_cast<Register>(r);
+  }
+
+  const FlatAst &form_;
+  const Program &program_;
+  const Symbol name_;
+  const std::uint32_t arity_;
+  const Program::Index self_;
+
+  std::vector<Instruction> code_;
+  // The position after the last jump target, before which an instruction
+  // may be merged with the next.
+  std::size_t label_ = 0;
+  std::uint32_t top_ = 0;
+  std::uint32_t registers_ = 0;
+  bool ok_ = true;
+};
+
+bool FunctionCompiler::Run(Function *f) {
+  const FlatAst::Node &root = form_[form_.root()];
+
+  // Constants, each loaded once into the registers after the parameters,
+  // then a register for each shared node, then the temporaries.
+  std::vector<bool> needed(form_.size(), false);
+  needed[root.operands[1]] = true;
+  for (FlatAst::Index i = form_.size(); i-- > 0;) {
+    const FlatAst::Node &n = form_[i];
+    if (!needed[i])
+      continue;
+    switch (n.kind) {
+    case AstKind::kBinary:
+      needed[n.operands[0]] = needed[n.operands[1]] = true;
+      break;
+    case AstKind::kIf:
+      needed[n.operands[0]] = needed[n.operands[1]] = true;
+      needed[n.operands[2]] = true;
+      break;
+    case AstKind::kCall:
+      for (FlatAst::Index arg : form_.args(n))
+        needed[arg] = true;
+      break;
+    default:
+      break;
+    }
+  }
+  std::vector<std::uint32_t> uses;
+  form_.CountUses(&uses);
+  absl::flat_hash_map<std::uint64_t, Register> constant_registers;
+  std::vector<Register> registers(form_.size(), 0);
+  std::vector<FlatAst::Index> shared_nodes;
+  for (FlatAst::Index i = 0; i < form_.size(); ++i) {
+    const FlatAst::Node &n = form_[i];
+    if (!needed[i])
+      continue;
+    if (n.kind == AstKind::kNumber) {
+      std::uint64_t bits;
+      std::memcpy(&bits, &n.value, sizeof(bits));
+      auto [it, added] = constant_registers.try_emplace(
+          bits, static_cast<Register>(arity_ + f->constants.size()));
+      if (added)
+        f->constants.push_back(n.value);
+      registers[i] = it->second;
+    } else if (n.kind != AstKind::kVariable && uses[i] > 1) {
+      shared_nodes.push_back(i);
+    }
+  }
+  top_ = registers_ = arity_ + f->constants.size();
+  if (top_ >= kMaxRegisters) {
+    std::cerr << "Function too large for the interpreter.\n";
+    return false;
+  }
+  for (FlatAst::Index i : shared_nodes)
+    registers[i] = Temp();
+  const std::uint32_t temps = top_;
+
+  std::vector<bool> tail_calls;
+  FindSelfTailCalls(form_, &tail_calls);
+
+  std::vector<Register> values;
+  std::vector<std::uint32_t> tops;
+  std::vector<Program::Index> callees;
+  std::vector<std::size_t> jumps;
+  auto pop = [&values] {
+    Register r = values.back();
+    values.pop_back();
+    return r;
+  };
+  auto push = [this, &values](Register r) {
+    values.push_back(r);
+    return ok_ ? FlatAst::kNone : FlatAst::kStop;
+  };
+
+  // Shared nodes computed so far, and the order they were computed in.
+  // Those computed inside an `if` branch are dropped when it ends, back to
+  // the mark taken before the branch.
+  std::vector<bool> available(form_.size(), false);
+  std::vector<FlatAst::Index> recorded;
+  std::vector<std::size_t> marks;
+  auto forget = [&](std::size_t mark) {
+    for (std::size_t j = mark; j < recorded.size(); ++j)
+      available[recorded[j]] = false;
+    recorded.resize(mark);
+  };
+  // The register for the value of `index`, whose operands are finished.
+  auto result = [&](FlatAst::Index index) {
+    top_ = tops.back();
+    tops.pop_back();
+    if (uses[index] <= 1)
+      return Temp();
+    available[index] = true;
+    recorded.push_back(index);
+    return registers[index];
+  };
+
+  bool walked = form_.Walk(root.operands[1], [&](const FlatAst::Node &n,
+                                                 int step) -> FlatAst::Index {
+    const FlatAst::Index index = form_.index_of(n);
+    if (step == 0 && available[index])
+      return push(registers[index]);
+    switch (n.kind) {
+    case AstKind::kNumber:
+      return push(registers[index]);
+    case AstKind::kVariable:
+      if (n.operands[0] == FlatAst::kNone) {
+        std::cerr << "Unresolved variable " << n.name << "\n";
+        return FlatAst::kStop;
+      }
+      return push(static_cast<Register>(n.operands[0]));
+    case AstKind::kBinary: {
+      if (step == 0)
+        tops.push_back(top_);
+      if (step < 2)
+        return n.operands[step];
+      Opcode op;
+      switch (n.op) {
+      case '+':
+        op = Opcode::kAdd;
+        break;
+      case '-':
+        op = Opcode::kSubtract;
+        break;
+      case '*':
+        op = Opcode::kMultiply;
+        break;
+      case '/':
+        op = Opcode::kDivide;
+        break;
+      case '<':
+        op = Opcode::kLess;
+        break;
+      default:
+        std::cerr << "Unknown binary operator " << n.op << "\n";
+        return FlatAst::kStop;
+      }
+      Register rhs = pop(), lhs = pop();
+      Register dest = result(index);
+      Emit(op, dest, lhs, rhs);
+      return push(dest);
+    }
+    case AstKind::kCall: {
+      FlatAst::Range<FlatAst::Index> args = form_.args(n);
+      if (step == 0) {
+        std::optional<Program::Index> callee = Callee(n.name, args.size());
+        if (!callee)
+          return FlatAst::kStop;
+        callees.push_back(*callee);
+        tops.push_back(top_);
+      }
+      const std::uint32_t base = tops.back();
+      if (step > 0) {
+        // Moves the argument just finished into place above the others.
+        Register arg = pop();
+        Register target = Reserve(base + step - 1);
+        if (arg != target)
+          Emit(Opcode::kMove, target, arg);
+        top_ = target + 1;
+      }
+      if (step < static_cast<int>(args.size()))
+        return args[step];
+      const Program::Index callee = callees.back();
+      callees.pop_back();
+      if (tail_calls[index]) {
+        // Nothing uses the value; the register only keeps the stack even.
+        Emit(Opcode::kTailCall, base, args.size());
+        top_ = base;
+        tops.pop_back();
+        return push(Temp());
+      }
+      Register dest = result(index);
+      Emit(Opcode::kCall, dest, callee, base);
+      return push(dest);
+    }
+    case AstKind::kIf:
+      switch (step) {
+      case 0:
+        tops.push_back(top_);
+        return n.operands[0];
+      case 1: {
+        Register test = pop();
+        top_ = tops.back();
+        // A `<` computed just for the test, with no jump to it from
+        // elsewhere, is merged into the branch.
+        if (!code_.empty() && code_.back().op == Opcode::kLess &&
+            code_.back().a == test && test >= temps && label_ < code_.size()) {
+          const Instruction less = code_.back();
+          code_.back() = {Opcode::kJumpIfNotLess, less.b, less.c, 0};
+          jumps.push_back(code_.size() - 1);
+        } else {
+          jumps.push_back(Emit(Opcode::kJumpIfFalse, test));
+        }
+        marks.push_back(recorded.size());
+        return n.operands[1];
+      }
+      case 2: {
+        Register v = pop();
+        Register dest =
+            uses[index] > 1 ? registers[index] : Reserve(tops.back());
+        if (v != dest)
+          Emit(Opcode::kMove, dest, v);
+        std::size_t test = jumps.back();
+        jumps.back() = Emit(Opcode::kJump);
+        Patch(test);
+        forget(marks.back());
+        top_ = tops.back();
+        return n.operands[2];
+      }
+      default: {
+        Register v = pop();
+        forget(marks.back());
+        marks.pop_back();
+        Register dest = result(index);
+        if (v != dest)
+          Emit(Opcode::kMove, dest, v);
+        Patch(jumps.back());
+        jumps.pop_back();
+        return push(dest);
+      }
+      }
+    default:
+      std::cerr << "Unexpected node in function body.\n";
+      return FlatAst::kStop;
+    }
+  });
+  if (!walked || !ok_)
+    return false;
+  Emit(Opcode::kReturn, values.back());
+  f->code = std::move(code_);
+  f->registers = registers_;
+  return ok_;
+}
+
+} // namespace
+
+bool Compile(const FlatAst &form, Program *program) {
+  const FlatAst::Node &root = form[form.root()];
+  const FlatAst::Node &proto =
+      root.kind == AstKind::kFunction ? form[root.operands[0]] : root;
+  const std::size_t arity = form.params(proto).size();
+  if (arity >= kMaxRegisters) {
+    std::cerr << "Too many parameters for the interpreter.\n";
+    return false;
+  }
+  if (root.kind == AstKind::kPrototype)
+    return program->DeclareExtern(proto.name, arity);
+
+  // The number the function will have, for its calls to itself.
+  std::optional<Program::Index> self = program->Find(proto.name);
+  if (!self || (*program)[*self].arity != arity)
+    self = static_cast<Program::Index>(program->size());
+  Function f;
+  f.name = proto.name;
+  f.arity = arity;
+  if (!FunctionCompiler(form, *program, f, *self).Run(&f))
+    return false;
+
+  Program::Index index;
+  Function *defined = program->Declare(proto.name, arity, &index);
+  if (!defined)
+    return false;
+  *defined = std::move(f);
+  return true;
+}
+
+} // namespace benscope::vm
@@ -0,0 +1,31 @@
+// Compiles forms to register bytecode for the interpreter.
+
+#ifndef __BENSCOPE_VM_COMPILER_H__
+#define __BENSCOPE_VM_COMPILER_H__
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/vm/program.h"
+
+namespace benscope::vm {
+
+// Adds the function or extern that `form` defines to `program`, replacing
+// any earlier definition.  The anonymous function of an expression is
+// added under AnonExprSymbol() like any other.  Variables must be resolved
+// (see ResolveScopes).
+//
+// Each node's value goes into a register of the function's frame: a
+// variable's is its parameter's, a constant's is loaded on entry, and the
+// rest are allocated as temporaries in a stack discipline, with the
+// arguments of a call at the top so that they become the callee's
+// parameters in place.  A node with more than one use (see HashConser) is
+// computed once into a register of its own and reused wherever its first
+// evaluation dominates.  Self tail calls jump back to the start, and an
+// `if` on `<` is a single compare-and-branch.
+//
+// Reports errors on std::cerr and returns false; `program` is unchanged
+// then.
+bool Compile(const FlatAst &form, Program *program);
+
+} // namespace benscope::vm
+
+#endif // __BENSCOPE_VM_COMPILER_H__
@@ -0,0 +1,127 @@
+#include "benscope/vm/compiler.h"
+
+#include <memory>
+#include <string>
+
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/parsing/symbol.h"
+#include "benscope/transforms/hash_conser.h"
+#include "benscope/transforms/scope_resolver.h"
+#include "benscope/vm/program.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope::vm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Optional;
+
+// Compiles each form of `source` into `program`.  Returns whether all of
+// them compiled.
+bool CompileAll(Program *program, const std::string &source,
+                bool merge = false) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  bool ok = true;
+  while (parser.ParseNext(&form)) {
+    if (merge) {
+      HashConser conser;
+      conser.Run(&form);
+    }
+    ok = ResolveScopes(&form) && Compile(form, program) && ok;
+  }
+  return ok;
+}
+
+// The listing of the function `name` in `program`.
+std::string Listing(const Program &program, const char *name) {
+  std::optional<Program::Index> index = program.Find(Symbol::Intern(name));
+  EXPECT_TRUE(index.has_value());
+  return index ? Disassemble(program, program[*index]) : "";
+}
+
+TEST(CompilerTest, KeepsConstantsAfterParameters) {
+  Program program;
+  ASSERT_TRUE(CompileAll(&program, "(def f (a b) (+ a (* b 2)))"));
+  const Function &f = program[*program.Find(Symbol::Intern("f"))];
+  EXPECT_EQ(f.arity, 2);
+  EXPECT_THAT(f.constants, ElementsAre(2.0));
+  EXPECT_EQ(f.registers, 4);
+  EXPECT_THAT(Listing(program, "f"), Eq("0: multiply r3 r1 r2\n"
+                                        "1: add r3 r0 r3\n"
+                                        "2: return r3\n"));
+}
+
+TEST(CompilerTest, PassesArgumentsAtTheTopOfTheFrame) {
+  Program program;
+  ASSERT_TRUE(CompileAll(&program, "(def f (a b) (- a b))"
+                                   "(def g (x) (+ 1 (f 3 x)))"));
+  EXPECT_THAT(Listing(program, "g"), Eq("0: move r3 r2\n"
+                                        "1: move r4 r0\n"
+                                        "2: call r3 f r3\n"
+                                        "3: add r3 r1 r3\n"
+                                        "4: return r3\n"));
+}
+
+TEST(CompilerTest, BranchesOnComparisons) {
+  Program program;
+  ASSERT_TRUE(CompileAll(
+      &program, "(def count (i n) (if (< i n) (count (+ i 1) n) i))"));
+  EXPECT_THAT(Listing(program, "count"), Eq("0: jump_if_not_less r0 r1 5\n"
+                                            "1: add r3 r0 r2\n"
+                                            "2: move r4 r1\n"
+                                            "3: tail_call r3 2\n"
+                                            "4: jump 6\n"
+                                            "5: move r3 r0\n"
+                                            "6: return r3\n"));
+
+  // Not where a branch joins just after the comparison.
+  ASSERT_TRUE(CompileAll(&program,
+                         "(def g (a b) (if (if a (< a b) (< b a)) a b))"));
+  EXPECT_THAT(Listing(program, "g"), Eq("0: jump_if_false r0 3\n"
+                                        "1: less r2 r0 r1\n"
+                                        "2: jump 4\n"
+                                        "3: less r2 r1 r0\n"
+                                        "4: jump_if_false r2 7\n"
+                                        "5: move r2 r0\n"
+                                        "6: jump 8\n"
+                                        "7: move r2 r1\n"
+                                        "8: return r2\n"));
+}
+
+TEST(CompilerTest, ComputesSharedNodesOnce) {
+  Program program;
+  ASSERT_TRUE(
+      CompileAll(&program, "(def f (x) (* (+ x 1) (+ x 1)))", /*merge=*/true));
+  EXPECT_THAT(Listing(program, "f"), Eq("0: add r2 r0 r1\n"
+                                        "1: multiply r3 r2 r2\n"
+                                        "2: return r3\n"));
+}
+
+TEST(CompilerTest, RejectsBadCalls) {
+  Program program;
+  ASSERT_TRUE(CompileAll(&program, "(def f (a) a)"));
+  EXPECT_FALSE(CompileAll(&program, "(def g (a) (h a))"));
+  EXPECT_FALSE(CompileAll(&program, "(def f (a) (f a a))"));
+  EXPECT_FALSE(CompileAll(&program, "(def g (a) (f a a))"));
+  // The failed forms left nothing behind.
+  EXPECT_EQ(program.size(), 1);
+  EXPECT_THAT(program.Find(Symbol::Intern("g")), Eq(std::nullopt));
+  EXPECT_THAT(Listing(program, "f"), Eq("0: return r0\n"));
+}
+
+TEST(CompilerTest, RenumbersFunctionsRedefinedWithOtherArities) {
+  Program program;
+  ASSERT_TRUE(CompileAll(&program, "(def f (a) a) (def f (a) (+ a a))"));
+  EXPECT_THAT(program.Find(Symbol::Intern("f")), Optional(0));
+  ASSERT_TRUE(CompileAll(&program, "(def f (a b) b)"));
+  EXPECT_THAT(program.Find(Symbol::Intern("f")), Optional(1));
+}
+
+} // namespace
+} // namespace benscope::vm
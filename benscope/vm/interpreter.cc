@@ -0,0 +1,181 @@
+#include "benscope/vm/interpreter.h"
+
+#include <algorithm>
+#include <iostream>
+
+// Handlers jump to each other through a table of label addresses where the
+// compiler allows it, which gives the branch predictor one indirect jump per
+// opcode to learn instead of the single one of a switch.
+#if defined(__GNUC__)
+#define BENSCOPE_VM_THREADED 1
+#else
+#define BENSCOPE_VM_THREADED 0
+#endif
+
+namespace benscope::vm {
+
+double CallNative(const Function &f, const double *args) {
+  using A = double;
+  void *p = f.native;
+  switch (f.arity) {
+  case 0:
+    return reinterpret_cast<A (*)()>(p)();
+  case 1:
+    return reinterpret_cast<A (*)(A)>(p)(args[0]);
+  case 2:
+    return reinterpret_cast<A (*)(A, A)>(p)(args[0], args[1]);
+  case 3:
+    return reinterpret_cast<A (*)(A, A, A)>(p)(args[0], args[1], args[2]);
+  case 4:
+    return reinterpret_cast<A (*)(A, A, A, A)>(p)(args[0], args[1], args[2],
+                                                   args[3]);
+  case 5:
+    return reinterpret_cast<A (*)(A, A, A, A, A)>(p)(args[0], args[1],
+                                                      args[2], args[3],
+                                                      args[4]);
+  default:
+    return reinterpret_cast<A (*)(A, A, A, A, A, A)>(p)(
+        args[0], args[1], args[2], args[3], args[4], args[5]);
+  }
+}
+
+bool Interpreter::Call(Program::Index index, const double *args,
+                       double *result) {
+  Function *f = &(*program_)[index];
+  if (f->native) {
+    *result = CallNative(*f, args);
+    return true;
+  }
+  if (!f->defined()) {
+    std::cerr << "Function " << f->name << " has no body.\n";
+    return false;
+  }
+
+  frames_.clear();
+  Reserve(0, f->registers);
+  double *r = registers_.data();
+  std::copy(args, args + f->arity, r);
+  std::copy(f->constants.begin(), f->constants.end(), r + f->arity);
+  const Instruction *code = f->code.data();
+  const Instruction *pc = code;
+  double value;
+
+#if BENSCOPE_VM_THREADED
+  // In the order of Opcode.
+  static const void *const kHandlers[] = {
+      &&kMove, &&kAdd,           &&kSubtract, &&kMultiply, &&kDivide, &&kLess,
+      &&kJump, &&kJumpIfFalse, &&kJumpIfNotLess, &&kCall, &&kTailCall,
+      &&kReturn};
+#define DISPATCH() goto *kHandlers[static_cast<int>(pc->op)]
+#define HANDLER(op) op
+#else
+#define DISPATCH() goto dispatch
+#define HANDLER(op) case Opcode::op
+#endif
+
+  DISPATCH();
+#if !BENSCOPE_VM_THREADED
+dispatch:
+  switch (pc->op) {
+#endif
+HANDLER(kMove) :
+  r[pc->a] = r[pc->b];
+  ++pc;
+  DISPATCH();
+HANDLER(kAdd) :
+  r[pc->a] = r[pc->b] + r[pc->c];
+  ++pc;
+  DISPATCH();
+HANDLER(kSubtract) :
+  r[pc->a] = r[pc->b] - r[pc->c];
+  ++pc;
+  DISPATCH();
+HANDLER(kMultiply) :
+  r[pc->a] = r[pc->b] * r[pc->c];
+  ++pc;
+  DISPATCH();
+HANDLER(kDivide) :
+  r[pc->a] = r[pc->b] / r[pc->c];
+  ++pc;
+  DISPATCH();
+HANDLER(kLess) :
+  // Unordered, as in the LLVM backend: true if either side is NaN.
+  r[pc->a] = r[pc->b] >= r[pc->c] ? 0.0 : 1.0;
+  ++pc;
+  DISPATCH();
+HANDLER(kJump) :
+  pc = code + pc->b;
+  DISPATCH();
+HANDLER(kJumpIfFalse) : {
+  const double test = r[pc->a];
+  pc = test < 0.0 || test > 0.0 ? pc + 1 : code + pc->b;
+  DISPATCH();
+}
+HANDLER(kJumpIfNotLess) :
+  pc = r[pc->a] >= r[pc->b] ? code + pc->c : pc + 1;
+  DISPATCH();
+HANDLER(kCall) : {
+  Function &callee = (*program_)[pc->b];
+  Heat(pc->b, &callee);
+  if (callee.native) {
+    r[pc->a] = CallNative(callee, r + pc->c);
+    ++pc;
+    DISPATCH();
+  }
+  if (!callee.defined()) {
+    std::cerr << "Function " << callee.name << " has no body.\n";
+    return false;
+  }
+  if (frames_.size() == kMaxDepth) {
+    std::cerr << "Calls nested too deeply in " << callee.name << ".\n";
+    return false;
+  }
+  // The arguments are at the top of the caller's frame, where the callee's
+  // parameters go.
+  const std::size_t base = r - registers_.data();
+  frames_.push_back({index, pc, base});
+  Reserve(base + pc->c, callee.registers);
+  r = registers_.data() + base + pc->c;
+  std::copy(callee.constants.begin(), callee.constants.end(),
+            r + callee.arity);
+  index = pc->b;
+  f = &callee;
+  code = pc = f->code.data();
+  DISPATCH();
+}
+HANDLER(kTailCall) :
+  std::copy(r + pc->a, r + pc->a + pc->b, r);
+  Heat(index, f);
+  if (f->native) {
+    value = CallNative(*f, r);
+    goto finish;
+  }
+  pc = code;
+  DISPATCH();
+HANDLER(kReturn) : {
+  value = r[pc->a];
+finish:
+  if (frames_.empty()) {
+    *result = value;
+    return true;
+  }
+  const Frame &caller = frames_.back();
+  index = caller.function;
+  f = &(*program_)[index];
+  code = f->code.data();
+  pc = caller.pc;
+  r = registers_.data() + caller.base;
+  frames_.pop_back();
+  r[pc->a] = value;
+  ++pc;
+  DISPATCH();
+}
+#if !BENSCOPE_VM_THREADED
+  }
+  return false;
+#endif
+#undef DISPATCH
+#undef HANDLER
+}
+
+} // namespace benscope::vm
@@ -0,0 +1,84 @@
+// Runs register bytecode without compiling it to machine code.
+
+#ifndef __BENSCOPE_VM_INTERPRETER_H__
+#define __BENSCOPE_VM_INTERPRETER_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "benscope/vm/program.h"
+
+namespace benscope::vm {
+
+// Executes the functions of a Program (see Compile) with a dispatch loop
+// that, where the compiler supports labels as values, jumps from each
+// instruction's handler straight to the next one's.  The frames of all
+// calls share one growing array of registers, so starting a call costs
+// no more than copying the callee's constants into place, and nothing is
+// set up or torn down per expression.
+//
+// Each function counts its calls and self tail calls (see Function::heat),
+// so that a hook can replace the ones that get hot with native code.
+class Interpreter {
+public:
+  // Deeper calls are reported as errors instead of exhausting memory.
+  static constexpr std::size_t kMaxDepth = 1 << 20;
+
+  explicit Interpreter(Program *program) : program_(program) {}
+
+  // Has `promote(i)` called when function i gets `threshold` hot, before the
+  // call or loop iteration that makes it so.  If it gives the function a
+  // native version, that call goes to it, and so does a loop, from its next
+  // iteration on: a self tail call is a call with the same result.  The hook
+  // must not add functions to the program.
+  void SetHotHook(std::uint32_t threshold,
+                  std::function<void(Program::Index)> promote) {
+    threshold_ = threshold;
+    promote_ = std::move(promote);
+  }
+
+  // Calls function `index` of the program with `args`, one for each of its
+  // parameters, and sets `*result` to its value.  Returns false, having
+  // reported it on std::cerr, if the call fails, e.g. at a function that has
+  // no body yet.  The program must not change during a call, except through
+  // native versions set by the hot hook.
+  bool Call(Program::Index index, const double *args, double *result);
+
+private:
+  struct Frame {
+    // The caller, the call instruction to return to and the caller's
+    // first register.
+    Program::Index function;
+    const Instruction *pc;
+    std::size_t base;
+  };
+
+  // Counts a call or loop iteration of function `index`.
+  void Heat(Program::Index index, Function *f) {
+    if (++f->heat == threshold_ && promote_)
+      promote_(index);
+  }
+
+  // Makes room for a frame of `registers` at `base`.
+  void Reserve(std::size_t base, std::size_t registers) {
+    if (base + registers > registers_.size())
+      registers_.resize(std::max(2 * registers_.size(), base + registers));
+  }
+
+  Program *program_;
+  std::uint32_t threshold_ = 0;
+  std::function<void(Program::Index)> promote_;
+  std::vector<double> registers_;
+  std::vector<Frame> frames_;
+};
+
+// Calls the native function of an extern with `f.arity` arguments.
+double CallNative(const Function &f, const double *args);
+
+} // namespace benscope::vm
+
+#endif // __BENSCOPE_VM_INTERPRETER_H__
@@ -0,0 +1,152 @@
+#include "benscope/vm/interpreter.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "benscope/parsing/ast.h"
+#include "benscope/parsing/flat_ast.h"
+#include "benscope/parsing/lexer.h"
+#include "benscope/parsing/parser.h"
+#include "benscope/transforms/scope_resolver.h"
+#include "benscope/vm/compiler.h"
+#include "benscope/vm/program.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace benscope::vm {
+namespace {
+
+using ::testing::DoubleEq;
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Optional;
+
+// Compiles each form of `source` into `program` and returns the value of the
+// last expression, if it ran.
+std::optional<double> Evaluate(Interpreter *interpreter, Program *program,
+                               const std::string &source) {
+  Parser parser(std::make_unique<Lexer>(source));
+  FlatAst form;
+  std::optional<double> value;
+  while (parser.ParseNext(&form)) {
+    if (!ResolveScopes(&form) || !Compile(form, program))
+      return std::nullopt;
+    if (form[form[form.root()].operands[0]].name != AnonExprSymbol())
+      continue;
+    double result;
+    if (!interpreter->Call(*program->Find(AnonExprSymbol()), nullptr,
+                           &result))
+      return std::nullopt;
+    value = result;
+  }
+  return value;
+}
+
+std::optional<double> Evaluate(Program *program, const std::string &source) {
+  Interpreter interpreter(program);
+  return Evaluate(&interpreter, program, source);
+}
+
+std::optional<double> Evaluate(const std::string &source) {
+  Program program;
+  return Evaluate(&program, source);
+}
+
+// Stand-ins for the native code of hot functions.
+double NegatedSquare(double x) { return -x * x; }
+double CountFrom1000(double i, double n) { return 1000 + i; }
+
+TEST(InterpreterTest, Evaluates) {
+  EXPECT_THAT(Evaluate("(+ 1 (* 2 3))"), Optional(7.0));
+  EXPECT_THAT(Evaluate("(/ (- 1 4) 2)"), Optional(-1.5));
+  EXPECT_THAT(Evaluate("(< 1 2)"), Optional(1.0));
+  EXPECT_THAT(Evaluate("(< 2 1)"), Optional(0.0));
+  EXPECT_THAT(Evaluate("(if (- 2 2) 3 4)"), Optional(4.0));
+  EXPECT_THAT(Evaluate("(if (< 1 2) 3 4)"), Optional(3.0));
+}
+
+TEST(InterpreterTest, ComparesNaNAsTheLlvmBackendDoes) {
+  // `<` is true if either side is NaN, and NaN as a test is false.
+  EXPECT_THAT(Evaluate("(< (/ 0 0) 1)"), Optional(1.0));
+  EXPECT_THAT(Evaluate("(if (/ 0 0) 3 4)"), Optional(4.0));
+  EXPECT_THAT(Evaluate("(if (< (/ 0 0) 1) 3 4)"), Optional(3.0));
+}
+
+TEST(InterpreterTest, CallsFunctions) {
+  EXPECT_THAT(
+      Evaluate("(def fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))"
+               "(fib 20)"),
+      Optional(6765.0));
+  EXPECT_THAT(Evaluate("(def f (a b c) (- a (* b c))) (def g (x) (f x 2 3))"
+                       "(+ (g 10) (g 20))"),
+              Optional(18.0));
+}
+
+TEST(InterpreterTest, LoopsInConstantSpace) {
+  EXPECT_THAT(Evaluate("(def count (i n) (if (< i n) (count (+ i 1) n) i))"
+                       "(count 0 1000000)"),
+              Optional(1000000.0));
+}
+
+TEST(InterpreterTest, RecursesDeeply) {
+  EXPECT_THAT(Evaluate("(def sum (n) (if (< n 1) 0 (+ n (sum (- n 1)))))"
+                       "(sum 100000)"),
+              Optional(5000050000.0));
+  EXPECT_THAT(Evaluate("(def down (n) (+ 1 (down n))) (down 0)"),
+              Eq(std::nullopt));
+}
+
+TEST(InterpreterTest, CallsExterns) {
+  EXPECT_THAT(Evaluate("(extern sin (x)) (extern pow (x y))"
+                       "(+ (sin 0) (pow 2 10))"),
+              Optional(DoubleEq(1024.0)));
+  EXPECT_THAT(Evaluate("(extern no_such_function_anywhere (x))"),
+              Eq(std::nullopt));
+}
+
+TEST(InterpreterTest, SeesRedefinitions) {
+  Program program;
+  EXPECT_THAT(Evaluate(&program, "(def f (x) (+ x 1)) (def g (x) (* 2 (f x)))"
+                                 "(g 3)"),
+              Optional(8.0));
+  EXPECT_THAT(Evaluate(&program, "(def f (x) (- x 1)) (g 3)"), Optional(4.0));
+  // Callers of the old arity keep the old function.
+  EXPECT_THAT(Evaluate(&program, "(def f (x y) (* x y)) (g 3) (f 3 4)"),
+              Optional(12.0));
+  EXPECT_THAT(Evaluate(&program, "(g 3)"), Optional(4.0));
+}
+
+TEST(InterpreterTest, PromotesHotFunctions) {
+  Program program;
+  Interpreter interpreter(&program);
+  std::vector<std::string> promoted;
+  interpreter.SetHotHook(3, [&](Program::Index i) {
+    promoted.emplace_back(program[i].name.name());
+    program[i].native = reinterpret_cast<void *>(&NegatedSquare);
+  });
+  // The third call is the first to the native version.
+  EXPECT_THAT(Evaluate(&interpreter, &program,
+                       "(def f (x) (* x x))"
+                       "(+ (f 1) (+ (f 2) (+ (f 3) (f 4))))"),
+              Optional(1.0 + 4.0 - 9.0 - 16.0));
+  EXPECT_THAT(promoted, ElementsAre("f"));
+}
+
+TEST(InterpreterTest, PromotesHotLoops) {
+  Program program;
+  Interpreter interpreter(&program);
+  interpreter.SetHotHook(5, [&](Program::Index i) {
+    program[i].native = reinterpret_cast<void *>(&CountFrom1000);
+  });
+  // The call and four iterations in bytecode, then the rest natively.
+  EXPECT_THAT(Evaluate(&interpreter, &program,
+                       "(def count (i n) (if (< i n) (count (+ i 1) n) i))"
+                       "(count 0 100)"),
+              Optional(1004.0));
+}
+
+} // namespace
+} // namespace benscope::vm
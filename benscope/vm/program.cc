@@ -0,0 +1,104 @@
+#include "benscope/vm/program.h"
+
+#include <dlfcn.h>
+
+#include <iostream>
+
+#include "absl/strings/str_cat.h"
+
+namespace benscope::vm {
+
+std::optional<Program::Index> Program::Find(Symbol name) const {
+  auto it = by_name_.find(name);
+  if (it == by_name_.end())
+    return std::nullopt;
+  return it->second;
+}
+
+Function *Program::Declare(Symbol name, std::uint16_t arity, Index *index) {
+  auto it = by_name_.find(name);
+  if (it != by_name_.end() && functions_[it->second].arity == arity) {
+    *index = it->second;
+    return &functions_[*index];
+  }
+  if (functions_.size() == kMaxFunctions) {
+    std::cerr << "Too many functions for the interpreter.\n";
+    return nullptr;
+  }
+  *index = static_cast<Index>(functions_.size());
+  by_name_[name] = *index;
+  Function &f = functions_.emplace_back();
+  f.name = name;
+  f.arity = arity;
+  return &f;
+}
+
+bool Program::DeclareExtern(Symbol name, std::uint16_t arity) {
+  if (arity > kMaxNativeArity) {
+    std::cerr << "Too many parameters for extern " << name << "\n";
+    return false;
+  }
+  void *native = dlsym(RTLD_DEFAULT, std::string(name.name()).c_str());
+  if (!native) {
+    std::cerr << "Unknown extern " << name << "\n";
+    return false;
+  }
+  Index index;
+  Function *f = Declare(name, arity, &index);
+  if (!f)
+    return false;
+  f->native = native;
+  f->code.clear();
+  f->constants.clear();
+  f->registers = 0;
+  return true;
+}
+
+std::string Disassemble(const Program &program, const Function &f) {
+  std::string out;
+  for (std::size_t pc = 0; pc < f.code.size(); ++pc) {
+    const Instruction &i = f.code[pc];
+    absl::StrAppend(&out, pc, ": ");
+    switch (i.op) {
+    case Opcode::kMove:
+      absl::StrAppend(&out, "move r", i.a, " r", i.b);
+      break;
+    case Opcode::kAdd:
+    case Opcode::kSubtract:
+    case Opcode::kMultiply:
+    case Opcode::kDivide:
+    case Opcode::kLess: {
+      static constexpr const char *kNames[] = {"add", "subtract", "multiply",
+                                               "divide", "less"};
+      absl::StrAppend(
+          &out,
+          kNames[static_cast<int>(i.op) - static_cast<int>(Opcode::kAdd)],
+          " r", i.a, " r", i.b, " r", i.c);
+      break;
+    }
+    case Opcode::kJump:
+      absl::StrAppend(&out, "jump ", i.b);
+      break;
+    case Opcode::kJumpIfFalse:
+      absl::StrAppend(&out, "jump_if_false r", i.a, " ", i.b);
+      break;
+    case Opcode::kJumpIfNotLess:
+      absl::StrAppend(&out, "jump_if_not_less r", i.a, " r", i.b, " ", i.c);
+      break;
+    case Opcode::kCall:
+      absl::StrAppend(&out, "call r", i.a, " ", program[i.b].name.name(),
+                      " r", i.c);
+      break;
+    case Opcode::kTailCall:
+      absl::StrAppend(&out, "tail_call r", i.a, " ", i.b);
+      break;
+    case Opcode::kReturn:
+      absl::StrAppend(&out, "return r", i.a);
+      break;
+    }
+    out += '\n';
+  }
+  return out;
+}
+
+} // namespace benscope::vm
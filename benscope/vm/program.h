@@ -0,0 +1,96 @@
+// Register bytecode for the interpreter, and the table of functions it runs.
+
+#ifndef __BENSCOPE_VM_PROGRAM_H__
+#define __BENSCOPE_VM_PROGRAM_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "benscope/parsing/symbol.h"
+
+namespace benscope::vm {
+
+// Each instruction names up to three operands.  Registers are numbered from
+// the base of the current call's frame: first the parameters, then the
+// function's constants, then its temporaries.
+enum class Opcode : std::uint8_t {
+  kMove,          // r[a] = r[b]
+  kAdd,           // r[a] = r[b] + r[c]
+  kSubtract,      // r[a] = r[b] - r[c]
+  kMultiply,      // r[a] = r[b] * r[c]
+  kDivide,        // r[a] = r[b] / r[c]
+  kLess,          // r[a] = r[b] < r[c], or 1 if either is NaN
+  kJump,          // goto b
+  kJumpIfFalse,   // if r[a] is 0 or NaN: goto b
+  kJumpIfNotLess, // unless r[a] < r[b], or either is NaN: goto c
+  kCall,          // r[a] = function b (r[c], r[c + 1], ...)
+  kTailCall,      // r[0 .. b) = r[a .. a + b), goto 0
+  kReturn,        // return r[a]
+};
+
+struct Instruction {
+  Opcode op;
+  std::uint16_t a, b, c;
+};
+
+struct Function {
+  Symbol name;
+  std::uint16_t arity = 0;
+  // Externs: the native function, which takes `arity` doubles.
+  void *native = nullptr;
+  // Functions with a body: the code, the constants it expects in the
+  // registers after the parameters, and the size of its frame.
+  std::vector<Instruction> code;
+  std::vector<double> constants;
+  std::uint32_t registers = 0;
+  // Calls and self tail calls so far, counted by the interpreter.
+  std::uint32_t heat = 0;
+
+  bool defined() const { return native || !code.empty(); }
+};
+
+// Every function and extern defined so far, numbered in the order they were
+// first declared.  Calls refer to their callee by number, so redefining a
+// function with the same number of parameters takes effect in every caller
+// at once.  A redefinition with a different number gets a new number, and
+// the callers compiled before it keep calling the old one.
+class Program {
+public:
+  using Index = std::uint16_t;
+  // Numbers are 16 bits wide in the bytecode.
+  static constexpr std::size_t kMaxFunctions = 1 << 16;
+  // The interpreter calls native functions of up to this many parameters.
+  static constexpr std::size_t kMaxNativeArity = 6;
+
+  // The function `name` currently refers to, if any.
+  std::optional<Index> Find(Symbol name) const;
+
+  // The function `name` with `arity` parameters, added without a body if
+  // there is none, or null if the table is full.
+  Function *Declare(Symbol name, std::uint16_t arity, Index *index);
+
+  // Declares `name` as the native function of that name in this process.
+  // Returns false, having reported it, if there is none or it has too many
+  // parameters.
+  bool DeclareExtern(Symbol name, std::uint16_t arity);
+
+  const Function &operator[](Index index) const { return functions_[index]; }
+  Function &operator[](Index index) { return functions_[index]; }
+  std::size_t size() const { return functions_.size(); }
+
+private:
+  std::vector<Function> functions_;
+  absl::flat_hash_map<Symbol, Index> by_name_;
+};
+
+// A listing of `f`'s code, one instruction per line, for tests and
+// --verbose.
+std::string Disassemble(const Program &program, const Function &f);
+
+} // namespace benscope::vm
+
+#endif // __BENSCOPE_VM_PROGRAM_H__